@@ -2,7 +2,9 @@
 
 #include <iostream>
 
+void test_benchmark_bits();
 void test_benchmark_process_xor();
+void test_benchmark_strz();
 void test_ext2();
 void test_pcap();
 
@@ -12,10 +14,18 @@ struct benchmark_case {
 };
 
 benchmark_case benchmarks[] = {
+    {
+        .name = std::string("benchmark_bits"),
+        .test_func = test_benchmark_bits,
+    },
     {
         .name = std::string("benchmark_process_xor"),
         .test_func = test_benchmark_process_xor,
     },
+    {
+        .name = std::string("benchmark_strz"),
+        .test_func = test_benchmark_strz,
+    },
     {
         .name = std::string("ext2"),
         .test_func = test_ext2,
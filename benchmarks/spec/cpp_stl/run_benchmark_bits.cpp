@@ -0,0 +1,37 @@
+#include <benchmark_bits.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sys/time.h>
+
+extern struct timeval t1, t2, t3;
+
+// Mostly measures read_bits_int_be() / read_bits_int_le() on an in-memory
+// stream: every packet is 7 bit fields of 1 to 24 bits packed into 8 bytes
+void test_benchmark_bits() {
+    std::ifstream ifs("data/benchmark_bits.dat", std::ifstream::binary);
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    kaitai::kstream ks(data);
+
+    uint64_t sum = 0;
+
+    gettimeofday(&t1, NULL);
+    benchmark_bits_t r(&ks);
+    gettimeofday(&t2, NULL);
+
+    for (uint i = 0; i < r.packets_be()->size(); i++) {
+        auto packet = r.packets_be()->at(i);
+        sum += packet->pid() + packet->len() + packet->timestamp();
+    }
+    for (uint i = 0; i < r.packets_le()->size(); i++) {
+        auto packet = r.packets_le()->at(i);
+        sum += packet->pid() + packet->len() + packet->timestamp();
+    }
+
+    gettimeofday(&t3, NULL);
+
+    std::cout << "sum = " << sum << "\n";
+}
@@ -0,0 +1,37 @@
+#include <benchmark_strz.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sys/time.h>
+
+extern struct timeval t1, t2, t3;
+
+// Mostly measures read_bytes_term() and bytes_terminate() on an in-memory
+// stream: a string table of null-terminated names, then fixed-size records
+// with null-padded names
+void test_benchmark_strz() {
+    std::ifstream ifs("data/benchmark_strz.dat", std::ifstream::binary);
+    std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    kaitai::kstream ks(data);
+
+    uint64_t sum = 0;
+
+    gettimeofday(&t1, NULL);
+    benchmark_strz_t r(&ks);
+    gettimeofday(&t2, NULL);
+
+    for (uint i = 0; i < r.names()->size(); i++) {
+        sum += r.names()->at(i).length();
+    }
+    for (uint i = 0; i < r.records()->size(); i++) {
+        auto record = r.records()->at(i);
+        sum += record->name().length() + record->value();
+    }
+
+    gettimeofday(&t3, NULL);
+
+    std::cout << "sum = " << sum << "\n";
+}
@@ -26,6 +26,10 @@ bool IsValidCppStandard(const std::string& standard) {
   return standard == "98" || standard == "11" || standard == "17";
 }
 
+bool IsValidCppStreamBackend(const std::string& backend) {
+  return backend == "memory" || backend == "generic";
+}
+
 bool IsKnownOption(const std::string& arg) {
   static const std::vector<std::string> options = {"-t",
                                                    "--target",
@@ -37,6 +41,10 @@ bool IsKnownOption(const std::string& arg) {
                                                    "--import-path",
                                                    "--cpp-namespace",
                                                    "--cpp-standard",
+                                                   "--cpp-stream-backend",
+                                                   "--cpp-error-status",
+                                                   "--cpp-bytes-view",
+                                                   "--cpp-lazy-str",
                                                    "--go-package",
                                                    "--java-package",
                                                    "--java-from-file-class",
@@ -97,6 +105,14 @@ std::string HelpText() {
       << "  -I, --import-path <paths>         .ksy import paths (colon/semicolon-separated)\n"
       << "      --cpp-namespace <namespace>   C++ namespace\n"
       << "      --cpp-standard <standard>     C++ standard to target (98, 11, 17)\n"
+      << "      --cpp-stream-backend <backend> header-only kaitai::basic_kstream backend to target "
+         "(memory, generic)\n"
+      << "      --cpp-error-status            report parse errors via kaitai::kstream::status() "
+         "instead of exceptions\n"
+      << "      --cpp-bytes-view              store bytes fields as kaitai::bytes_view pointing "
+         "into the stream (in-memory and mmap streams only)\n"
+      << "      --cpp-lazy-str                decode string fields on first access instead of while "
+         "parsing\n"
       << "      --go-package <package>        Go package\n"
       << "      --java-package <package>      Java package\n"
       << "      --java-from-file-class <class> Java fromFile() helper class\n"
@@ -236,6 +252,37 @@ ParseResult ParseCommandLine(int argc, char** argv) {
       continue;
     }
 
+    if (arg == "--cpp-stream-backend") {
+      const char* value = require_value(arg);
+      if (!value) {
+        return result;
+      }
+      std::string backend(value);
+      if (!IsValidCppStreamBackend(backend)) {
+        result.status = ParseStatus::kError;
+        result.message =
+            "'" + backend + "' is not a valid C++ stream backend; valid ones are: memory, generic";
+        return result;
+      }
+      result.options.runtime.stream_backend = backend;
+      continue;
+    }
+
+    if (arg == "--cpp-error-status") {
+      result.options.runtime.error_status = true;
+      continue;
+    }
+
+    if (arg == "--cpp-bytes-view") {
+      result.options.runtime.bytes_view = true;
+      continue;
+    }
+
+    if (arg == "--cpp-lazy-str") {
+      result.options.runtime.lazy_str = true;
+      continue;
+    }
+
     if (arg == "--go-package") {
       const char* value = require_value(arg);
       if (!value)
@@ -417,12 +464,27 @@ std::string ValidateBackendCompatibility(const CliOptions& options) {
     if (!options.runtime.python_package.empty()) {
       return "--python-package is only supported with target 'python'";
     }
+    if (options.runtime.error_status && !options.runtime.zero_copy_substream) {
+      return "--cpp-error-status requires zero-copy substreams";
+    }
     return "";
   }
 
   if (!options.runtime.cpp_namespace.empty()) {
     return "--cpp-namespace is only supported with target 'cpp_stl'";
   }
+  if (!options.runtime.stream_backend.empty()) {
+    return "--cpp-stream-backend is only supported with target 'cpp_stl'";
+  }
+  if (options.runtime.error_status) {
+    return "--cpp-error-status is only supported with target 'cpp_stl'";
+  }
+  if (options.runtime.bytes_view) {
+    return "--cpp-bytes-view is only supported with target 'cpp_stl'";
+  }
+  if (options.runtime.lazy_str) {
+    return "--cpp-lazy-str is only supported with target 'cpp_stl'";
+  }
   if (!options.runtime.java_package.empty()) {
     return "--java-package is not supported for native compiler-cpp targets";
   }
@@ -15,6 +15,10 @@ struct RuntimeOptions {
 
   std::string cpp_namespace;
   std::string cpp_standard = "98";
+  std::string stream_backend;
+  bool error_status = false;
+  bool bytes_view = false;
+  bool lazy_str = false;
   std::string go_package;
   std::string java_package;
   std::string java_from_file_class;
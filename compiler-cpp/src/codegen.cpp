@@ -588,23 +588,40 @@ std::string CppAttrType(const ir::Attr& attr, const std::map<std::string, ir::Ty
   return CppFieldType(primitive.value_or(ir::PrimitiveType::kU1));
 }
 
+// The runtime has built-in decoders for the most common encodings; calling
+// them directly saves looking the encoding up by name on every read.
+std::string BytesToStrExpr(const std::string& bytes_expr, const std::string& encoding) {
+  static const std::map<std::string, std::string> kBuiltinDecoders = {
+      {"ASCII", "bytes_to_str_ascii"},
+      {"UTF-8", "bytes_to_str_utf8"},
+      {"ISO-8859-1", "bytes_to_str_latin1"},
+      {"UTF-16LE", "bytes_to_str_utf16le"},
+      {"UTF-16BE", "bytes_to_str_utf16be"},
+  };
+  const auto it = kBuiltinDecoders.find(encoding);
+  if (it != kBuiltinDecoders.end()) return "kaitai::kstream::" + it->second + "(" + bytes_expr + ")";
+  return "kaitai::kstream::bytes_to_str(" + bytes_expr + ", \"" + encoding + "\")";
+}
+
 std::string CppReadPrimitiveExpr(ir::PrimitiveType primitive, std::optional<ir::Endian> override_endian,
-                                 ir::Endian default_endian) {
+                                 ir::Endian default_endian, bool unchecked = false) {
   if (primitive == ir::PrimitiveType::kBytes) return "m__io->read_bytes_full()";
   if (primitive == ir::PrimitiveType::kStr) return "std::string()";
-  return "m__io->" + ReadMethod(primitive, override_endian.value_or(default_endian)) + "()";
+  return "m__io->" + ReadMethod(primitive, override_endian.value_or(default_endian)) +
+         (unchecked ? "_unchecked()" : "()");
 }
 
 std::string ReadExpr(const ir::Attr& attr, ir::Endian default_endian,
                      const std::set<std::string>& attrs, const std::set<std::string>& instances,
-                     const std::map<std::string, ir::TypeRef>& user_types) {
+                     const std::map<std::string, ir::TypeRef>& user_types,
+                     const std::string& io = "m__io") {
   const auto primitive = ResolvePrimitiveType(attr.type, user_types);
   if (!primitive.has_value() && IsUnresolvedUserType(attr.type, user_types)) {
     const std::string type_name = CppUserTypeName(attr.type.user_type);
     std::ostringstream ctor_args;
     const bool local_alias = user_types.find(attr.type.user_type) != user_types.end();
     if (local_alias) {
-      ctor_args << "m__io, this, m__root";
+      ctor_args << io << ", this, m__root";
     } else {
       bool first = true;
       for (const auto& arg : attr.user_type_args) {
@@ -613,7 +630,7 @@ std::string ReadExpr(const ir::Attr& attr, ir::Endian default_endian,
         first = false;
       }
       if (!first) ctor_args << ", ";
-      ctor_args << "m__io";
+      ctor_args << io;
     }
     return "std::unique_ptr<" + type_name + ">(new " + type_name + "(" + ctor_args.str() + "))";
   }
@@ -630,13 +647,134 @@ std::string ReadExpr(const ir::Attr& attr, ir::Endian default_endian,
   if (primitive_kind == ir::PrimitiveType::kStr) {
     if (!attr.size_expr.has_value()) return "std::string()";
     const std::string enc = attr.encoding.value_or("UTF-8");
-    return "kaitai::kstream::bytes_to_str(m__io->read_bytes(" + RenderExpr(*attr.size_expr, attrs, instances, -1) + "), \"" + enc + "\")";
+    return BytesToStrExpr("m__io->read_bytes(" + RenderExpr(*attr.size_expr, attrs, instances, -1) + ")", enc);
   }
   std::string base = CppReadPrimitiveExpr(primitive_kind, attr.endian_override, default_endian);
   if (attr.enum_name.has_value()) return "static_cast<" + EnumCppTypeName(*attr.enum_name) + ">(" + base + ")";
   return base;
 }
 
+// Stream type taken and created by the generated classes: kaitai::kstream, or
+// the header-only kaitai::basic_kstream with --cpp-stream-backend.
+std::string CppStreamType(const RuntimeOptions& runtime) {
+  if (runtime.stream_backend.empty()) return "kaitai::kstream";
+  return "kaitai::basic_kstream<kaitai::" + runtime.stream_backend + "_backend>";
+}
+
+// With a basic_kstream, every class keeps its own `m__io` of that type (hiding
+// the kaitai::kstream one of kaitai::kstruct), so that reads through it are
+// inlined. Emits its accessor (`public` section) or the member itself.
+void EmitTypedIoAccessor(std::ostringstream* out, const std::string& ind, const RuntimeOptions& runtime) {
+  if (runtime.stream_backend.empty()) return;
+  *out << ind << CppStreamType(runtime) << "* _io() const { return m__io; }\n";
+}
+
+void EmitTypedIoMember(std::ostringstream* out, const std::string& ind, const RuntimeOptions& runtime) {
+  if (runtime.stream_backend.empty()) return;
+  *out << ind << CppStreamType(runtime) << "* m__io;\n";
+}
+
+// User type attributes with `size` are parsed from a substream of that size,
+// stored in `m__io__raw_<id>`.
+bool UsesSubstream(const ir::Attr& attr, const std::map<std::string, ir::TypeRef>& user_types) {
+  return attr.size_expr.has_value() && !attr.switch_on.has_value() &&
+         IsUnresolvedUserType(attr.type, user_types);
+}
+
+// Emits header members holding the substream of `attr` (and its raw bytes if
+// zero-copy substreams are disabled).
+void EmitSubstreamMembers(std::ostringstream* out, const std::string& ind, const ir::Attr& attr,
+                          const RuntimeOptions& runtime) {
+  const bool repeated = attr.repeat != ir::Attr::RepeatKind::kNone;
+  if (!runtime.zero_copy_substream) {
+    *out << ind << (repeated ? "std::unique_ptr<std::vector<std::string>>" : "std::string")
+         << " m__raw_" << attr.id << ";\n";
+  }
+  const std::string stream = CppStreamType(runtime);
+  *out << ind
+       << (repeated ? "std::unique_ptr<std::vector<std::unique_ptr<" + stream + ">>>"
+                    : "std::unique_ptr<" + stream + ">")
+       << " m__io__raw_" << attr.id << ";\n";
+}
+
+// Accessor for the raw bytes of a substream (only stored if zero-copy
+// substreams are disabled).
+std::string SubstreamRawAccessor(const ir::Attr& attr) {
+  if (attr.repeat != ir::Attr::RepeatKind::kNone) {
+    return "    std::vector<std::string>* _raw_" + attr.id + "() const { return m__raw_" + attr.id + ".get(); }\n";
+  }
+  return "    std::string _raw_" + attr.id + "() const { return m__raw_" + attr.id + "; }\n";
+}
+
+// With --cpp-error-status, emits the check that makes `_read()` return as
+// soon as an error has been recorded in the stream.
+void EmitStatusCheck(std::ostringstream* out, const std::string& ind, const RuntimeOptions& runtime) {
+  if (!runtime.error_status) return;
+  *out << ind << "if (!m__io->ok()) return;\n";
+}
+
+// Emits statements allocating the substream for one item of `attr` and
+// returns the expression referencing it. With zero-copy substreams, the
+// substream is a window over the parent stream's buffer; otherwise the bytes
+// are read into `m__raw_<id>` first.
+std::string EmitSubstream(std::ostringstream* out, const std::string& ind, const ir::Attr& attr,
+                          const std::string& size, const RuntimeOptions& runtime) {
+  const std::string io_member = "m__io__raw_" + attr.id;
+  const std::string raw_member = "m__raw_" + attr.id;
+  const std::string stream = CppStreamType(runtime);
+  if (attr.repeat == ir::Attr::RepeatKind::kNone) {
+    if (runtime.zero_copy_substream) {
+      *out << ind << io_member << " = std::unique_ptr<" << stream << ">(new " << stream << "(m__io, m__io->pos(), "
+           << size << "));\n";
+      // A substream reaching past the end records the error in m__io
+      EmitStatusCheck(out, ind, runtime);
+      *out << ind << "m__io->seek(m__io->pos() + " << io_member << "->size());\n";
+    } else {
+      *out << ind << raw_member << " = m__io->read_bytes(" << size << ");\n";
+      *out << ind << io_member << " = std::unique_ptr<" << stream << ">(new " << stream << "(" << raw_member
+           << "));\n";
+    }
+    return io_member + ".get()";
+  }
+  const std::string local_io = "io_" + attr.id;
+  if (runtime.zero_copy_substream) {
+    *out << ind << stream << "* " << local_io << " = new " << stream << "(m__io, m__io->pos(), " << size
+         << ");\n";
+    *out << ind << io_member << "->emplace_back(" << local_io << ");\n";
+    EmitStatusCheck(out, ind, runtime);
+    *out << ind << "m__io->seek(m__io->pos() + " << local_io << "->size());\n";
+  } else {
+    *out << ind << raw_member << "->push_back(m__io->read_bytes(" << size << "));\n";
+    *out << ind << stream << "* " << local_io << " = new " << stream << "(" << raw_member << "->back());\n";
+    *out << ind << io_member << "->emplace_back(" << local_io << ");\n";
+  }
+  return local_io;
+}
+
+// Emits the statements reporting a malformed value: an exception, or a
+// recorded error at `pos` and an early return with --cpp-error-status.
+void EmitInvalidError(std::ostringstream* out, const std::string& ind, const std::string& exception,
+                      const RuntimeOptions& runtime, const std::string& pos = "m__io->pos()") {
+  if (!runtime.error_status) {
+    *out << ind << "throw " << exception << ";\n";
+    return;
+  }
+  *out << ind << "m__io->set_error(kaitai::kstream::STATUS_INVALID, " << pos << ");\n";
+  *out << ind << "return;\n";
+}
+
+// Emits initialization of the per-item substream arrays of a repeated `attr`.
+void EmitSubstreamArraysInit(std::ostringstream* out, const std::string& ind, const ir::Attr& attr,
+                             const RuntimeOptions& runtime) {
+  if (!runtime.zero_copy_substream) {
+    *out << ind << "m__raw_" << attr.id << " = std::unique_ptr<std::vector<std::string>>(new std::vector<std::string>());\n";
+  }
+  const std::string stream = CppStreamType(runtime);
+  *out << ind << "m__io__raw_" << attr.id
+       << " = std::unique_ptr<std::vector<std::unique_ptr<" << stream << ">>>(new std::vector<std::unique_ptr<" << stream
+       << ">>());\n";
+}
+
 std::string ReadSwitchExpr(const ir::Attr& attr, ir::Endian default_endian,
                            const std::set<std::string>& attrs, const std::set<std::string>& instances,
                            const std::map<std::string, ir::TypeRef>& user_types) {
@@ -712,6 +850,52 @@ std::string CppAccessorType(const ir::Attr& attr, const std::map<std::string, ir
   }
   return CppStorageType(attr, user_types);
 }
+// With --cpp-bytes-view, plain `bytes` fields (not repeated, processed or
+// switched on) are read with read_bytes_view() and stored as kaitai::bytes_view
+bool StoresBytesView(const ir::Attr& attr, const std::map<std::string, ir::TypeRef>& user_types,
+                     const RuntimeOptions& runtime) {
+  if (!runtime.bytes_view || attr.repeat != ir::Attr::RepeatKind::kNone || attr.switch_on.has_value() ||
+      attr.process.has_value()) {
+    return false;
+  }
+  const auto primitive = ResolvePrimitiveType(attr.type, user_types);
+  return primitive.has_value() && *primitive == ir::PrimitiveType::kBytes;
+}
+
+std::string BytesViewReadExpr(const ir::Attr& attr, const std::set<std::string>& attrs,
+                              const std::set<std::string>& instances) {
+  if (!attr.size_expr.has_value()) return "m__io->read_bytes_full_view()";
+  return "m__io->read_bytes_view(" + RenderExpr(*attr.size_expr, attrs, instances, -1) + ")";
+}
+
+// With --cpp-lazy-str, sized `str` fields (not repeated or switched on) are
+// stored as kaitai::lazy_str, which decodes the bytes on first access
+bool StoresLazyStr(const ir::Attr& attr, const std::map<std::string, ir::TypeRef>& user_types,
+                   const RuntimeOptions& runtime) {
+  if (!runtime.lazy_str || attr.repeat != ir::Attr::RepeatKind::kNone || attr.switch_on.has_value() ||
+      !attr.size_expr.has_value()) {
+    return false;
+  }
+  const auto primitive = ResolvePrimitiveType(attr.type, user_types);
+  return primitive.has_value() && *primitive == ir::PrimitiveType::kStr;
+}
+
+std::string LazyStrReadExpr(const ir::Attr& attr, const std::set<std::string>& attrs,
+                            const std::set<std::string>& instances) {
+  return "kaitai::lazy_str(m__io->read_bytes(" + RenderExpr(*attr.size_expr, attrs, instances, -1) + "), \"" +
+         attr.encoding.value_or("UTF-8") + "\")";
+}
+
+// Storage type of fields kept as a runtime helper class rather than as the
+// type their accessor returns
+std::optional<std::string> RuntimeStorageType(const ir::Attr& attr,
+                                              const std::map<std::string, ir::TypeRef>& user_types,
+                                              const RuntimeOptions& runtime) {
+  if (StoresBytesView(attr, user_types, runtime)) return "kaitai::bytes_view";
+  if (StoresLazyStr(attr, user_types, runtime)) return "kaitai::lazy_str";
+  return std::nullopt;
+}
+
 std::string CppFieldType(ir::PrimitiveType primitive) {
   switch (primitive) {
   case ir::PrimitiveType::kU1: return "uint8_t";
@@ -824,12 +1008,131 @@ std::string CppReadParseInstanceExpr(const ir::Instance& inst, ir::Endian defaul
   if (primitive == ir::PrimitiveType::kStr) {
     if (!inst.size_expr.has_value()) return "std::string()";
     const std::string enc = inst.encoding.value_or("UTF-8");
-    return "kaitai::kstream::bytes_to_str(m__io->read_bytes(" +
-           RenderExpr(*inst.size_expr, attrs, instances, -1) + "), \"" + enc + "\")";
+    return BytesToStrExpr("m__io->read_bytes(" + RenderExpr(*inst.size_expr, attrs, instances, -1) + ")", enc);
   }
   return "m__io->" + ReadMethod(primitive, inst.endian_override.value_or(default_endian)) + "()";
 }
 
+std::optional<int> PrimitiveByteSize(ir::PrimitiveType primitive) {
+  switch (primitive) {
+  case ir::PrimitiveType::kU1: return 1;
+  case ir::PrimitiveType::kU2: return 2;
+  case ir::PrimitiveType::kU4: return 4;
+  case ir::PrimitiveType::kU8: return 8;
+  case ir::PrimitiveType::kS1: return 1;
+  case ir::PrimitiveType::kS2: return 2;
+  case ir::PrimitiveType::kS4: return 4;
+  case ir::PrimitiveType::kS8: return 8;
+  case ir::PrimitiveType::kF4: return 4;
+  case ir::PrimitiveType::kF8: return 8;
+  default: return std::nullopt;
+  }
+}
+
+// Smallest read worth an advise() call: the runtime ignores shorter ranges,
+// which are loaded in a single page fault or read anyway
+constexpr long long kMinAdviseLen = 4096;
+
+// Number of bytes a parse instance reads, if it's known before reading it and
+// large enough to be worth an access hint: a constant, or a field or parameter
+// (`attrs`), never another instance, which would be parsed early
+std::optional<std::string> CppParseInstanceSize(const ir::Instance& inst,
+                                                const std::set<std::string>& attrs,
+                                                const std::set<std::string>& instances,
+                                                const std::map<std::string, ir::TypeRef>& user_types) {
+  const auto resolved = ResolvePrimitiveType(inst.type, user_types);
+  if (!resolved.has_value()) return std::nullopt;
+  if (*resolved != ir::PrimitiveType::kBytes && *resolved != ir::PrimitiveType::kStr) return std::nullopt;
+  if (!inst.size_expr.has_value()) return std::nullopt;
+  const ir::Expr& size = *inst.size_expr;
+  switch (size.kind) {
+  case ir::Expr::Kind::kInt:
+    if (size.int_value < kMinAdviseLen) return std::nullopt;
+    break;
+  case ir::Expr::Kind::kName:
+    if (attrs.find(size.text) == attrs.end()) return std::nullopt;
+    break;
+  default:
+    return std::nullopt;
+  }
+  return RenderExpr(size, attrs, instances, -1);
+}
+
+// Number of bytes `attr` always reads, if it is a plain numeric field that can
+// share a single ensure_available() check with its neighbours
+std::optional<int> FixedReadSize(const ir::Attr& attr, const std::map<std::string, ir::TypeRef>& user_types) {
+  if (attr.if_expr.has_value() || attr.repeat != ir::Attr::RepeatKind::kNone ||
+      attr.switch_on.has_value() || attr.process.has_value()) {
+    return std::nullopt;
+  }
+  const auto primitive = ResolvePrimitiveType(attr.type, user_types);
+  if (!primitive.has_value()) return std::nullopt;
+  return PrimitiveByteSize(*primitive);
+}
+
+// Longest run of fixed-size fields sharing one check: as a run is emitted
+// twice, longer ones are split so that neither copy grows without bound
+constexpr size_t kMaxFixedSizeRun = 16;
+
+// End of the run of fixed-size fields starting at `begin`
+size_t FixedSizeRunEnd(const std::vector<ir::Attr>& attrs, size_t begin,
+                       const std::map<std::string, ir::TypeRef>& user_types) {
+  size_t end = begin;
+  while (end < attrs.size() && end - begin < kMaxFixedSizeRun &&
+         FixedReadSize(attrs[end], user_types).has_value()) {
+    end++;
+  }
+  return end;
+}
+
+// Reads attrs [begin, end) with a single bounds check when the stream has them
+// all at hand, and with the regular reads (and their errors) otherwise.
+// `read_expr(attr, unchecked)` renders the read of one field.
+void EmitFixedSizeRun(std::ostringstream* out, const std::vector<ir::Attr>& attrs, size_t begin, size_t end,
+                      const std::map<std::string, ir::TypeRef>& user_types,
+                      const std::function<std::string(const ir::Attr&, bool)>& read_expr) {
+  int size = 0;
+  for (size_t i = begin; i < end; i++) size += *FixedReadSize(attrs[i], user_types);
+  *out << "    if (m__io->ensure_available(" << size << ")) {\n";
+  for (size_t i = begin; i < end; i++) {
+    *out << "        m_" << attrs[i].id << " = " << read_expr(attrs[i], true) << ";\n";
+  }
+  *out << "    } else {\n";
+  for (size_t i = begin; i < end; i++) {
+    *out << "        m_" << attrs[i].id << " = " << read_expr(attrs[i], false) << ";\n";
+  }
+  *out << "    }\n";
+}
+
+// Bulk reader filling a whole repeat-eos / repeat-expr array of plain numbers
+// at once (kaitai::kstream::read_*_array), if `attr` is one
+std::optional<std::string> BulkArrayReadMethod(const ir::Attr& attr, ir::Endian default_endian,
+                                               const std::map<std::string, ir::TypeRef>& user_types) {
+  if ((attr.repeat != ir::Attr::RepeatKind::kEos && attr.repeat != ir::Attr::RepeatKind::kExpr) ||
+      attr.switch_on.has_value() || attr.enum_name.has_value() || attr.process.has_value()) {
+    return std::nullopt;
+  }
+  const auto primitive = ResolvePrimitiveType(attr.type, user_types);
+  if (!primitive.has_value() || !PrimitiveByteSize(*primitive).has_value()) return std::nullopt;
+  return ReadMethod(*primitive, attr.endian_override.value_or(default_endian)) + "_array";
+}
+
+// Reads the items of a repeated field with `method` (see BulkArrayReadMethod)
+// into the already allocated m_<id> vector
+void EmitBulkArrayRead(std::ostringstream* out, const std::string& ind, const ir::Attr& attr,
+                       const std::string& method, const std::string& count_expr,
+                       const RuntimeOptions& runtime) {
+  if (attr.repeat == ir::Attr::RepeatKind::kEos) {
+    *out << ind << "m__io->" << method << "_eos(*m_" << attr.id << ");\n";
+  } else {
+    *out << ind << "const int l_" << attr.id << " = " << count_expr << ";\n";
+    *out << ind << "if (l_" << attr.id << " > 0) {\n";
+    *out << ind << "    m__io->" << method << "(*m_" << attr.id << ", l_" << attr.id << ");\n";
+    *out << ind << "}\n";
+  }
+  EmitStatusCheck(out, ind, runtime);
+}
+
 bool NeedsVectorInclude(const ir::Spec& spec) {
   for (const auto& attr : spec.attrs) {
     if (attr.repeat != ir::Attr::RepeatKind::kNone) return true;
@@ -1041,19 +1344,22 @@ void EmitNestedClassHeader(std::ostringstream* out,
                            const std::string& scope_name,
                            const std::map<std::string, ir::Spec>& scopes,
                            const std::map<std::string, ir::TypeRef>& user_types,
+                           const RuntimeOptions& runtime,
                            int indent);
 
 void EmitNestedClassSource(std::ostringstream* out,
                            const std::string& root_name,
                            const std::string& scope_name,
                            const std::map<std::string, ir::Spec>& scopes,
-                           const std::map<std::string, ir::TypeRef>& user_types);
+                           const std::map<std::string, ir::TypeRef>& user_types,
+                           const RuntimeOptions& runtime);
 
 void EmitNestedClassHeader(std::ostringstream* out,
                            const std::string& root_name,
                            const std::string& scope_name,
                            const std::map<std::string, ir::Spec>& scopes,
                            const std::map<std::string, ir::TypeRef>& user_types,
+                           const RuntimeOptions& runtime,
                            int indent) {
   const auto it = scopes.find(scope_name);
   if (it == scopes.end()) return;
@@ -1092,7 +1398,7 @@ void EmitNestedClassHeader(std::ostringstream* out,
     *out << "\n";
   }
 
-  *out << ind1 << class_name << "(kaitai::kstream* p__io, " << parent_ptr_type
+  *out << ind1 << class_name << "(" << CppStreamType(runtime) << "* p__io, " << parent_ptr_type
        << " p__parent = nullptr, " << root_name << "_t* p__root = nullptr);\n\n";
   *out << ind << "private:\n";
   *out << ind1 << "void _read();\n";
@@ -1102,7 +1408,7 @@ void EmitNestedClassHeader(std::ostringstream* out,
 
   for (const auto& child : children) {
     *out << "\n";
-    EmitNestedClassHeader(out, root_name, child, scopes, user_types, indent + 1);
+    EmitNestedClassHeader(out, root_name, child, scopes, user_types, runtime, indent + 1);
   }
   if (!children.empty()) {
     *out << "\n";
@@ -1111,9 +1417,14 @@ void EmitNestedClassHeader(std::ostringstream* out,
 
   for (const auto& attr : scope_spec.attrs) {
     const std::string access_type =
-        NestedAttrAccessorType(attr, scope_name, root_name, scopes, user_types);
+        StoresBytesView(attr, user_types, runtime)
+            ? "kaitai::bytes_view"
+            : StoresLazyStr(attr, user_types, runtime)
+                  ? "const std::string&"
+                  : NestedAttrAccessorType(attr, scope_name, root_name, scopes, user_types);
     if (attr.repeat != ir::Attr::RepeatKind::kNone ||
-        (IsUnresolvedUserType(attr.type, user_types) && !attr.switch_on.has_value())) {
+        (IsUnresolvedUserType(attr.type, user_types) && !attr.switch_on.has_value()) ||
+        StoresLazyStr(attr, user_types, runtime)) {
       *out << ind1 << access_type << " " << attr.id << "() const { return m_" << attr.id
            << ".get(); }\n";
     } else {
@@ -1123,14 +1434,21 @@ void EmitNestedClassHeader(std::ostringstream* out,
   }
   *out << ind1 << root_name << "_t* _root() const { return m__root; }\n";
   *out << ind1 << parent_ptr_type << " _parent() const { return m__parent; }\n";
+  EmitTypedIoAccessor(out, ind1, runtime);
+  for (const auto& attr : scope_spec.attrs) {
+    if (UsesSubstream(attr, user_types) && !runtime.zero_copy_substream) {
+      *out << Indent(indent) << SubstreamRawAccessor(attr);
+    }
+  }
 
   *out << "\n";
   *out << ind << "private:\n";
   bool has_nullable_switch = false;
   for (const auto& attr : scope_spec.attrs) {
     *out << ind1
-         << NestedAttrStorageType(attr, scope_name, root_name, scopes, user_types) << " m_"
-         << attr.id << ";\n";
+         << RuntimeStorageType(attr, user_types, runtime)
+                .value_or(NestedAttrStorageType(attr, scope_name, root_name, scopes, user_types))
+         << " m_" << attr.id << ";\n";
     if (attr.switch_on.has_value() && !HasSwitchElseCase(attr)) {
       has_nullable_switch = true;
       *out << ind1 << "bool n_" << attr.id << ";\n";
@@ -1150,6 +1468,10 @@ void EmitNestedClassHeader(std::ostringstream* out,
   }
   *out << ind1 << root_name << "_t* m__root;\n";
   *out << ind1 << parent_ptr_type << " m__parent;\n";
+  EmitTypedIoMember(out, ind1, runtime);
+  for (const auto& attr : scope_spec.attrs) {
+    if (UsesSubstream(attr, user_types)) EmitSubstreamMembers(out, ind1, attr, runtime);
+  }
   *out << ind << "};\n";
 }
 
@@ -1157,7 +1479,8 @@ void EmitNestedClassSource(std::ostringstream* out,
                            const std::string& root_name,
                            const std::string& scope_name,
                            const std::map<std::string, ir::Spec>& scopes,
-                           const std::map<std::string, ir::TypeRef>& user_types) {
+                           const std::map<std::string, ir::TypeRef>& user_types,
+                           const RuntimeOptions& runtime) {
   const auto it = scopes.find(scope_name);
   if (it == scopes.end()) return;
   const ir::Spec& scope_spec = it->second;
@@ -1177,7 +1500,7 @@ void EmitNestedClassSource(std::ostringstream* out,
     return NestedEnumTypeName(enum_name);
   };
 
-  auto read_scope_user = [&](const ir::Attr& attr) {
+  auto read_scope_user = [&](const ir::Attr& attr, const std::string& io) {
     const auto resolved = ResolveScopeRef(attr.type.user_type, root_name, scopes);
     std::string type_expr = resolved.has_value()
                                 ? ScopeLocalTypeToken(root_name, scope_name, *resolved)
@@ -1190,9 +1513,14 @@ void EmitNestedClassSource(std::ostringstream* out,
       first = false;
     }
     if (!first) ctor_args << ", ";
-    ctor_args << "m__io, this, m__root";
+    ctor_args << io << ", this, m__root";
     return "std::unique_ptr<" + type_expr + ">(new " + type_expr + "(" + ctor_args.str() + "))";
   };
+  // Emits the substream for one item of `attr` if it needs one and returns the IO to parse it from
+  auto scope_user_io = [&](const ir::Attr& attr, const std::string& ind) -> std::string {
+    if (!UsesSubstream(attr, user_types)) return "m__io";
+    return EmitSubstream(out, ind, attr, RenderExpr(*attr.size_expr, attrs, instances, -1), runtime);
+  };
 
   for (const auto& e : scope_spec.enums) {
     const std::string enum_ty = NestedEnumTypeName(e.name);
@@ -1211,8 +1539,9 @@ void EmitNestedClassSource(std::ostringstream* out,
     *out << "}\n\n";
   }
 
-  *out << full_class << "::" << class_name << "(kaitai::kstream* p__io, " << parent_ptr_type
+  *out << full_class << "::" << class_name << "(" << CppStreamType(runtime) << "* p__io, " << parent_ptr_type
        << " p__parent, " << root_name << "_t* p__root) : kaitai::kstruct(p__io) {\n";
+  if (!runtime.stream_backend.empty()) *out << "    m__io = p__io;\n";
   *out << "    m__parent = p__parent;\n";
   *out << "    m__root = p__root;\n";
   for (const auto& attr : scope_spec.attrs) {
@@ -1225,7 +1554,22 @@ void EmitNestedClassSource(std::ostringstream* out,
   *out << "}\n\n";
 
   *out << "void " << full_class << "::_read() {\n";
-  for (const auto& attr : scope_spec.attrs) {
+  auto read_fixed = [&](const ir::Attr& attr, bool unchecked) {
+    const auto primitive = ResolvePrimitiveType(attr.type, user_types).value_or(ir::PrimitiveType::kU1);
+    const std::string read =
+        CppReadPrimitiveExpr(primitive, attr.endian_override, scope_spec.default_endian, unchecked);
+    if (attr.enum_name.has_value()) return "static_cast<" + enum_cast_type(*attr.enum_name) + ">(" + read + ")";
+    return read;
+  };
+  for (size_t attr_idx = 0; attr_idx < scope_spec.attrs.size(); attr_idx++) {
+    const auto& attr = scope_spec.attrs[attr_idx];
+    const size_t run_end = FixedSizeRunEnd(scope_spec.attrs, attr_idx, user_types);
+    if (run_end - attr_idx >= 2) {
+      EmitFixedSizeRun(out, scope_spec.attrs, attr_idx, run_end, user_types, read_fixed);
+      EmitStatusCheck(out, "    ", runtime);
+      attr_idx = run_end - 1;
+      continue;
+    }
     if (attr.switch_on.has_value() && attr.repeat == ir::Attr::RepeatKind::kNone) {
       const bool has_else = HasSwitchElseCase(attr);
       if (!has_else) {
@@ -1249,20 +1593,27 @@ void EmitNestedClassSource(std::ostringstream* out,
         *out << "    }\n";
       }
       *out << "    }\n";
+      EmitStatusCheck(out, "    ", runtime);
       continue;
     }
 
     if (attr.repeat == ir::Attr::RepeatKind::kNone) {
       if (IsUnresolvedUserType(attr.type, user_types) && !attr.switch_on.has_value()) {
-        *out << "    m_" << attr.id << " = " << read_scope_user(attr) << ";\n";
+        const std::string io = scope_user_io(attr, "    ");
+        *out << "    m_" << attr.id << " = " << read_scope_user(attr, io) << ";\n";
       } else if (attr.enum_name.has_value()) {
         const auto primitive = ResolvePrimitiveType(attr.type, user_types).value_or(ir::PrimitiveType::kU1);
         *out << "    m_" << attr.id << " = static_cast<" << enum_cast_type(*attr.enum_name) << ">("
              << CppReadPrimitiveExpr(primitive, attr.endian_override, scope_spec.default_endian) << ");\n";
+      } else if (StoresBytesView(attr, user_types, runtime)) {
+        *out << "    m_" << attr.id << " = " << BytesViewReadExpr(attr, attrs, instances) << ";\n";
+      } else if (StoresLazyStr(attr, user_types, runtime)) {
+        *out << "    m_" << attr.id << " = " << LazyStrReadExpr(attr, attrs, instances) << ";\n";
       } else {
         *out << "    m_" << attr.id << " = "
              << ReadExpr(attr, scope_spec.default_endian, attrs, instances, user_types) << ";\n";
       }
+      EmitStatusCheck(out, "    ", runtime);
       continue;
     }
 
@@ -1278,35 +1629,48 @@ void EmitNestedClassSource(std::ostringstream* out,
 
     *out << "    m_" << attr.id << " = std::unique_ptr<std::vector<" << repeat_elem
          << ">>(new std::vector<" << repeat_elem << ">());\n";
-    if (attr.repeat == ir::Attr::RepeatKind::kEos) {
+    if (UsesSubstream(attr, user_types)) EmitSubstreamArraysInit(out, "    ", attr, runtime);
+    const auto bulk_method = BulkArrayReadMethod(attr, scope_spec.default_endian, user_types);
+    if (bulk_method.has_value()) {
+      const std::string count_expr = attr.repeat == ir::Attr::RepeatKind::kExpr
+                                         ? RenderExpr(*attr.repeat_expr, attrs, instances, -1)
+                                         : std::string();
+      EmitBulkArrayRead(out, "    ", attr, *bulk_method, count_expr, runtime);
+    } else if (attr.repeat == ir::Attr::RepeatKind::kEos) {
       *out << "    while (!m__io->is_eof()) {\n";
       if (IsUnresolvedUserType(attr.type, user_types) && !attr.switch_on.has_value()) {
-        *out << "        m_" << attr.id << "->push_back(" << read_scope_user(attr) << ");\n";
+        const std::string io = scope_user_io(attr, "        ");
+        *out << "        m_" << attr.id << "->push_back(" << read_scope_user(attr, io) << ");\n";
       } else {
         *out << "        m_" << attr.id << "->push_back("
              << ReadExpr(attr, scope_spec.default_endian, attrs, instances, user_types) << ");\n";
       }
+      EmitStatusCheck(out, "        ", runtime);
       *out << "    }\n";
     } else if (attr.repeat == ir::Attr::RepeatKind::kExpr) {
       *out << "    const int l_" << attr.id << " = " << RenderExpr(*attr.repeat_expr, attrs, instances, -1)
            << ";\n";
       *out << "    for (int i = 0; i < l_" << attr.id << "; i++) {\n";
       if (IsUnresolvedUserType(attr.type, user_types) && !attr.switch_on.has_value()) {
-        *out << "        m_" << attr.id << "->push_back(" << read_scope_user(attr) << ");\n";
+        const std::string io = scope_user_io(attr, "        ");
+        *out << "        m_" << attr.id << "->push_back(" << read_scope_user(attr, io) << ");\n";
       } else {
         *out << "        m_" << attr.id << "->push_back(std::move("
              << ReadExpr(attr, scope_spec.default_endian, attrs, instances, user_types) << "));\n";
       }
+      EmitStatusCheck(out, "        ", runtime);
       *out << "    }\n";
     } else {
       *out << "    do {\n";
       if (IsUnresolvedUserType(attr.type, user_types) && !attr.switch_on.has_value()) {
-        *out << "        auto repeat_item = " << read_scope_user(attr) << ";\n";
+        const std::string io = scope_user_io(attr, "        ");
+        *out << "        auto repeat_item = " << read_scope_user(attr, io) << ";\n";
       } else {
         *out << "        auto repeat_item = "
              << ReadExpr(attr, scope_spec.default_endian, attrs, instances, user_types) << ";\n";
       }
       *out << "        m_" << attr.id << "->push_back(std::move(repeat_item));\n";
+      EmitStatusCheck(out, "        ", runtime);
       *out << "    } while (!("
            << RenderExpr(*attr.repeat_expr, attrs, instances, -1, "repeat_item") << "));\n";
     }
@@ -1329,11 +1693,11 @@ void EmitNestedClassSource(std::ostringstream* out,
   *out << "\n";
 
   for (const auto& child : DirectChildScopes(scopes, scope_name)) {
-    EmitNestedClassSource(out, root_name, child, scopes, user_types);
+    EmitNestedClassSource(out, root_name, child, scopes, user_types, runtime);
   }
 }
 
-std::string RenderHeader(const ir::Spec& spec) {
+std::string RenderHeader(const ir::Spec& spec, const RuntimeOptions& runtime) {
   const auto instance_types = ComputeInstanceTypes(spec);
   const auto user_types = BuildUserTypeMap(spec);
   const auto local_scopes = DecodeEmbeddedScopes(spec);
@@ -1363,7 +1727,7 @@ std::string RenderHeader(const ir::Spec& spec) {
     for (const auto& p : spec.params) {
       args << CppTypeForTypeRef(p.type, user_types) << " p_" << p.id << ", ";
     }
-    args << "kaitai::kstream* p__io, kaitai::kstruct* p__parent = nullptr, " << spec.name
+    args << CppStreamType(runtime) << "* p__io, kaitai::kstruct* p__parent = nullptr, " << spec.name
          << "_t* p__root = nullptr";
     return args.str();
   };
@@ -1372,6 +1736,7 @@ std::string RenderHeader(const ir::Spec& spec) {
   out << "// This is a generated file! Please edit source .ksy file and use kaitai-struct-compiler to rebuild\n\n";
   out << "class " << spec.name << "_t;\n\n";
   out << "#include \"kaitai/kaitaistruct.h\"\n";
+  if (!runtime.stream_backend.empty()) out << "#include \"kaitai/basic_kstream.h\"\n";
   out << "#include <kaitai/exceptions.h>\n";
   out << "#include <stdint.h>\n";
   out << "#include <memory>\n";
@@ -1423,7 +1788,7 @@ std::string RenderHeader(const ir::Spec& spec) {
   out << "    ~" << spec.name << "_t();\n";
   for (const auto& child : root_children) {
     out << "\n";
-    EmitNestedClassHeader(&out, spec.name, child, local_scopes, user_types, 1);
+    EmitNestedClassHeader(&out, spec.name, child, local_scopes, user_types, runtime, 1);
   }
   if (!local_scopes.empty()) {
     out << "\npublic:\n";
@@ -1431,7 +1796,10 @@ std::string RenderHeader(const ir::Spec& spec) {
   std::vector<std::string> raw_accessors;
   std::vector<std::string> raw_fields;
   for (const auto& inst : spec.instances) {
-    out << "    " << CppInstanceType(inst, instance_types, user_types) << " " << inst.id << "();\n";
+    out << "    " << CppInstanceType(inst, instance_types, user_types) << " " << inst.id << "();";
+    // Accessors can't return early like _read() does
+    if (runtime.error_status) out << " // check _io()->ok() after calling";
+    out << "\n";
   }
   for (const auto& p : spec.params) {
     out << "    " << CppTypeForTypeRef(p.type, user_types) << " " << p.id << "() const { return m_"
@@ -1443,6 +1811,10 @@ std::string RenderHeader(const ir::Spec& spec) {
       out << "    " << CppAccessorType(attr, user_types) << " " << attr.id << "() const { return m_" << attr.id << ".get(); }\n";
     } else if (unresolved_user) {
       out << "    " << CppAccessorType(attr, user_types) << " " << attr.id << "() const { return m_" << attr.id << ".get(); }\n";
+    } else if (StoresBytesView(attr, user_types, runtime)) {
+      out << "    kaitai::bytes_view " << attr.id << "() const { return m_" << attr.id << "; }\n";
+    } else if (StoresLazyStr(attr, user_types, runtime)) {
+      out << "    const std::string& " << attr.id << "() const { return m_" << attr.id << ".get(); }\n";
     } else {
       out << "    " << CppAccessorType(attr, user_types) << " " << attr.id << "() const { return m_" << attr.id << "; }\n";
     }
@@ -1454,9 +1826,13 @@ std::string RenderHeader(const ir::Spec& spec) {
       raw_accessors.push_back("    std::string _raw_" + attr.id + "() const { return m__raw_" + attr.id + "; }\n");
       raw_fields.push_back("    std::string m__raw_" + attr.id + ";\n");
     }
+    if (UsesSubstream(attr, user_types) && !runtime.zero_copy_substream) {
+      raw_accessors.push_back(SubstreamRawAccessor(attr));
+    }
   }
   out << "    " << spec.name << "_t* _root() const { return m__root; }\n";
   out << "    kaitai::kstruct* _parent() const { return m__parent; }\n";
+  EmitTypedIoAccessor(&out, "    ", runtime);
   for (const auto& acc : raw_accessors) out << acc;
   out << "\n";
   out << "private:\n";
@@ -1468,11 +1844,17 @@ std::string RenderHeader(const ir::Spec& spec) {
     out << "    " << CppTypeForTypeRef(p.type, user_types) << " m_" << p.id << ";\n";
   }
   for (const auto& attr : spec.attrs) {
-    out << "    " << CppStorageType(attr, user_types) << " m_" << attr.id << ";\n";
+    const std::string storage_type =
+        RuntimeStorageType(attr, user_types, runtime).value_or(CppStorageType(attr, user_types));
+    out << "    " << storage_type << " m_" << attr.id << ";\n";
   }
   out << "    " << spec.name << "_t* m__root;\n";
   out << "    kaitai::kstruct* m__parent;\n";
+  EmitTypedIoMember(&out, "    ", runtime);
   for (const auto& field : raw_fields) out << field;
+  for (const auto& attr : spec.attrs) {
+    if (UsesSubstream(attr, user_types)) EmitSubstreamMembers(&out, "    ", attr, runtime);
+  }
   out << "};\n";
   return out.str();
 }
@@ -1495,7 +1877,7 @@ std::string ValidationValueType(const std::string& target, const ir::Spec& spec,
   return "int32_t";
 }
 
-std::string RenderSource(const ir::Spec& spec) {
+std::string RenderSource(const ir::Spec& spec, const RuntimeOptions& runtime) {
   const auto instance_types = ComputeInstanceTypes(spec);
   const auto user_types = BuildUserTypeMap(spec);
   const auto local_scopes = DecodeEmbeddedScopes(spec);
@@ -1504,7 +1886,7 @@ std::string RenderSource(const ir::Spec& spec) {
     for (const auto& p : spec.params) {
       args << CppTypeForTypeRef(p.type, user_types) << " p_" << p.id << ", ";
     }
-    args << "kaitai::kstream* p__io, kaitai::kstruct* p__parent, " << spec.name << "_t* p__root";
+    args << CppStreamType(runtime) << "* p__io, kaitai::kstruct* p__parent, " << spec.name << "_t* p__root";
     return args.str();
   };
   std::set<std::string> attr_names;
@@ -1519,6 +1901,7 @@ std::string RenderSource(const ir::Spec& spec) {
   }
   out << "\n";
   out << spec.name << "_t::" << spec.name << "_t(" << ctor_param_decl() << ") : kaitai::kstruct(p__io) {\n";
+  if (!runtime.stream_backend.empty()) out << "    m__io = p__io;\n";
   out << "    m__parent = p__parent;\n";
   out << "    m__root = p__root ? p__root : this;\n";
   for (const auto& p : spec.params) {
@@ -1535,7 +1918,38 @@ std::string RenderSource(const ir::Spec& spec) {
   out << "}\n\n";
 
   out << "void " << spec.name << "_t::_read() {\n";
-  for (const auto& attr : spec.attrs) {
+  auto read_fixed = [&](const ir::Attr& attr, bool unchecked) {
+    const auto primitive = ResolvePrimitiveType(attr.type, user_types).value_or(ir::PrimitiveType::kU1);
+    const std::string read =
+        CppReadPrimitiveExpr(primitive, attr.endian_override, spec.default_endian, unchecked);
+    if (attr.enum_name.has_value()) return "static_cast<" + EnumCppTypeName(*attr.enum_name) + ">(" + read + ")";
+    return read;
+  };
+  // Validations run once the whole seq is read: with --cpp-error-status, the
+  // start of each validated field is kept so that its error points at it
+  std::set<std::string> validated_attrs;
+  if (runtime.error_status) {
+    for (const auto& validation : spec.validations) validated_attrs.insert(validation.target);
+  }
+  for (size_t attr_idx = 0; attr_idx < spec.attrs.size(); attr_idx++) {
+    const auto& attr = spec.attrs[attr_idx];
+    const size_t run_end = FixedSizeRunEnd(spec.attrs, attr_idx, user_types);
+    if (run_end - attr_idx >= 2) {
+      int offset = 0;
+      for (size_t i = attr_idx; i < run_end; i++) {
+        if (validated_attrs.count(spec.attrs[i].id) > 0) {
+          out << "    const uint64_t _pos_" << spec.attrs[i].id << " = m__io->pos()";
+          if (offset > 0) out << " + " << offset;
+          out << ";\n";
+        }
+        offset += *FixedReadSize(spec.attrs[i], user_types);
+      }
+      EmitFixedSizeRun(&out, spec.attrs, attr_idx, run_end, user_types, read_fixed);
+      EmitStatusCheck(&out, "    ", runtime);
+      attr_idx = run_end - 1;
+      continue;
+    }
+    if (validated_attrs.count(attr.id) > 0) out << "    const uint64_t _pos_" << attr.id << " = m__io->pos();\n";
     if (attr.if_expr.has_value()) {
       const std::string cond = RenderExpr(*attr.if_expr, attr_names, {}, -1);
       out << "    if (" << cond << ") {\n";
@@ -1562,7 +1976,7 @@ std::string RenderSource(const ir::Spec& spec) {
           }
           if (!has_else) {
             out << indent << "default: {\n";
-            out << nested_indent << "throw std::runtime_error(\"switch-on has no matching case\");\n";
+            EmitInvalidError(&out, nested_indent, "std::runtime_error(\"switch-on has no matching case\")", runtime);
             out << indent << "}\n";
           }
           out << indent << "}\n";
@@ -1580,22 +1994,44 @@ std::string RenderSource(const ir::Spec& spec) {
           out << indent << "m__raw_" << attr.id << " = " << raw_read << ";\n";
           out << indent << "m_" << attr.id << " = kaitai::kstream::process_xor_one(m__raw_" << attr.id
               << ", " << attr.process->xor_const << ");\n";
+        } else if (UsesSubstream(attr, user_types)) {
+          const std::string io = EmitSubstream(&out, indent, attr, RenderExpr(*attr.size_expr, attr_names, {}, -1), runtime);
+          out << indent << "m_" << attr.id << " = " << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types, io) << ";\n";
+        } else if (StoresBytesView(attr, user_types, runtime)) {
+          out << indent << "m_" << attr.id << " = " << BytesViewReadExpr(attr, attr_names, {}) << ";\n";
+        } else if (StoresLazyStr(attr, user_types, runtime)) {
+          out << indent << "m_" << attr.id << " = " << LazyStrReadExpr(attr, attr_names, {}) << ";\n";
         } else {
           out << indent << "m_" << attr.id << " = " << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types) << ";\n";
         }
       }
+    } else if (BulkArrayReadMethod(attr, spec.default_endian, user_types).has_value()) {
+      const std::string repeat_elem = CppRepeatElementType(attr, user_types);
+      out << indent << "m_" << attr.id << " = std::unique_ptr<std::vector<" << repeat_elem
+          << ">>(new std::vector<" << repeat_elem << ">());\n";
+      const std::string count_expr = attr.repeat == ir::Attr::RepeatKind::kExpr
+                                         ? RenderExpr(*attr.repeat_expr, attr_names, {}, -1)
+                                         : std::string();
+      EmitBulkArrayRead(&out, indent, attr, *BulkArrayReadMethod(attr, spec.default_endian, user_types),
+                        count_expr, runtime);
     } else if (attr.repeat == ir::Attr::RepeatKind::kEos) {
       const std::string repeat_elem = CppRepeatElementType(attr, user_types);
       out << indent << "m_" << attr.id << " = std::unique_ptr<std::vector<" << repeat_elem
           << ">>(new std::vector<" << repeat_elem << ">());\n";
+      if (UsesSubstream(attr, user_types)) EmitSubstreamArraysInit(&out, indent, attr, runtime);
       const bool unresolved_user =
           IsUnresolvedUserType(attr.type, user_types) && !attr.switch_on.has_value();
       if (unresolved_user) {
         out << indent << "{\n";
         out << nested_indent << "int i = 0;\n";
         out << nested_indent << "while (!m__io->is_eof()) {\n";
+        std::string io = "m__io";
+        if (UsesSubstream(attr, user_types)) {
+          io = EmitSubstream(&out, nested_indent + "    ", attr, RenderExpr(*attr.size_expr, attr_names, {}, -1), runtime);
+        }
         out << nested_indent << "    m_" << attr.id << "->push_back(std::move("
-            << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types) << "));\n";
+            << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types, io) << "));\n";
+        EmitStatusCheck(&out, nested_indent + "    ", runtime);
         out << nested_indent << "    i++;\n";
         out << nested_indent << "}\n";
         out << indent << "}\n";
@@ -1603,31 +2039,49 @@ std::string RenderSource(const ir::Spec& spec) {
         out << indent << "while (!m__io->is_eof()) {\n";
         if (attr.switch_on.has_value()) out << nested_indent << "m_" << attr.id << "->push_back(" << ReadSwitchExpr(attr, spec.default_endian, attr_names, {}, user_types) << ");\n";
         else out << nested_indent << "m_" << attr.id << "->push_back(" << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types) << ");\n";
+        EmitStatusCheck(&out, nested_indent, runtime);
         out << indent << "}\n";
       }
     } else if (attr.repeat == ir::Attr::RepeatKind::kExpr) {
       const std::string repeat_elem = CppRepeatElementType(attr, user_types);
       out << indent << "m_" << attr.id << " = std::unique_ptr<std::vector<" << repeat_elem
           << ">>(new std::vector<" << repeat_elem << ">());\n";
+      if (UsesSubstream(attr, user_types)) EmitSubstreamArraysInit(&out, indent, attr, runtime);
       out << indent << "const int l_" << attr.id << " = " << RenderExpr(*attr.repeat_expr, attr_names, {}, -1) << ";\n";
       out << indent << "for (int i = 0; i < l_" << attr.id << "; i++) {\n";
-      if (attr.switch_on.has_value()) out << nested_indent << "m_" << attr.id << "->push_back(std::move(" << ReadSwitchExpr(attr, spec.default_endian, attr_names, {}, user_types) << "));\n";
-      else out << nested_indent << "m_" << attr.id << "->push_back(std::move(" << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types) << "));\n";
+      if (attr.switch_on.has_value()) {
+        out << nested_indent << "m_" << attr.id << "->push_back(std::move(" << ReadSwitchExpr(attr, spec.default_endian, attr_names, {}, user_types) << "));\n";
+      } else {
+        std::string io = "m__io";
+        if (UsesSubstream(attr, user_types)) {
+          io = EmitSubstream(&out, nested_indent, attr, RenderExpr(*attr.size_expr, attr_names, {}, -1), runtime);
+        }
+        out << nested_indent << "m_" << attr.id << "->push_back(std::move(" << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types, io) << "));\n";
+      }
+      EmitStatusCheck(&out, nested_indent, runtime);
       out << indent << "}\n";
     } else {
       const std::string repeat_elem = CppRepeatElementType(attr, user_types);
       out << indent << "m_" << attr.id << " = std::unique_ptr<std::vector<" << repeat_elem
           << ">>(new std::vector<" << repeat_elem << ">());\n";
+      if (UsesSubstream(attr, user_types)) EmitSubstreamArraysInit(&out, indent, attr, runtime);
       out << indent << "do {\n";
       if (attr.switch_on.has_value()) {
         out << nested_indent << "auto repeat_item = " << ReadSwitchExpr(attr, spec.default_endian, attr_names, {}, user_types) << ";\n";
       } else {
-        out << nested_indent << "auto repeat_item = " << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types) << ";\n";
+        std::string io = "m__io";
+        if (UsesSubstream(attr, user_types)) {
+          io = EmitSubstream(&out, nested_indent, attr, RenderExpr(*attr.size_expr, attr_names, {}, -1), runtime);
+        }
+        out << nested_indent << "auto repeat_item = " << ReadExpr(attr, spec.default_endian, attr_names, {}, user_types, io) << ";\n";
       }
       out << nested_indent << "m_" << attr.id << "->push_back(std::move(repeat_item));\n";
+      EmitStatusCheck(&out, nested_indent, runtime);
       out << indent << "} while (!(" << RenderExpr(*attr.repeat_expr, attr_names, {}, -1, "repeat_item") << "));\n";
     }
     if (attr.if_expr.has_value()) out << "    }\n";
+    // Repeated fields are checked item by item
+    if (attr.repeat == ir::Attr::RepeatKind::kNone) EmitStatusCheck(&out, "    ", runtime);
   }
   std::set<std::string> all_instance_names;
   for (const auto& inst : spec.instances) all_instance_names.insert(inst.id);
@@ -1651,8 +2105,11 @@ std::string RenderSource(const ir::Spec& spec) {
         const auto attr_index = attr_index_by_id[validation.target];
         const auto val_type = ValidationValueType(validation.target, spec, instance_types, user_types);
         out << "    if (!(m_" << validation.target << " == " << expected << ")) {\n";
-        out << "        throw kaitai::validation_not_equal_error<" << val_type << ">(" << expected
-            << ", m_" << validation.target << ", m__io, std::string(\"/seq/" << attr_index << "\"));\n";
+        EmitInvalidError(&out, "        ",
+                         "kaitai::validation_not_equal_error<" + val_type + ">(" + std::to_string(expected) +
+                             ", m_" + validation.target + ", m__io, std::string(\"/seq/" +
+                             std::to_string(attr_index) + "\"))",
+                         runtime, "_pos_" + validation.target);
         out << "    }\n";
         emitted_specialized = true;
       }
@@ -1662,8 +2119,11 @@ std::string RenderSource(const ir::Spec& spec) {
       const std::string val_expr = ValidationValueExpr(validation.target, attr_names, all_instance_names);
       const std::string val_type = ValidationValueType(validation.target, spec, instance_types, user_types);
       out << "    if (!(" << cond << ")) {\n";
-      out << "        throw kaitai::validation_expr_error<" << val_type << ">(" << val_expr
-          << ", m__io, \"/valid/" << validation.target << "\");\n";
+      EmitInvalidError(&out, "        ",
+                       "kaitai::validation_expr_error<" + val_type + ">(" + val_expr + ", m__io, \"/valid/" +
+                           validation.target + "\")",
+                       runtime,
+                       attr_index_by_id.count(validation.target) > 0 ? "_pos_" + validation.target : "m__io->pos()");
       out << "    }\n";
     }
   }
@@ -1690,7 +2150,7 @@ std::string RenderSource(const ir::Spec& spec) {
       }
     }
     for (const auto& child : root_children) {
-      EmitNestedClassSource(&out, spec.name, child, local_scopes, user_types);
+      EmitNestedClassSource(&out, spec.name, child, local_scopes, user_types, runtime);
     }
   }
 
@@ -1704,7 +2164,13 @@ std::string RenderSource(const ir::Spec& spec) {
     if (inst.kind == ir::Instance::Kind::kParse) {
       out << "    std::streampos _pos = m__io->pos();\n";
       if (inst.pos_expr.has_value()) {
-        out << "    m__io->seek(" << RenderExpr(*inst.pos_expr, attr_names, known_instances, -1) << ");\n";
+        const std::string pos = RenderExpr(*inst.pos_expr, attr_names, known_instances, -1);
+        const auto size = CppParseInstanceSize(inst, attr_names, known_instances, user_types);
+        if (size.has_value()) {
+          // Let the OS start loading the pages while the rest of the accessor runs
+          out << "    m__io->advise(kaitai::kstream::HINT_WILLNEED, " << pos << ", " << *size << ");\n";
+        }
+        out << "    m__io->seek(" << pos << ");\n";
       }
       out << "    m_" << inst.id << " = " << CppReadParseInstanceExpr(inst, spec.default_endian, attr_names, known_instances, user_types) << ";\n";
       out << "    m__io->seek(_pos);\n";
@@ -2437,8 +2903,8 @@ Result EmitCppStl17FromIr(const ir::Spec& spec, const CliOptions& options) {
   std::ofstream source(source_path);
   if (!source) return {false, "failed to open output file: " + source_path.string()};
 
-  header << RenderHeader(spec);
-  source << RenderSource(spec);
+  header << RenderHeader(spec, options.runtime);
+  source << RenderSource(spec, options.runtime);
   return {true, ""};
 }
 
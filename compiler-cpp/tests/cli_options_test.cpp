@@ -91,6 +91,43 @@ int main() {
     ok &= Check(r.status == kscpp::ParseStatus::kError, "invalid cpp standard rejected");
   }
 
+  {
+    auto r = Parse({"kscpp", "-t", "cpp_stl", "--cpp-standard", "17", "--cpp-stream-backend", "memory", "in.ksy"});
+    ok &= Check(r.status == kscpp::ParseStatus::kOk, "cpp stream backend parse status");
+    ok &= Check(r.options.runtime.stream_backend == "memory", "cpp stream backend parsed");
+    ok &= Check(kscpp::ValidateBackendCompatibility(r.options).empty(),
+                "cpp stream backend accepted for cpp_stl");
+  }
+
+  {
+    auto r = Parse({"kscpp", "-t", "cpp_stl", "--cpp-standard", "17", "--cpp-error-status", "in.ksy"});
+    ok &= Check(r.status == kscpp::ParseStatus::kOk, "cpp error status parse status");
+    ok &= Check(r.options.runtime.error_status, "cpp error status parsed");
+    ok &= Check(kscpp::ValidateBackendCompatibility(r.options).empty(),
+                "cpp error status accepted for cpp_stl");
+  }
+
+  {
+    auto r = Parse({"kscpp", "-t", "cpp_stl", "--cpp-standard", "17", "--cpp-bytes-view", "in.ksy"});
+    ok &= Check(r.status == kscpp::ParseStatus::kOk, "cpp bytes view parse status");
+    ok &= Check(r.options.runtime.bytes_view, "cpp bytes view parsed");
+    ok &= Check(kscpp::ValidateBackendCompatibility(r.options).empty(),
+                "cpp bytes view accepted for cpp_stl");
+  }
+
+  {
+    auto r = Parse({"kscpp", "-t", "cpp_stl", "--cpp-standard", "17", "--cpp-lazy-str", "in.ksy"});
+    ok &= Check(r.status == kscpp::ParseStatus::kOk, "cpp lazy str parse status");
+    ok &= Check(r.options.runtime.lazy_str, "cpp lazy str parsed");
+    ok &= Check(kscpp::ValidateBackendCompatibility(r.options).empty(),
+                "cpp lazy str accepted for cpp_stl");
+  }
+
+  {
+    auto r = Parse({"kscpp", "-t", "cpp_stl", "--cpp-stream-backend", "mmap"});
+    ok &= Check(r.status == kscpp::ParseStatus::kError, "invalid cpp stream backend rejected");
+  }
+
   {
     auto r = Parse({"kscpp", "-t", "invalid_lang"});
     ok &= Check(r.status == kscpp::ParseStatus::kError, "invalid target rejected");
@@ -122,6 +159,22 @@ int main() {
                           "--no-auto-read currently requires --read-write or --read-pos",
                           "--no-auto-read alone rejected consistently");
 
+  ok &= CheckBackendError({"kscpp", "-t", "python", "--cpp-stream-backend", "generic", "in.ksy"},
+                          "--cpp-stream-backend is only supported with target 'cpp_stl'",
+                          "cpp stream backend rejected for non-cpp target");
+
+  ok &= CheckBackendError({"kscpp", "-t", "python", "--cpp-error-status", "in.ksy"},
+                          "--cpp-error-status is only supported with target 'cpp_stl'",
+                          "cpp error status rejected for non-cpp target");
+
+  ok &= CheckBackendError({"kscpp", "-t", "ruby", "--cpp-bytes-view", "in.ksy"},
+                          "--cpp-bytes-view is only supported with target 'cpp_stl'",
+                          "cpp bytes view rejected for non-cpp target");
+
+  ok &= CheckBackendError({"kscpp", "-t", "ruby", "--cpp-lazy-str", "in.ksy"},
+                          "--cpp-lazy-str is only supported with target 'cpp_stl'",
+                          "cpp lazy str rejected for non-cpp target");
+
   ok &= CheckBackendError({"kscpp", "-t", "lua", "--python-package", "pkg", "in.ksy"},
                           "--python-package is only supported with target 'python'",
                           "python-package rejected for non-python delegated target");
@@ -190,6 +190,11 @@ int main() {
     str.encoding = "ASCII";
     spec.attrs.push_back(str);
 
+    kscpp::ir::Attr legacy_str = str;
+    legacy_str.id = "legacy_name";
+    legacy_str.encoding = "SJIS";
+    spec.attrs.push_back(legacy_str);
+
     kscpp::ir::Attr en;
     en.id = "pet";
     en.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
@@ -214,7 +219,11 @@ int main() {
     ok &= Check(h.find("std::string payload() const") != std::string::npos, "bytes accessor emitted");
     ok &= Check(c.find("m_f4v = m__io->read_f4le();") != std::string::npos, "f4 read emitted");
     ok &= Check(c.find("m_payload = m__io->read_bytes(4);") != std::string::npos, "bytes read emitted");
-    ok &= Check(c.find("read_bytes(3)") != std::string::npos && c.find("ASCII") != std::string::npos, "encoded string read emitted");
+    ok &= Check(c.find("m_name = kaitai::kstream::bytes_to_str_ascii(m__io->read_bytes(3));") != std::string::npos,
+                "encoded string read uses built-in decoder");
+    ok &= Check(c.find("m_legacy_name = kaitai::kstream::bytes_to_str(m__io->read_bytes(3), \"SJIS\");") !=
+                    std::string::npos,
+                "other encodings go through bytes_to_str");
     ok &= Check(c.find("m_pet = static_cast<animal_e>(m__io->read_u1());") != std::string::npos, "enum cast emitted");
   }
 
@@ -238,9 +247,9 @@ int main() {
     const std::string c = ReadAll(out / "control_flow_subset.cpp");
     ok &= Check(h.find("std::unique_ptr<std::vector<uint8_t>>") != std::string::npos,
                 "repeat attrs use vector storage");
-    ok &= Check(c.find("while (!m__io->is_eof())") != std::string::npos, "repeat-eos emitted");
-    ok &= Check(c.find("const int l_") != std::string::npos &&
-                c.find("for (int i = 0; i < l_") != std::string::npos,
+    ok &= Check(c.find("m__io->read_u1_array_eos(*m_items_eos);") != std::string::npos, "repeat-eos emitted");
+    ok &= Check(c.find("const int l_items_expr = 2;") != std::string::npos &&
+                c.find("m__io->read_u1_array(*m_items_expr, l_items_expr);") != std::string::npos,
                 "repeat-expr emitted");
     ok &= Check(c.find("do {") != std::string::npos && c.find("repeat_item == 255") != std::string::npos,
                 "repeat-until emitted");
@@ -311,6 +320,83 @@ int main() {
   }
 
 
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "substream_subset";
+    spec.default_endian = kscpp::ir::Endian::kLe;
+
+    kscpp::ir::Attr len;
+    len.id = "len";
+    len.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    len.type.primitive = kscpp::ir::PrimitiveType::kU1;
+    spec.attrs.push_back(len);
+
+    kscpp::ir::Attr body;
+    body.id = "body";
+    body.type.kind = kscpp::ir::TypeRef::Kind::kUser;
+    body.type.user_type = "chunk";
+    body.size_expr = kscpp::ir::Expr::Name("len");
+    spec.attrs.push_back(body);
+
+    kscpp::ir::Attr blocks;
+    blocks.id = "blocks";
+    blocks.type.kind = kscpp::ir::TypeRef::Kind::kUser;
+    blocks.type.user_type = "chunk";
+    blocks.size_expr = kscpp::ir::Expr::Int(16);
+    blocks.repeat = kscpp::ir::Attr::RepeatKind::kEos;
+    spec.attrs.push_back(blocks);
+
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_substream_test";
+    std::filesystem::remove_all(out);
+
+    kscpp::CliOptions options;
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "substream subset codegen succeeds");
+    std::string h = ReadAll(out / "substream_subset.h");
+    std::string c = ReadAll(out / "substream_subset.cpp");
+    ok &= Check(h.find("std::unique_ptr<kaitai::kstream> m__io__raw_body;") != std::string::npos,
+                "substream member emitted");
+    ok &= Check(h.find("m__raw_body") == std::string::npos, "no raw bytes stored for zero-copy substream");
+    ok &= Check(c.find("m__io__raw_body = std::unique_ptr<kaitai::kstream>(new kaitai::kstream(m__io, m__io->pos(), len()));") != std::string::npos,
+                "zero-copy substream window created");
+    ok &= Check(c.find("m__io->seek(m__io->pos() + m__io__raw_body->size());") != std::string::npos,
+                "parent stream advanced past substream");
+    ok &= Check(c.find("new chunk_t(m__io__raw_body.get())") != std::string::npos,
+                "user type parsed from substream");
+    ok &= Check(c.find("kaitai::kstream* io_blocks = new kaitai::kstream(m__io, m__io->pos(), 16);") != std::string::npos &&
+                c.find("m__io__raw_blocks->emplace_back(io_blocks);") != std::string::npos,
+                "repeated substreams are stored per item");
+
+    options.runtime.error_status = true;
+    r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "error status substream codegen succeeds");
+    c = ReadAll(out / "substream_subset.cpp");
+    ok &= Check(c.find("new kaitai::kstream(m__io, m__io->pos(), len()));\n"
+                       "    if (!m__io->ok()) return;\n"
+                       "    m__io->seek(m__io->pos() + m__io__raw_body->size());\n") != std::string::npos,
+                "substream past the end checked before seeking");
+    ok &= Check(c.find("m__io__raw_blocks->emplace_back(io_blocks);\n"
+                       "            if (!m__io->ok()) return;\n") != std::string::npos,
+                "repeated substream past the end checked before seeking");
+    options.runtime.error_status = false;
+
+    options.runtime.zero_copy_substream = false;
+    r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "buffered substream codegen succeeds");
+    h = ReadAll(out / "substream_subset.h");
+    c = ReadAll(out / "substream_subset.cpp");
+    ok &= Check(h.find("std::string _raw_body() const") != std::string::npos,
+                "raw bytes accessor emitted for buffered substream");
+    ok &= Check(c.find("m__raw_body = m__io->read_bytes(len());") != std::string::npos &&
+                c.find("new kaitai::kstream(m__raw_body)") != std::string::npos,
+                "buffered substream reads raw bytes first");
+  }
+
+
   {
     kscpp::ir::Spec spec;
     spec.name = "script_target_smoke";
@@ -406,6 +492,480 @@ int main() {
     }
   }
 
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "pos_instances";
+    spec.default_endian = kscpp::ir::Endian::kLe;
+
+    kscpp::ir::Attr ofs;
+    ofs.id = "ofs";
+    ofs.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    ofs.type.primitive = kscpp::ir::PrimitiveType::kU4;
+    spec.attrs.push_back(ofs);
+
+    kscpp::ir::Instance magic;
+    magic.id = "magic";
+    magic.kind = kscpp::ir::Instance::Kind::kParse;
+    magic.has_explicit_type = true;
+    magic.type.primitive = kscpp::ir::PrimitiveType::kU4;
+    magic.pos_expr = kscpp::ir::Expr::Name("ofs");
+    spec.instances.push_back(magic);
+
+    kscpp::ir::Instance body;
+    body.id = "body";
+    body.kind = kscpp::ir::Instance::Kind::kParse;
+    body.has_explicit_type = true;
+    body.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    body.pos_expr = kscpp::ir::Expr::Int(16);
+    body.size_expr = kscpp::ir::Expr::Name("ofs");
+    spec.instances.push_back(body);
+
+    kscpp::ir::Instance header;
+    header.id = "header";
+    header.kind = kscpp::ir::Instance::Kind::kParse;
+    header.has_explicit_type = true;
+    header.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    header.pos_expr = kscpp::ir::Expr::Int(48);
+    header.size_expr = kscpp::ir::Expr::Int(16);
+    spec.instances.push_back(header);
+
+    kscpp::ir::Instance blob;
+    blob.id = "blob";
+    blob.kind = kscpp::ir::Instance::Kind::kParse;
+    blob.has_explicit_type = true;
+    blob.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    blob.pos_expr = kscpp::ir::Expr::Int(64);
+    blob.size_expr = kscpp::ir::Expr::Int(65536);
+    spec.instances.push_back(blob);
+
+    kscpp::ir::Instance tail;
+    tail.id = "tail";
+    tail.kind = kscpp::ir::Instance::Kind::kParse;
+    tail.has_explicit_type = true;
+    tail.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    tail.pos_expr = kscpp::ir::Expr::Int(80);
+    tail.size_expr = kscpp::ir::Expr::Name("magic");
+    spec.instances.push_back(tail);
+
+    kscpp::ir::Instance rest;
+    rest.id = "rest";
+    rest.kind = kscpp::ir::Instance::Kind::kParse;
+    rest.has_explicit_type = true;
+    rest.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    rest.pos_expr = kscpp::ir::Expr::Int(32);
+    spec.instances.push_back(rest);
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_pos_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "pos instances codegen succeeds");
+
+    const std::string c = ReadAll(out / "pos_instances.cpp");
+    ok &= Check(c.find("m__io->advise(kaitai::kstream::HINT_WILLNEED, ofs(),") == std::string::npos &&
+                    c.find("m__io->seek(ofs());") != std::string::npos,
+                "numeric pos instance emits no hint");
+    ok &= Check(c.find("m__io->advise(kaitai::kstream::HINT_WILLNEED, 16, ofs());") != std::string::npos,
+                "sized bytes pos instance hints its range");
+    ok &= Check(c.find("m__io->advise(kaitai::kstream::HINT_WILLNEED, 48,") == std::string::npos,
+                "small fixed-size pos instance emits no hint");
+    ok &= Check(c.find("    m__io->advise(kaitai::kstream::HINT_WILLNEED, 64, 65536);\n"
+                       "    m__io->seek(64);\n") != std::string::npos,
+                "large fixed-size pos instance hints its range before seeking");
+    ok &= Check(c.find("m__io->advise(kaitai::kstream::HINT_WILLNEED, 80,") == std::string::npos &&
+                    c.find("m__io->read_bytes(magic())") != std::string::npos,
+                "pos instance sized by another instance emits no hint");
+    ok &= Check(c.find("m__io->advise(kaitai::kstream::HINT_WILLNEED, 32,") == std::string::npos,
+                "unsized pos instance emits no hint");
+    ok &= Check(c.find("m__io->seek(32);") != std::string::npos, "unsized pos instance still seeks");
+  }
+
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "inline_reads";
+    spec.default_endian = kscpp::ir::Endian::kBe;
+
+    kscpp::ir::Attr magic;
+    magic.id = "magic";
+    magic.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    magic.type.primitive = kscpp::ir::PrimitiveType::kU4;
+    spec.attrs.push_back(magic);
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_stream_backend_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+    options.runtime.stream_backend = "memory";
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "stream backend codegen succeeds");
+
+    const std::string h = ReadAll(out / "inline_reads.h");
+    const std::string c = ReadAll(out / "inline_reads.cpp");
+    ok &= Check(h.find("#include \"kaitai/basic_kstream.h\"") != std::string::npos,
+                "basic_kstream header included");
+    ok &= Check(h.find("inline_reads_t(kaitai::basic_kstream<kaitai::memory_backend>* p__io,") != std::string::npos,
+                "constructor takes the basic_kstream");
+    ok &= Check(h.find("    kaitai::basic_kstream<kaitai::memory_backend>* m__io;\n") != std::string::npos,
+                "typed stream member declared");
+    ok &= Check(c.find(") : kaitai::kstruct(p__io) {\n    m__io = p__io;\n") != std::string::npos,
+                "typed stream member assigned");
+    ok &= Check(c.find("m_magic = m__io->read_u4be();") != std::string::npos, "reads go through typed stream");
+  }
+
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "fixed_size_runs";
+    spec.default_endian = kscpp::ir::Endian::kBe;
+
+    kscpp::ir::Attr version;
+    version.id = "version";
+    version.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    version.type.primitive = kscpp::ir::PrimitiveType::kU2;
+    spec.attrs.push_back(version);
+
+    kscpp::ir::Attr scale;
+    scale.id = "scale";
+    scale.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    scale.type.primitive = kscpp::ir::PrimitiveType::kF8;
+    scale.endian_override = kscpp::ir::Endian::kLe;
+    spec.attrs.push_back(scale);
+
+    kscpp::ir::Attr body;
+    body.id = "body";
+    body.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    body.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    body.size_expr = kscpp::ir::Expr::Int(4);
+    spec.attrs.push_back(body);
+
+    kscpp::ir::Attr flags;
+    flags.id = "flags";
+    flags.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    flags.type.primitive = kscpp::ir::PrimitiveType::kU1;
+    spec.attrs.push_back(flags);
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_fixed_size_runs_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "fixed-size runs codegen succeeds");
+
+    const std::string c = ReadAll(out / "fixed_size_runs.cpp");
+    ok &= Check(c.find("    if (m__io->ensure_available(10)) {\n"
+                       "        m_version = m__io->read_u2be_unchecked();\n"
+                       "        m_scale = m__io->read_f8le_unchecked();\n"
+                       "    } else {\n"
+                       "        m_version = m__io->read_u2be();\n"
+                       "        m_scale = m__io->read_f8le();\n"
+                       "    }\n") != std::string::npos,
+                "consecutive fixed-size fields share one check");
+    ok &= Check(c.find("m_body = m__io->read_bytes(4);") != std::string::npos, "bytes field ends the run");
+    ok &= Check(c.find("    m_flags = m__io->read_u1();\n") != std::string::npos,
+                "lone fixed-size field read as usual");
+    ok &= Check(c.find("ensure_available(1)") == std::string::npos, "no check for a run of one field");
+  }
+
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "long_fixed_size_run";
+    spec.default_endian = kscpp::ir::Endian::kBe;
+
+    for (int i = 0; i < 20; i++) {
+      kscpp::ir::Attr attr;
+      attr.id = "b" + std::to_string(i);
+      attr.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+      attr.type.primitive = kscpp::ir::PrimitiveType::kU1;
+      spec.attrs.push_back(attr);
+    }
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_long_fixed_size_run_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "long fixed-size run codegen succeeds");
+
+    const std::string c = ReadAll(out / "long_fixed_size_run.cpp");
+    ok &= Check(c.find("    if (m__io->ensure_available(16)) {\n"
+                       "        m_b0 = m__io->read_u1_unchecked();\n") != std::string::npos &&
+                    c.find("    if (m__io->ensure_available(4)) {\n"
+                           "        m_b16 = m__io->read_u1_unchecked();\n") != std::string::npos,
+                "long run of fixed-size fields is split");
+  }
+
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "bulk_arrays";
+    spec.default_endian = kscpp::ir::Endian::kBe;
+
+    kscpp::ir::EnumDef e;
+    e.name = "kind";
+    e.values.push_back({1, "one"});
+    spec.enums.push_back(e);
+
+    kscpp::ir::Attr count;
+    count.id = "count";
+    count.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    count.type.primitive = kscpp::ir::PrimitiveType::kU1;
+    spec.attrs.push_back(count);
+
+    kscpp::ir::Attr samples;
+    samples.id = "samples";
+    samples.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    samples.type.primitive = kscpp::ir::PrimitiveType::kS2;
+    samples.endian_override = kscpp::ir::Endian::kLe;
+    samples.repeat = kscpp::ir::Attr::RepeatKind::kExpr;
+    samples.repeat_expr = kscpp::ir::Expr::Name("count");
+    spec.attrs.push_back(samples);
+
+    kscpp::ir::Attr kinds;
+    kinds.id = "kinds";
+    kinds.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    kinds.type.primitive = kscpp::ir::PrimitiveType::kU1;
+    kinds.enum_name = "kind";
+    kinds.repeat = kscpp::ir::Attr::RepeatKind::kExpr;
+    kinds.repeat_expr = kscpp::ir::Expr::Int(2);
+    spec.attrs.push_back(kinds);
+
+    kscpp::ir::Attr values;
+    values.id = "values";
+    values.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    values.type.primitive = kscpp::ir::PrimitiveType::kF8;
+    values.repeat = kscpp::ir::Attr::RepeatKind::kEos;
+    spec.attrs.push_back(values);
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_bulk_arrays_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "bulk arrays codegen succeeds");
+
+    const std::string c = ReadAll(out / "bulk_arrays.cpp");
+    ok &= Check(c.find("    const int l_samples = count();\n"
+                       "    if (l_samples > 0) {\n"
+                       "        m__io->read_s2le_array(*m_samples, l_samples);\n"
+                       "    }\n") != std::string::npos,
+                "repeat-expr of numbers read in bulk");
+    ok &= Check(c.find("    m__io->read_f8be_array_eos(*m_values);\n") != std::string::npos,
+                "repeat-eos of numbers read in bulk");
+    ok &= Check(c.find("for (int i = 0; i < l_kinds; i++)") != std::string::npos,
+                "repeated enum still read item by item");
+  }
+
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "bytes_views";
+    spec.default_endian = kscpp::ir::Endian::kLe;
+
+    kscpp::ir::Attr magic;
+    magic.id = "magic";
+    magic.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    magic.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    magic.size_expr = kscpp::ir::Expr::Int(4);
+    spec.attrs.push_back(magic);
+
+    kscpp::ir::Attr masked;
+    masked.id = "masked";
+    masked.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    masked.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    masked.size_expr = kscpp::ir::Expr::Int(2);
+    masked.process = kscpp::ir::Attr::Process{};
+    masked.process->kind = kscpp::ir::Attr::Process::Kind::kXorConst;
+    masked.process->xor_const = 0x55;
+    spec.attrs.push_back(masked);
+
+    kscpp::ir::Attr rest;
+    rest.id = "rest";
+    rest.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    rest.type.primitive = kscpp::ir::PrimitiveType::kBytes;
+    spec.attrs.push_back(rest);
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_bytes_views_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+    options.runtime.bytes_view = true;
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "bytes views codegen succeeds");
+
+    const std::string h = ReadAll(out / "bytes_views.h");
+    const std::string c = ReadAll(out / "bytes_views.cpp");
+    ok &= Check(h.find("kaitai::bytes_view magic() const { return m_magic; }") != std::string::npos &&
+                    h.find("kaitai::bytes_view m_rest;") != std::string::npos,
+                "bytes fields stored as views");
+    ok &= Check(h.find("std::string m_masked;") != std::string::npos, "processed bytes field stays a string");
+    ok &= Check(c.find("m_magic = m__io->read_bytes_view(4);") != std::string::npos &&
+                    c.find("m_rest = m__io->read_bytes_full_view();") != std::string::npos,
+                "bytes fields read as views");
+  }
+
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "lazy_strs";
+    spec.default_endian = kscpp::ir::Endian::kLe;
+
+    kscpp::ir::Attr len;
+    len.id = "len";
+    len.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    len.type.primitive = kscpp::ir::PrimitiveType::kU1;
+    spec.attrs.push_back(len);
+
+    kscpp::ir::Attr name;
+    name.id = "name";
+    name.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    name.type.primitive = kscpp::ir::PrimitiveType::kStr;
+    name.size_expr = kscpp::ir::Expr::Name("len");
+    name.encoding = "SJIS";
+    spec.attrs.push_back(name);
+
+    kscpp::ir::Attr tags;
+    tags.id = "tags";
+    tags.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    tags.type.primitive = kscpp::ir::PrimitiveType::kStr;
+    tags.size_expr = kscpp::ir::Expr::Int(2);
+    tags.encoding = "ASCII";
+    tags.repeat = kscpp::ir::Attr::RepeatKind::kExpr;
+    tags.repeat_expr = kscpp::ir::Expr::Int(3);
+    spec.attrs.push_back(tags);
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_lazy_strs_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+    options.runtime.lazy_str = true;
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "lazy strs codegen succeeds");
+
+    const std::string h = ReadAll(out / "lazy_strs.h");
+    const std::string c = ReadAll(out / "lazy_strs.cpp");
+    ok &= Check(h.find("const std::string& name() const { return m_name.get(); }") != std::string::npos &&
+                    h.find("kaitai::lazy_str m_name;") != std::string::npos,
+                "str field stored as lazy_str");
+    ok &= Check(c.find("m_name = kaitai::lazy_str(m__io->read_bytes(len()), \"SJIS\");") != std::string::npos,
+                "str field read without decoding");
+    ok &= Check(c.find("kaitai::kstream::bytes_to_str_ascii(m__io->read_bytes(2))") != std::string::npos,
+                "repeated str field still decoded while parsing");
+  }
+
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "error_status";
+    spec.default_endian = kscpp::ir::Endian::kLe;
+
+    kscpp::ir::Attr magic;
+    magic.id = "magic";
+    magic.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    magic.type.primitive = kscpp::ir::PrimitiveType::kU4;
+    spec.attrs.push_back(magic);
+
+    kscpp::ir::Attr items;
+    items.id = "items";
+    items.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+    items.type.primitive = kscpp::ir::PrimitiveType::kU2;
+    items.repeat = kscpp::ir::Attr::RepeatKind::kEos;
+    spec.attrs.push_back(items);
+
+    kscpp::ir::Validation val;
+    val.target = "magic";
+    val.condition_expr = kscpp::ir::Expr::Binary("==", kscpp::ir::Expr::Name("magic"), kscpp::ir::Expr::Int(7));
+    val.message = "bad magic";
+    spec.validations.push_back(val);
+
+    kscpp::ir::Instance doubled;
+    doubled.id = "doubled";
+    doubled.value_expr = kscpp::ir::Expr::Binary("*", kscpp::ir::Expr::Name("magic"), kscpp::ir::Expr::Int(2));
+    spec.instances.push_back(doubled);
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_error_status_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+    options.runtime.error_status = true;
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "error status codegen succeeds");
+
+    const std::string c = ReadAll(out / "error_status.cpp");
+    ok &= Check(c.find("    const uint64_t _pos_magic = m__io->pos();\n"
+                       "    m_magic = m__io->read_u4le();\n    if (!m__io->ok()) return;\n") != std::string::npos,
+                "validated field start kept, field read followed by status check");
+    ok &= Check(c.find("    m__io->read_u2le_array_eos(*m_items);\n    if (!m__io->ok()) return;\n") !=
+                    std::string::npos,
+                "bulk array read followed by status check");
+    ok &= Check(c.find("    if (!(m_magic == 7)) {\n"
+                       "        m__io->set_error(kaitai::kstream::STATUS_INVALID, _pos_magic);\n"
+                       "        return;\n") != std::string::npos,
+                "validation failure recorded at the field start");
+    ok &= Check(c.find("throw kaitai::validation_not_equal_error") == std::string::npos,
+                "no validation exception thrown");
+    const std::string h = ReadAll(out / "error_status.h");
+    ok &= Check(h.find(" doubled(); // check _io()->ok() after calling\n") != std::string::npos,
+                "instance accessor tells to check the status");
+  }
+
+  {
+    kscpp::ir::Spec spec;
+    spec.name = "error_status_run";
+    spec.default_endian = kscpp::ir::Endian::kLe;
+
+    for (const char* id : {"major", "minor"}) {
+      kscpp::ir::Attr attr;
+      attr.id = id;
+      attr.type.kind = kscpp::ir::TypeRef::Kind::kPrimitive;
+      attr.type.primitive = kscpp::ir::PrimitiveType::kU2;
+      spec.attrs.push_back(attr);
+    }
+
+    kscpp::ir::Validation val;
+    val.target = "minor";
+    val.condition_expr = kscpp::ir::Expr::Binary("==", kscpp::ir::Expr::Name("minor"), kscpp::ir::Expr::Int(1));
+    val.message = "bad minor";
+    spec.validations.push_back(val);
+
+    kscpp::CliOptions options;
+    const std::filesystem::path out = std::filesystem::temp_directory_path() / "kscpp_codegen_error_status_run_test";
+    std::filesystem::remove_all(out);
+    options.out_dir = out.string();
+    options.targets = {"cpp_stl"};
+    options.runtime.cpp_standard = "17";
+    options.runtime.error_status = true;
+
+    auto r = kscpp::codegen::EmitCppStl17FromIr(spec, options);
+    ok &= Check(r.ok, "error status run codegen succeeds");
+
+    const std::string c = ReadAll(out / "error_status_run.cpp");
+    ok &= Check(c.find("    const uint64_t _pos_minor = m__io->pos() + 2;\n    if (m__io->ensure_available(4)) {\n") !=
+                    std::string::npos,
+                "start of a validated field inside a fixed-size run kept");
+    ok &= Check(c.find("m__io->set_error(kaitai::kstream::STATUS_INVALID, _pos_minor);\n") != std::string::npos,
+                "run field validation failure recorded at the field start");
+  }
+
   {
     kscpp::ir::Spec unsupported;
     unsupported.name = "unsupported";
@@ -30,6 +30,7 @@ object JavaMain {
   val ALL_LANGS = LanguageCompilerStatic.NAME_TO_CLASS.keySet - "cpp_stl" + "cpp_stl_98" + "cpp_stl_17"
   val VALID_LANGS = LanguageCompilerStatic.NAME_TO_CLASS.keySet + "all"
   val CPP_STANDARDS = Set("98", "11", "17")
+  val CPP_STREAM_BACKENDS = Set("memory", "generic")
 
   def parseCommandLine(args: Array[String]): Option[CLIConfig] = {
     val parser = new scopt.OptionParser[CLIConfig](Version.name) {
@@ -104,6 +105,44 @@ object JavaMain {
         }
       }
 
+      opt[String]("cpp-stream-backend").valueName("<backend>").action { (x, c) =>
+        c.copy(
+          runtime = c.runtime.copy(
+            cppConfig = c.runtime.cppConfig.copy(streamBackend = Some(x))
+          )
+        )
+      } text("header-only kaitai::basic_kstream backend to target (C++ only, supported: memory, generic, default: none)") validate { x =>
+        if (CPP_STREAM_BACKENDS.contains(x)) {
+          success
+        } else {
+          failure(s"'$x' is not a valid C++ stream backend; valid ones are: ${CPP_STREAM_BACKENDS.mkString(", ")}")
+        }
+      }
+
+      opt[Unit]("cpp-error-status") action { (x, c) =>
+        c.copy(
+          runtime = c.runtime.copy(
+            cppConfig = c.runtime.cppConfig.copy(errorStatus = true)
+          )
+        )
+      } text("report parse errors via kaitai::kstream::status() instead of exceptions (C++ only)")
+
+      opt[Unit]("cpp-bytes-view") action { (x, c) =>
+        c.copy(
+          runtime = c.runtime.copy(
+            cppConfig = c.runtime.cppConfig.copy(bytesView = true)
+          )
+        )
+      } text("store bytes fields as kaitai::bytes_view pointing into the stream (C++ only, in-memory and mmap streams only)")
+
+      opt[Unit]("cpp-lazy-str") action { (x, c) =>
+        c.copy(
+          runtime = c.runtime.copy(
+            cppConfig = c.runtime.cppConfig.copy(lazyStr = true)
+          )
+        )
+      } text("decode string fields on first access instead of while parsing (C++ only)")
+
       opt[String]("go-package") valueName("<package>") action { (x, c) =>
         c.copy(runtime = c.runtime.copy(goPackage = x))
       } text("Go package (Go only, default: none)")
@@ -19,5 +19,16 @@ class ProcessExpr$Test extends AnyFunSpec {
         Seq(Ast.expr.IntNum(3), Ast.expr.IntNum(14))
       )))
     }
+
+    it("deflate") {
+      ProcessExpr.fromStr(Some("deflate"), List("some", "path")) should be(Some(ProcessInflate("deflate", None)))
+    }
+
+    it("gzip(len_unpacked)") {
+      ProcessExpr.fromStr(Some("gzip(len_unpacked)"), List("some", "path")) should be(Some(ProcessInflate(
+        "gzip",
+        Some(Ast.expr.Name(Ast.identifier("len_unpacked")))
+      )))
+    }
   }
 }
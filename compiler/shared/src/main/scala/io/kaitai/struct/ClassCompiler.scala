@@ -335,11 +335,8 @@ class ClassCompiler(
     * @param seq sequence of attributes
     * @param defEndian default endianness
     */
-  def compileSeqRead(seq: List[AttrSpec], defEndian: Option[FixedEndian]) = {
-    seq.foreach { (attr) =>
-      lang.attrParse(attr, attr.id, defEndian)
-    }
-  }
+  def compileSeqRead(seq: List[AttrSpec], defEndian: Option[FixedEndian]) =
+    lang.attrParseSeq(seq, defEndian)
 
   def compileFetchInstances(attrs: List[AttrLikeSpec]): Unit = {
     attrs.foreach { (attr) =>
@@ -11,13 +11,34 @@ package io.kaitai.struct
   *                            `std::vector` and `std::set`. Otherwise, throw a fatal
   *                            "not implemented" error.
   * @param pointers Choose which style of pointers to use.
+  * @param streamBackend If set, generated classes take and create the header-only
+  *                      `kaitai::basic_kstream<kaitai::<backend>_backend>` instead
+  *                      of `kaitai::kstream`, so that primitive reads are inlined.
+  * @param errorStatus If true, generated `_read()` reports failed validations by
+  *                    recording them in the stream status and checks the status
+  *                    after every attribute, returning early on errors, for use
+  *                    with streams in the `kaitai::kstream::ERRORS_STATUS` mode.
+  *                    Instance accessors record errors the same way but return
+  *                    a value anyway. Decoding and unpacking errors are still
+  *                    thrown (see `kstream::set_error_mode()`).
+  * @param bytesView If true, plain `bytes` fields (no terminator, padding or
+  *                  process) are stored as `kaitai::bytes_view` pointing into the
+  *                  stream instead of being copied into `std::string`. Such
+  *                  code can only parse in-memory and memory-mapped streams.
+  * @param lazyStr If true, string fields (not repeated, switched on or
+  *                validated) are stored as `kaitai::lazy_str`, which keeps the
+  *                raw bytes and decodes them on the first accessor call.
   */
 case class CppRuntimeConfig(
   namespace: List[String] = List(),
   usePragmaOnce: Boolean = false,
   stdStringFrontBack: Boolean = false,
   useListInitializers: Boolean = false,
-  pointers: CppRuntimeConfig.Pointers = CppRuntimeConfig.RawPointers
+  pointers: CppRuntimeConfig.Pointers = CppRuntimeConfig.RawPointers,
+  streamBackend: Option[String] = None,
+  errorStatus: Boolean = false,
+  bytesView: Boolean = false,
+  lazyStr: Boolean = false
 ) {
   /**
     * Copies this C++ runtime config, applying all the default settings for
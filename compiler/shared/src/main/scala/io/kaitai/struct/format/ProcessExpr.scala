@@ -10,7 +10,23 @@ case class ProcessXor(key: Ast.expr) extends ProcessExpr
 case class ProcessRotate(left: Boolean, key: Ast.expr) extends ProcessExpr
 case class ProcessCustom(name: List[String], args: Seq[Ast.expr]) extends ProcessExpr
 
+/**
+  * Unpacking of deflate-compressed data in the given container: `zlib`, raw
+  * `deflate` (no headers, as in ZIP archives) or `gzip`, optionally with the
+  * expected size of the unpacked data. Plain `zlib` is [[ProcessZlib]].
+  */
+case class ProcessInflate(container: String, sizeHint: Option[Ast.expr]) extends ProcessExpr
+object ProcessInflate {
+  /** zlib `windowBits` value that selects the container when inflating */
+  def windowBits(container: String): Int = container match {
+    case "zlib" => 15
+    case "deflate" => -15
+    case "gzip" => 16 + 15
+  }
+}
+
 object ProcessExpr {
+  private val ReInflate = "^(zlib|deflate|gzip)\\(\\s*(.*?)\\s*\\)$".r
   private val ReXor = "^xor\\(\\s*(.*?)\\s*\\)$".r
   private val ReRotate = "^ro(l|r)\\(\\s*(.*?)\\s*\\)$".r
   private val ReCustom = "^([a-z][a-z0-9_.]*)\\(\\s*(.*?)\\s*\\)$".r
@@ -25,6 +41,10 @@ object ProcessExpr {
           Some(op match {
             case "zlib" =>
               ProcessZlib
+            case "deflate" | "gzip" =>
+              ProcessInflate(op, None)
+            case ReInflate(container, arg) =>
+              ProcessInflate(container, Some(Expressions.parse(arg)))
             case ReXor(arg) =>
               ProcessXor(Expressions.parse(arg))
             case ReRotate(dir, arg) =>
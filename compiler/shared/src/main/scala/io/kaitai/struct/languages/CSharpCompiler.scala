@@ -198,8 +198,10 @@ class CSharpCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
     proc match {
       case ProcessXor(xorValue) =>
         s"$normalIO.ProcessXor($srcExpr, ${expression(xorValue)})"
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         s"$normalIO.ProcessZlib($srcExpr)"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in C# yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
@@ -8,6 +8,7 @@ import io.kaitai.struct.exprlang.Ast
 import io.kaitai.struct.exprlang.Ast.expr
 import io.kaitai.struct.format._
 import io.kaitai.struct.languages.components._
+import io.kaitai.struct.precompile.CalculateSeqSizes
 import io.kaitai.struct.translators.{CppTranslator, TypeDetector}
 
 class CppCompiler(
@@ -22,6 +23,8 @@ class CppCompiler(
   import CppCompiler._
 
   val importListSrc = new CppImportList
+
+  private def streamClass: String = CppCompiler.streamClass(config.cppConfig)
   val importListHdr = new CppImportList
 
   override val translator = new CppTranslator(typeProvider, importListSrc, importListHdr, config)
@@ -73,6 +76,8 @@ class CppCompiler(
     outHdrHeader.puts
 
     importListHdr.addKaitai("kaitai/kaitaistruct.h")
+    if (config.cppConfig.streamBackend.isDefined)
+      importListHdr.addKaitai("kaitai/basic_kstream.h")
     importListHdr.addSystem("stdint.h")
 
     config.cppConfig.pointers match {
@@ -214,6 +219,16 @@ class CppCompiler(
     )
     outSrc.inc
 
+    // With a basic_kstream, keep our own `m__io` of that type (hiding the
+    // `kaitai::kstream` one of `kaitai::kstruct`), so that reads are inlined
+    if (config.cppConfig.streamBackend.isDefined) {
+      ensureMode(PrivateAccess)
+      outHdr.puts(s"$tIo ${privateMemberName(IoIdentifier)};")
+      ensureMode(PublicAccess)
+      outHdr.puts(s"$tIo _io() const { return ${privateMemberName(IoIdentifier)}; }")
+      handleAssignmentSimple(IoIdentifier, pIo)
+    }
+
     handleAssignmentSimple(ParentIdentifier, pParent)
     handleAssignmentSimple(RootIdentifier, if (name == rootClassName) {
       s"${pRoot} ? ${pRoot} : this"
@@ -318,7 +333,8 @@ class CppCompiler(
 
   override def attributeDeclaration(attrName: Identifier, attrType: DataType, isNullable: Boolean): Unit = {
     ensureMode(PrivateAccess)
-    outHdr.puts(s"${kaitaiType2NativeType(attrType)} ${privateMemberName(attrName)};")
+    val nativeType = if (isLazyStr(attrName, attrType)) "kaitai::lazy_str" else kaitaiType2NativeType(attrType)
+    outHdr.puts(s"$nativeType ${privateMemberName(attrName)};")
     declareNullFlag(attrName, isNullable)
   }
 
@@ -337,9 +353,28 @@ class CppCompiler(
 
   override def attributeReader(attrName: Identifier, attrType: DataType, isNullable: Boolean): Unit = {
     ensureMode(PublicAccess)
-    outHdr.puts(s"${kaitaiType2NativeType(attrType.asNonOwning())} ${publicMemberName(attrName)}() const { return ${nonOwningPointer(attrName, attrType)}; }")
+    if (isLazyStr(attrName, attrType)) {
+      outHdr.puts(s"const std::string& ${publicMemberName(attrName)}() const { return ${privateMemberName(attrName)}.get(); }")
+    } else {
+      outHdr.puts(s"${kaitaiType2NativeType(attrType.asNonOwning())} ${publicMemberName(attrName)}() const { return ${nonOwningPointer(attrName, attrType)}; }")
+    }
   }
 
+  /**
+    * With `lazyStr` enabled, string attributes of the sequence are stored as
+    * `kaitai::lazy_str`, unless they are repeated or validated (validation
+    * needs the decoded string right away anyway). Switches have their own
+    * combined types and are never stored this way.
+    */
+  private def isLazyStr(attrName: Identifier, attrType: DataType): Boolean =
+    config.cppConfig.lazyStr && (attrType match {
+      case _: StrFromBytesType =>
+        typeProvider.nowClass.seq.exists((attr) =>
+          attr.id == attrName && attr.cond.repeat == NoRepeat && attr.valid.isEmpty
+        )
+      case _ => false
+    })
+
   override def universalDoc(doc: DocSpec): Unit = {
     // All docstrings would be for public stuff, so it's safe to start it here
     ensureMode(PublicAccess)
@@ -466,6 +501,9 @@ class CppCompiler(
         s"$kstreamName::$procName($srcExpr, ${expression(xorValue)})"
       case ProcessZlib =>
         s"$kstreamName::process_zlib($srcExpr)"
+      case ProcessInflate(container, sizeHint) =>
+        val hintArg = sizeHint.map((x) => s", ${expression(x)}").getOrElse("")
+        s"$kstreamName::process_$container($srcExpr$hintArg)"
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
@@ -482,20 +520,101 @@ class CppCompiler(
         val argList = args.map(expression).mkString(", ")
         var argListInParens = if (argList.nonEmpty) s"($argList)" else ""
         outSrc.puts(s"$procClass $procName$argListInParens;")
-        s"$procName.decode($srcExpr)"
+        // process() calls the buffer-oriented decode_into() if the decoder
+        // implements it, falling back to decode() otherwise
+        s"$procName.process($srcExpr)"
     }
   }
 
   override def allocateIO(id: Identifier, rep: RepeatSpec): String = {
-    val memberName = privateMemberName(id)
-    val ioId = IoStorageIdentifier(id)
-
     val args = rep match {
       case RepeatUntil(_) => translator.doName(Identifier.ITERATOR2)
       case _ => getRawIdExpr(id, rep)
     }
 
-    val newStreamRaw = s"new $kstreamName($args)"
+    val ioName = storeIO(id, rep, s"new $streamClass($args)")
+    linkErrorParent(ioName, normalIO)
+    ioName
+  }
+
+  /**
+    * Creates a zero-copy substream: a window of `size` bytes over the parent
+    * stream's buffer, starting at its current position. The parent stream is
+    * then advanced past the window, just as if the bytes were read.
+    */
+  override def createSubstreamFixedSize(id: Identifier, blt: BytesLimitType, io: String, rep: RepeatSpec, defEndian: Option[FixedEndian]): String = {
+    val ioName = storeIO(RawIdentifier(id), rep, s"new $streamClass($io, $io->pos(), ${expression(blt.size)})")
+    // A substream reaching past the end records the error in `io`
+    if (config.cppConfig.errorStatus) {
+      if (rep != NoRepeat) {
+        outSrc.puts(s"if (!$io->ok()) break;")
+      } else if (inSeqRead) {
+        outSrc.puts(s"if (!$io->ok()) return;")
+      }
+    }
+    outSrc.puts(s"$io->seek($io->pos() + $ioName->size());")
+    ioName
+  }
+
+  /**
+    * Creates a substream that unpacks zlib-compressed bytes as it is read
+    * (see `kstream::from_zlib`), so that the unpacked bytes are never held in
+    * memory as a whole. Other processing is done by the buffered
+    * implementation.
+    */
+  override def createSubstreamBuffered(id: Identifier, byteType: BytesType, io: String, rep: RepeatSpec, defEndian: Option[FixedEndian]): String = {
+    byteType.process match {
+      case Some(ProcessZlib) if config.zeroCopySubstream && config.cppConfig.streamBackend.isEmpty =>
+        val rawRawId = RawIdentifier(RawIdentifier(id))
+        handleAssignment(rawRawId, parseExprBytes(byteType, io), rep, true, byteType, byteType)
+        val ioName = storeIO(RawIdentifier(id), rep, s"$kstreamName::from_zlib(${getRawIdExpr(rawRawId, rep)})")
+        linkErrorParent(ioName, io)
+        ioName
+      case _ =>
+        super.createSubstreamBuffered(id, byteType, io, rep, defEndian)
+    }
+  }
+
+  override def extraRawAttrForUserTypeFromBytes(id: Identifier, ut: UserTypeFromBytes, condSpec: ConditionalSpec): List[AttrSpec] = {
+    if (config.zeroCopySubstream) {
+      ut.bytes match {
+        case BytesLimitType(_, None, _, None, None) =>
+          // substream will be used, no need for store raws
+          List()
+        case bt if bt.process == Some(ProcessZlib) && config.cppConfig.streamBackend.isEmpty =>
+          // unpacked on the fly by the substream, only compressed raws are stored
+          List()
+        case _ =>
+          // buffered implementation will be used, fall back to raw storage
+          super.extraRawAttrForUserTypeFromBytes(id, ut, condSpec)
+      }
+    } else {
+      // zero-copy streams disabled, fall back to raw storage
+      super.extraRawAttrForUserTypeFromBytes(id, ut, condSpec)
+    }
+  }
+
+  override def extraAttrsForAttribute(id: Identifier, dataType: DataType, condSpec: ConditionalSpec): Iterable[AttrSpec] = {
+    val attrs = super.extraAttrsForAttribute(id, dataType, condSpec)
+    dataType match {
+      case st: SwitchType if !attrs.exists(_.id == RawIdentifier(id)) =>
+        // Byte array cases of a switch are stored as raw (see `switchBytesOnlyAsRaw`), so
+        // the raw attribute is still needed even if all user type cases use substreams
+        attrs ++ st.cases.values.collectFirst {
+          case bt: BytesType => AttrSpec(List(), RawIdentifier(id), bt, condSpec)
+        }
+      case _ =>
+        attrs
+    }
+  }
+
+  /**
+    * Stores a newly allocated IO object in a member designated for `id` (or
+    * appends it to the array of IOs for repeated attributes).
+    * @return expression referencing the new IO object
+    */
+  def storeIO(id: Identifier, rep: RepeatSpec, newStreamRaw: String): String = {
+    val ioId = IoStorageIdentifier(id)
 
     val ioName = rep match {
       case NoRepeat =>
@@ -514,7 +633,7 @@ class CppCompiler(
         }
       case _ =>
         val localIO = s"io_${idToStr(id)}"
-        outSrc.puts(s"$kstreamName* $localIO = $newStreamRaw;")
+        outSrc.puts(s"$streamClass* $localIO = $newStreamRaw;")
         if (config.cppConfig.pointers == CppRuntimeConfig.UniqueAndRawPointers) {
           outSrc.puts(s"${privateMemberName(ioId)}->emplace_back($localIO);")
         } else {
@@ -535,15 +654,249 @@ class CppCompiler(
   }
 
   override def useIO(ioEx: Ast.expr): String = {
-    outSrc.puts(s"$kstreamName *io = ${expression(ioEx)};")
+    outSrc.puts(s"$streamClass *io = ${expression(ioEx)};")
     "io"
   }
 
   override def pushPos(io: String): Unit =
     outSrc.puts(s"std::streampos _pos = $io->pos();")
 
-  override def seek(io: String, pos: Ast.expr): Unit =
+  /**
+    * Number of bytes the parse instance currently being generated will read
+    * after seeking, if it can be told in advance. Used to emit an access hint
+    * for the range, so the OS can start loading it before it's actually read.
+    */
+  private var instanceReadSize: Option[Ast.expr] = None
+
+  override def attrParse(attr: AttrLikeSpec, id: Identifier, defEndian: Option[Endianness]): Unit = {
+    instanceReadSize = attr match {
+      case pis: ParseInstanceSpec if pis.cond.repeat == NoRepeat => knownReadSize(pis.dataType)
+      case _ => None
+    }
+    super.attrParse(attr, id, defEndian)
+    instanceReadSize = None
+  }
+
+  override def seek(io: String, pos: Ast.expr): Unit = {
+    instanceReadSize.foreach { size =>
+      outSrc.puts(s"$io->advise($kstreamName::HINT_WILLNEED, ${expression(pos)}, ${expression(size)});")
+    }
     outSrc.puts(s"$io->seek(${expression(pos)});")
+  }
+
+  /**
+    * Smallest read worth an access hint: `kstream::advise()` ignores shorter
+    * ranges, which are loaded in a single page fault or read anyway.
+    */
+  private val MinAdviseLen = 4096
+
+  /**
+    * Size of the data type as an expression that can be evaluated before
+    * seeking: either a constant or a plain reference to a seq attribute or a
+    * parameter, which are set by then (an instance would be parsed early,
+    * possibly reading from the stream). Constants too small to be worth a
+    * hint, numbers included, give None.
+    */
+  private def knownReadSize(dataType: DataType): Option[Ast.expr] = dataType match {
+    case blt: BytesLimitType => blt.size match {
+      case name: Ast.expr.Name if isSeqOrParam(name.id.name) => Some(name)
+      case _ => blt.size.evaluateIntConst.filter(_ >= MinAdviseLen).map(Ast.expr.IntNum(_))
+    }
+    case StrFromBytesType(bytes, _) => knownReadSize(bytes)
+    case utb: UserTypeFromBytes => knownReadSize(utb.bytes)
+    case _ => None
+  }
+
+  private def isSeqOrParam(name: String): Boolean = {
+    val id = NamedIdentifier(name)
+    typeProvider.nowClass.seq.exists(_.id == id) || typeProvider.nowClass.params.exists(_.id == id)
+  }
+
+  /**
+    * Size of a number read with a single `read_*()` call, in bytes.
+    */
+  private def numericReadSize(dataType: DataType): Option[Int] = dataType match {
+    case _: Int1Type | _: IntMultiType | _: FloatMultiType =>
+      CalculateSeqSizes.dataTypeByteSize(dataType) match {
+        case FixedSized(n) => Some(n)
+        case _ => None
+      }
+    case _ => None
+  }
+
+  /**
+    * Set while generating the fast path of a run of fixed-size attributes,
+    * which are all known to be available: reads use the `*_unchecked()`
+    * methods of the stream then.
+    */
+  private var uncheckedReads = false
+
+  /**
+    * Runs of two or more consecutive fixed-size numeric attributes are
+    * generated twice: with a single `ensure_available()` check of their total
+    * size followed by unchecked reads, and with the regular reads as a
+    * fallback (which report errors exactly as if there was no grouping).
+    * Runs longer than `MaxFixedSizeRun` are split, so that the duplicated
+    * code stays short.
+    */
+  override def attrParseSeq(seq: List[AttrSpec], defEndian: Option[FixedEndian]): Unit = {
+    inSeqRead = true
+    var rest = seq
+    while (rest.nonEmpty) {
+      val run = rest.takeWhile((attr) => fixedReadSize(attr).isDefined).take(MaxFixedSizeRun)
+      if (run.size >= 2) {
+        val size = run.flatMap(fixedReadSize).sum
+        outSrc.puts(s"if ($normalIO->ensure_available($size)) {")
+        outSrc.inc
+        uncheckedReads = true
+        run.foreach { (attr) => attrParse(attr, attr.id, defEndian) }
+        uncheckedReads = false
+        outSrc.dec
+        outSrc.puts("} else {")
+        outSrc.inc
+        run.foreach { (attr) => attrParse(attr, attr.id, defEndian) }
+        outSrc.dec
+        outSrc.puts("}")
+        rest = rest.drop(run.size)
+      } else {
+        attrParse(rest.head, rest.head.id, defEndian)
+        rest = rest.tail
+      }
+      if (config.cppConfig.errorStatus)
+        outSrc.puts(s"if (!$normalIO->ok()) return;")
+    }
+    inSeqRead = false
+  }
+
+  private val MaxFixedSizeRun = 16
+
+  /**
+    * Set while generating `_read()`, as opposed to parse instances, which
+    * can't just return when an error is recorded with `errorStatus`.
+    */
+  private var inSeqRead = false
+
+  /**
+    * Stream read by the repetition currently being generated.
+    */
+  private var repeatIO = ""
+
+  /**
+    * With `errorStatus`, stops a repetition once an error has been recorded:
+    * a failed read doesn't advance the stream, so it would never end
+    * otherwise.
+    */
+  private def repeatStatusCheck(): Unit =
+    if (config.cppConfig.errorStatus)
+      outSrc.puts(s"if (!$repeatIO->ok()) break;")
+
+  /**
+    * With `errorStatus`, makes a stream over bytes read from `io` (rather
+    * than a substream of it) report its errors to `io` too.
+    */
+  private def linkErrorParent(ioName: String, io: String): Unit =
+    if (config.cppConfig.errorStatus)
+      outSrc.puts(s"$ioName->set_error_parent($io, $io->pos());")
+
+  /**
+    * Repetitions of a plain number (with no validations or debug positions to
+    * handle item by item) are read with a single `read_*_array()` call, which
+    * copies and byte-swaps whole runs of items at once.
+    */
+  override def attrParse0(id: Identifier, attr: AttrLikeSpec, io: String, defEndian: Option[FixedEndian]): Unit = {
+    bulkArrayRead(id, attr, defEndian) match {
+      case Some(method) =>
+        condRepeatInitAttr(id, attr.dataType)
+        val vec = s"*${privateMemberName(id)}"
+        attr.cond.repeat match {
+          case RepeatExpr(repeatExpr) =>
+            val lenVar = s"l_${idToStr(id)}"
+            outSrc.puts(s"const int $lenVar = ${expression(repeatExpr)};")
+            outSrc.puts(s"if ($lenVar > 0) {")
+            outSrc.inc
+            outSrc.puts(s"$io->$method($vec, $lenVar);")
+            outSrc.dec
+            outSrc.puts("}")
+          case _ =>
+            outSrc.puts(s"$io->${method}_eos($vec);")
+        }
+      case None =>
+        super.attrParse0(id, attr, io, defEndian)
+    }
+  }
+
+  /**
+    * Lazy strings are created from the raw bytes and the encoding, leaving
+    * the decoding to the accessor.
+    */
+  override def attrParse2(
+    id: Identifier,
+    dataType: DataType,
+    io: String,
+    rep: RepeatSpec,
+    isRaw: Boolean,
+    defEndian: Option[FixedEndian],
+    assignTypeOpt: Option[DataType] = None
+  ): Unit = dataType match {
+    case t: StrFromBytesType if rep == NoRepeat && isLazyStr(id, t) =>
+      val expr = s"kaitai::lazy_str(${parseExprBytes(t.bytes, io)}, ${translator.doRawStringLiteral(t.encoding)})"
+      handleAssignmentSimple(id, expr)
+    case _ =>
+      super.attrParse2(id, dataType, io, rep, isRaw, defEndian, assignTypeOpt)
+  }
+
+  /**
+    * With `bytesView` enabled, plain byte fields are read with
+    * `read_bytes_view()` / `read_bytes_full_view()`, which point into the
+    * stream instead of copying the bytes out.
+    */
+  override def attrBytesTypeParse(
+    id: Identifier,
+    dataType: BytesType,
+    io: String,
+    rep: RepeatSpec,
+    isRaw: Boolean,
+    assignType: DataType
+  ): Unit = {
+    if (CppCompiler.isBytesView(config.cppConfig, dataType)) {
+      val expr = dataType match {
+        case blt: BytesLimitType => s"$io->read_bytes_view(${expression(blt.size)})"
+        case _ => s"$io->read_bytes_full_view()"
+      }
+      bytesViewRead = true
+      handleAssignment(id, expr, rep, isRaw, dataType, assignType)
+      bytesViewRead = false
+    } else {
+      super.attrBytesTypeParse(id, dataType, io, rep, isRaw, assignType)
+    }
+  }
+
+  private var bytesViewRead = false
+
+  private def bulkArrayRead(id: Identifier, attr: AttrLikeSpec, defEndian: Option[FixedEndian]): Option[String] = {
+    val repeated = attr.cond.repeat match {
+      case RepeatEos | _: RepeatExpr => true
+      case _ => false
+    }
+    if (!repeated || attr.valid.nonEmpty || attrDebugNeeded(id)) {
+      None
+    } else {
+      attr.dataType match {
+        case t: ReadableType if numericReadSize(t).isDefined => Some(s"read_${t.apiCall(defEndian)}_array")
+        case _ => None
+      }
+    }
+  }
+
+  private def fixedReadSize(attr: AttrSpec): Option[Int] =
+    if (attr.cond.ifExpr.isDefined || attr.cond.repeat != NoRepeat) {
+      None
+    } else {
+      attr.dataType match {
+        case et: EnumType => numericReadSize(et.basedOn)
+        case dt => numericReadSize(dt)
+      }
+    }
 
   override def popPos(io: String): Unit =
     outSrc.puts(s"$io->seek(_pos);")
@@ -577,6 +930,7 @@ class CppCompiler(
   }
 
   override def condRepeatEosHeader(id: Identifier, io: String, dataType: DataType): Unit = {
+    repeatIO = io
     outSrc.puts("{")
     outSrc.inc
     outSrc.puts("int i = 0;")
@@ -589,6 +943,7 @@ class CppCompiler(
   }
 
   override def condRepeatEosFooter: Unit = {
+    repeatStatusCheck()
     outSrc.puts("i++;")
     outSrc.dec
     outSrc.puts("}")
@@ -597,6 +952,7 @@ class CppCompiler(
   }
 
   override def condRepeatExprHeader(id: Identifier, io: String, dataType: DataType, repeatExpr: Ast.expr): Unit = {
+    repeatIO = io
     val lenVar = s"l_${idToStr(id)}"
     outSrc.puts(s"const int $lenVar = ${expression(repeatExpr)};")
     outSrc.puts(s"for (int i = 0; i < $lenVar; i++) {")
@@ -607,11 +963,13 @@ class CppCompiler(
     handleAssignmentRepeatEos(id, expr)
 
   override def condRepeatExprFooter: Unit = {
+    repeatStatusCheck()
     outSrc.dec
     outSrc.puts("}")
   }
 
   override def condRepeatUntilHeader(id: Identifier, io: String, dataType: DataType, untilExpr: expr): Unit = {
+    repeatIO = io
     outSrc.puts("{")
     outSrc.inc
     outSrc.puts("int i = 0;")
@@ -624,7 +982,8 @@ class CppCompiler(
 
   override def handleAssignmentRepeatUntil(id: Identifier, expr: String, isRaw: Boolean): Unit = {
     val (typeDecl, tempVar) = if (isRaw) {
-      ("std::string ", translator.doName(Identifier.ITERATOR2))
+      val rawType = if (bytesViewRead) "kaitai::bytes_view" else "std::string"
+      (s"$rawType ", translator.doName(Identifier.ITERATOR2))
     } else {
       ("", translator.doName(Identifier.ITERATOR))
     }
@@ -647,6 +1006,7 @@ class CppCompiler(
 
   override def condRepeatUntilFooter(id: Identifier, io: String, dataType: DataType, untilExpr: expr): Unit = {
     typeProvider._currentIteratorType = Some(dataType)
+    repeatStatusCheck()
     outSrc.puts("i++;")
     outSrc.dec
     outSrc.puts(s"} while (!(${expression(untilExpr)}));")
@@ -673,7 +1033,8 @@ class CppCompiler(
   override def parseExpr(dataType: DataType, io: String, defEndian: Option[FixedEndian]): String = {
     dataType match {
       case t: ReadableType =>
-        s"$io->read_${t.apiCall(defEndian)}()"
+        val suffix = if (uncheckedReads) "_unchecked" else ""
+        s"$io->read_${t.apiCall(defEndian)}$suffix()"
       case blt: BytesLimitType =>
         s"$io->read_bytes(${expression(blt.size)})"
       case _: BytesEosType =>
@@ -856,7 +1217,10 @@ class CppCompiler(
   override def instanceHeader(className: List[String], instName: InstanceIdentifier, dataType: DataType, isNullable: Boolean): Unit = {
     importDataType(dataType)
     ensureMode(PublicAccess)
-    outHdr.puts(s"${kaitaiType2NativeType(dataType.asNonOwning())} ${publicMemberName(instName)}();")
+    // Accessors can't return early like `_read()` does, so the caller has to
+    // look at the status after calling them
+    val statusNote = if (config.cppConfig.errorStatus) " // check _io()->ok() after calling" else ""
+    outHdr.puts(s"${kaitaiType2NativeType(dataType.asNonOwning())} ${publicMemberName(instName)}();$statusNote")
 
     outSrc.puts
     outSrc.puts(s"${kaitaiType2NativeType(dataType.asNonOwning(), true)} ${types2class(className)}::${publicMemberName(instName)}() {")
@@ -1112,10 +1476,18 @@ class CppCompiler(
       if (useIo) expression(Ast.expr.InternalName(IoIdentifier)) else nullPtr,
       expression(Ast.expr.Str(attr.path.mkString("/", "/", "")))
     )
-    importListSrc.addKaitai("kaitai/exceptions.h")
     outSrc.puts(s"if ($failCondExpr) {")
     outSrc.inc
-    outSrc.puts(s"throw ${ksErrorName(err)}(${errArgsStr.mkString(", ")});")
+    if (config.cppConfig.errorStatus) {
+      // Parse instances record the error and return the value anyway, their
+      // accessors are declared with a note to check the status
+      outSrc.puts(s"$normalIO->set_error($kstreamName::STATUS_INVALID, $normalIO->pos());")
+      if (inSeqRead)
+        outSrc.puts("return;")
+    } else {
+      importListSrc.addKaitai("kaitai/exceptions.h")
+      outSrc.puts(s"throw ${ksErrorName(err)}(${errArgsStr.mkString(", ")});")
+    }
     outSrc.dec
     outSrc.puts("}")
   }
@@ -1147,6 +1519,26 @@ object CppCompiler extends LanguageCompilerStatic
   override def kstructName = "kaitai::kstruct"
   override def kstreamName = "kaitai::kstream"
 
+  /**
+    * Stream class taken and created by the generated code: `kaitai::kstream`,
+    * or the header-only `kaitai::basic_kstream` if a stream backend was chosen.
+    */
+  def streamClass(config: CppRuntimeConfig): String = config.streamBackend match {
+    case None => kstreamName
+    case Some(backend) => s"kaitai::basic_kstream<kaitai::${backend}_backend>"
+  }
+
+  /**
+    * Tells if a byte field is stored as a `kaitai::bytes_view`: only plain
+    * reads qualify, as terminators, padding and processing produce new bytes.
+    */
+  def isBytesView(config: CppRuntimeConfig, dataType: BytesType): Boolean =
+    config.bytesView && (dataType match {
+      case BytesLimitType(_, None, _, None, None) => true
+      case BytesEosType(None, _, None, None) => true
+      case _ => false
+    })
+
   def kaitaiType2NativeType(config: CppRuntimeConfig, importListHdr: CppImportList, attrType: DataType, absolute: Boolean = false): String = {
     attrType match {
       case Int1Type(false) => "uint8_t"
@@ -1169,6 +1561,7 @@ object CppCompiler extends LanguageCompilerStatic
       case CalcFloatType => "double"
 
       case _: StrType => "std::string"
+      case bt: BytesType if isBytesView(config, bt) => "kaitai::bytes_view"
       case _: BytesType => "std::string"
 
       case t: UserType =>
@@ -1201,10 +1594,10 @@ object CppCompiler extends LanguageCompilerStatic
         }
       }
       case OwnedKaitaiStreamType => config.pointers match {
-        case RawPointers => s"$kstreamName*"
-        case UniqueAndRawPointers => s"std::unique_ptr<$kstreamName>"
+        case RawPointers => s"${streamClass(config)}*"
+        case UniqueAndRawPointers => s"std::unique_ptr<${streamClass(config)}>"
       }
-      case KaitaiStreamType => s"$kstreamName*"
+      case KaitaiStreamType => s"${streamClass(config)}*"
       case KaitaiStructType => config.pointers match {
         case RawPointers => s"$kstructName*"
         case UniqueAndRawPointers => s"std::unique_ptr<$kstructName>"
@@ -203,8 +203,10 @@ class GoCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           case _: BytesType =>
             s"kaitai.ProcessXOR($srcExpr, ${expression(xorValue)})"
         }
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         translator.resToStr(translator.outVarCheckRes(s"kaitai.ProcessZlib($srcExpr)"))
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in Go yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
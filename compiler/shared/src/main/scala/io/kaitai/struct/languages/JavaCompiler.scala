@@ -344,8 +344,10 @@ class JavaCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           case _ => expression(xorValue)
         }
         s"$kstreamName.processXor($srcExpr, $xorValueStr)"
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         s"$kstreamName.processZlib($srcExpr)"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in Java yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
@@ -377,8 +379,10 @@ class JavaCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           case _ => argStr
         }
         s"$kstreamName.processXor($srcExpr, $xorValueStr)"
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         s"$kstreamName.unprocessZlib($srcExpr)"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in Java yet")
       case ProcessRotate(isLeft, rotValue) =>
         val argStr = if (translator.inSubIOWriteBackHandler) "_processRotateArg" else expression(rotValue)
         val expr = if (!isLeft) {
@@ -409,7 +413,7 @@ class JavaCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
       case ProcessRotate(_, rotValue) =>
         val dataType = translator.detectType(rotValue)
         out.puts(s"final ${kaitaiType2JavaType(dataType)} _processRotateArg = ${expression(rotValue)};")
-      case ProcessZlib => // no process arguments
+      case ProcessZlib | _: ProcessInflate => // no process arguments
       case ProcessCustom(name, args) =>
         val namespace = name.init.mkString(".")
         val procClass = namespace +
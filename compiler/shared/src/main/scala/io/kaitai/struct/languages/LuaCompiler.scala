@@ -215,8 +215,10 @@ class LuaCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           case _: BytesType => "process_xor_many"
         }
         s"$kstreamName.$procName($srcExpr, ${expression(xorValue)})"
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         s"$kstreamName.process_zlib($srcExpr)"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in Lua yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
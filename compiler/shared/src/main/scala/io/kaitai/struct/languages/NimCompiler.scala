@@ -102,8 +102,10 @@ class NimCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
     proc match {
       case ProcessXor(xorValue) =>
         s"$srcExpr.processXor(${expression(xorValue)})"
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         s"$srcExpr.processZlib()"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in Nim yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
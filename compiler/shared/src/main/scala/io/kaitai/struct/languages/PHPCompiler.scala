@@ -212,8 +212,10 @@ class PHPCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           case _: BytesType => "processXorMany"
         }
         s"$kstreamName::$procName($srcExpr, ${expression(xorValue)})"
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         s"$kstreamName::processZlib($srcExpr)"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in PHP yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
@@ -179,9 +179,11 @@ class PerlCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           case _: BytesType => "process_xor_many"
         }
         s"$kstreamName::$procName($srcExpr, ${expression(xorValue)})"
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         importList.add("Compress::Zlib")
         s"Compress::Zlib::uncompress($srcExpr)"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in Perl yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
@@ -189,6 +191,8 @@ class PerlCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           s"8 - (${expression(rotValue)})"
         }
         s"$kstreamName::process_rotate_left($srcExpr, $expr, 1)"
+      case ProcessCustom(name, _) =>
+        throw new NotImplementedError(s"process: ${name.mkString(".")} (custom processing) is not supported in Perl yet")
     }
   }
 
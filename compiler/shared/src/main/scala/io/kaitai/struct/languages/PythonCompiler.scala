@@ -306,6 +306,9 @@ class PythonCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
       case ProcessZlib =>
         importList.add("import zlib")
         s"zlib.decompress($srcExpr)"
+      case ProcessInflate(container, _) =>
+        importList.add("import zlib")
+        s"zlib.decompress($srcExpr, ${ProcessInflate.windowBits(container)})"
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
@@ -343,6 +346,8 @@ class PythonCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
       case ProcessZlib =>
         importList.add("import zlib")
         s"zlib.compress($srcExpr)"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container cannot be serialized yet")
       case ProcessRotate(isLeft, rotValue) =>
         val argStr = if (translator.inSubIOWriteBackHandler) "_process_val" else expression(rotValue)
         val expr = if (!isLeft) {
@@ -384,7 +389,7 @@ class PythonCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
         out.puts(s"_process_val = ${expression(xorValue)}")
       case ProcessRotate(_, rotValue) =>
         out.puts(s"_process_val = ${expression(rotValue)}")
-      case ProcessZlib => // no process arguments
+      case ProcessZlib | _: ProcessInflate => // no process arguments
       case ProcessCustom(name, args) =>
         val procClass = if (name.length == 1) {
           val onlyName = name.head
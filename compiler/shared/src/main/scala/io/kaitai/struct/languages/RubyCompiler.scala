@@ -214,6 +214,9 @@ class RubyCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
       case ProcessZlib =>
         importList.add("require 'zlib'")
         s"Zlib::Inflate.inflate($srcExpr)"
+      case ProcessInflate(container, _) =>
+        importList.add("require 'zlib'")
+        s"Zlib::Inflate.new(${ProcessInflate.windowBits(container)}).inflate($srcExpr)"
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
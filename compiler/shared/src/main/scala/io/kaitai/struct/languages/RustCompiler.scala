@@ -372,8 +372,10 @@ class RustCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           case _: BytesType =>
             s"process_xor_many(&$srcExpr, &${translator.remove_deref(expression(xorValue))})"
         }
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         s"process_zlib(&$srcExpr).map_err(|msg| KError::BytesDecodingError { msg })?"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in Rust yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
@@ -220,8 +220,10 @@ class ZigCompiler(typeProvider: ClassTypeProvider, config: RuntimeConfig)
           case _ => expression(xorValue)
         }
         s"try $kstreamName.$procName($minArgs, $xorValueStr)"
-      case ProcessZlib =>
+      case ProcessZlib | ProcessInflate("zlib", _) =>
         s"try $kstreamName.processZlib($minArgs)"
+      case ProcessInflate(container, _) =>
+        throw new NotImplementedError(s"process: $container is not supported in Zig yet")
       case ProcessRotate(isLeft, rotValue) =>
         val expr = if (isLeft) {
           expression(rotValue)
@@ -87,7 +87,7 @@ trait ExtraAttrs {
   def writeNeedsInnerSize(bytes: BytesType): Boolean = {
     val unknownInnerSizeProcess = bytes.process match {
       case Some(process) => process match {
-        case ProcessZlib | _: ProcessCustom => true
+        case ProcessZlib | _: ProcessInflate | _: ProcessCustom => true
         case _: ProcessXor | _: ProcessRotate => false
       }
       case None => false
@@ -120,6 +120,13 @@ abstract class LanguageCompiler(
   def attributeDoc(id: Identifier, doc: DocSpec): Unit = {}
 
   def attrParse(attr: AttrLikeSpec, id: Identifier, defEndian: Option[Endianness]): Unit
+
+  /**
+    * Generates parsing of all sequence attributes, in order. Languages can
+    * override it to handle several consecutive attributes at once.
+    */
+  def attrParseSeq(seq: List[AttrSpec], defEndian: Option[FixedEndian]): Unit =
+    seq.foreach { (attr) => attrParse(attr, attr.id, defEndian) }
   def attrParseHybrid(leProc: () => Unit, beProc: () => Unit): Unit
   def attrInit(attr: AttrLikeSpec): Unit = {}
   def attrDestructor(attr: AttrLikeSpec, id: Identifier): Unit = {}
@@ -208,8 +208,24 @@ class CppTranslator(provider: TypeProvider, importListSrc: CppImportList, import
     // FIXME: proper way for C++11, but not available in earlier versions
     //s"std::to_string(${translate(i)})"
     s"${CppCompiler.kstreamName}::to_string(${translate(i)})"
-  override def bytesToStr(bytesExpr: String, encoding: String): String =
-    s"""${CppCompiler.kstreamName}::bytes_to_str($bytesExpr, ${doRawStringLiteral(encoding)})"""
+  override def bytesToStr(bytesExpr: String, encoding: String): String = {
+    // The runtime has built-in decoders for the most common encodings. Calling
+    // them directly saves looking the encoding up by name on every call.
+    val builtinDecodersMap = Map(
+      "ASCII" -> "bytes_to_str_ascii",
+      "UTF-8" -> "bytes_to_str_utf8",
+      "ISO-8859-1" -> "bytes_to_str_latin1",
+      "UTF-16LE" -> "bytes_to_str_utf16le",
+      "UTF-16BE" -> "bytes_to_str_utf16be",
+    )
+
+    builtinDecodersMap.get(encoding) match {
+      case Some(decoder) =>
+        s"${CppCompiler.kstreamName}::$decoder($bytesExpr)"
+      case None =>
+        s"""${CppCompiler.kstreamName}::bytes_to_str($bytesExpr, ${doRawStringLiteral(encoding)})"""
+    }
+  }
   override def bytesLength(b: Ast.expr): String =
     s"${translate(b, METHOD_PRECEDENCE)}.length()"
 
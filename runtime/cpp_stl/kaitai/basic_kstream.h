@@ -0,0 +1,234 @@
+#ifndef KAITAI_BASIC_KSTREAM_H
+#define KAITAI_BASIC_KSTREAM_H
+
+#include <kaitai/kaitaistream.h>
+
+#include <stdint.h> // int8_t, int16_t, int32_t, int64_t, uint8_t, uint16_t, uint32_t, uint64_t
+
+#include <cstddef> // std::size_t
+#include <cstring> // std::memcpy, std::memset
+#include <istream> // std::istream
+#include <string> // std::string
+#include <vector> // std::vector
+
+namespace kaitai {
+
+/**
+ * Backend policy of basic_kstream for streams over a single contiguous
+ * in-memory buffer: a `std::string`, a pointer and a length (e.g. of a
+ * memory-mapped file), or a substream of such a stream. A read either fits
+ * into the buffer or fails, and pos() is just the offset into it.
+ */
+struct memory_backend {
+    /** Type of streams that substreams can be created from */
+    typedef basic_kstream<memory_backend> parent_type;
+};
+
+/**
+ * Backend policy of basic_kstream for any kind of stream supported by
+ * kaitai::kstream (std::istream, segments, substreams of any kstream...).
+ * Reads that don't fit into the current window are handed over to
+ * kaitai::kstream.
+ */
+struct generic_backend {
+    /** Type of streams that substreams can be created from */
+    typedef kstream parent_type;
+
+    static void check_generic() {}
+};
+
+/**
+ * Variant of kaitai::kstream with primitive readers defined in this header,
+ * so that they can be inlined into the generated code: reading an integer
+ * boils down to a bounds check, a load and possibly a byte swap, and the
+ * compiler is free to merge the checks of adjacent reads and drop redundant
+ * align_to_byte() resets.
+ *
+ * It behaves exactly like kaitai::kstream and can be passed wherever one is
+ * expected; only calls made through a basic_kstream are inlined. Code
+ * generated with `--cpp-stream-backend memory` (or `generic`) takes a
+ * `kaitai::basic_kstream<kaitai::memory_backend>` (or
+ * `kaitai::basic_kstream<kaitai::generic_backend>`).
+ *
+ * \tparam Backend memory_backend or generic_backend
+ */
+template <class Backend>
+class basic_kstream : public kstream {
+public:
+    /**
+     * Constructs new Kaitai Stream object over a copy of a given string.
+     * \param data data to read from the stream
+     */
+    basic_kstream(const std::string& data) : kstream(data) {}
+
+    /**
+     * Constructs new Kaitai Stream object over a given memory buffer, which
+     * must outlive the stream.
+     * \param data pointer to the first byte of the data
+     * \param len length of the data in bytes
+     */
+    basic_kstream(const char* data, std::size_t len) : kstream(data, len) {}
+
+    /**
+     * Constructs new Kaitai Stream object reading `len` bytes of a parent
+     * stream, starting at `offset` (see kaitai::kstream).
+     */
+    basic_kstream(typename Backend::parent_type* parent, uint64_t offset, uint64_t len) :
+        kstream(parent, offset, len) {}
+
+    /**
+     * Constructs new Kaitai Stream object, wrapping a given std::istream
+     * (generic_backend only).
+     */
+    basic_kstream(std::istream* io) : kstream(io) {
+        Backend::check_generic();
+    }
+
+    /**
+     * Constructs new Kaitai Stream object, reading a given std::istream
+     * through a read-ahead buffer (generic_backend only).
+     */
+    basic_kstream(std::istream* io, std::size_t buffer_size) : kstream(io, buffer_size) {
+        Backend::check_generic();
+    }
+
+    /**
+     * Constructs new Kaitai Stream object over a list of memory segments
+     * (generic_backend only).
+     */
+    basic_kstream(const std::vector<segment>& segments) : kstream(segments) {
+        Backend::check_generic();
+    }
+
+    /** @name Stream positioning */
+    //@{
+
+    bool is_eof() const;
+    uint64_t pos();
+
+    //@}
+
+    /** @name Integer numbers */
+    //@{
+
+    int8_t read_s1() { return static_cast<int8_t>(read_u1()); }
+    int16_t read_s2be() { return static_cast<int16_t>(read_u2be()); }
+    int32_t read_s4be() { return static_cast<int32_t>(read_u4be()); }
+    int64_t read_s8be() { return static_cast<int64_t>(read_u8be()); }
+    int16_t read_s2le() { return static_cast<int16_t>(read_u2le()); }
+    int32_t read_s4le() { return static_cast<int32_t>(read_u4le()); }
+    int64_t read_s8le() { return static_cast<int64_t>(read_u8le()); }
+
+    uint8_t read_u1() {
+        unsigned char b[1];
+        read_aligned(b, 1);
+        return b[0];
+    }
+
+    uint16_t read_u2be() {
+        unsigned char b[2];
+        read_aligned(b, 2);
+        return load_u2be(b);
+    }
+
+    uint32_t read_u4be() {
+        unsigned char b[4];
+        read_aligned(b, 4);
+        return load_u4be(b);
+    }
+
+    uint64_t read_u8be() {
+        unsigned char b[8];
+        read_aligned(b, 8);
+        return load_u8be(b);
+    }
+
+    uint16_t read_u2le() {
+        unsigned char b[2];
+        read_aligned(b, 2);
+        return load_u2le(b);
+    }
+
+    uint32_t read_u4le() {
+        unsigned char b[4];
+        read_aligned(b, 4);
+        return load_u4le(b);
+    }
+
+    uint64_t read_u8le() {
+        unsigned char b[8];
+        read_aligned(b, 8);
+        return load_u8le(b);
+    }
+
+    //@}
+
+    /** @name Floating point numbers */
+    //@{
+
+    float read_f4be() { return to_float(read_u4be()); }
+    double read_f8be() { return to_double(read_u8be()); }
+    float read_f4le() { return to_float(read_u4le()); }
+    double read_f8le() { return to_double(read_u8le()); }
+
+    //@}
+
+private:
+    // Not copyable, just like kaitai::kstream
+    basic_kstream(const basic_kstream&);
+    basic_kstream& operator=(const basic_kstream&);
+
+    // Reads exactly `len` bytes into `buf` after dropping any leftover bits
+    void read_aligned(unsigned char* buf, std::size_t len);
+};
+
+// A memory-backed stream is a single window starting at position 0, which
+// can't be refilled
+
+template <>
+inline bool basic_kstream<memory_backend>::is_eof() const {
+    return (m_bits_left & 7) == 0 && m_buf_pos >= m_buf_len;
+}
+
+template <>
+inline uint64_t basic_kstream<memory_backend>::pos() {
+    return m_buf_pos;
+}
+
+template <>
+inline void basic_kstream<memory_backend>::read_aligned(unsigned char* buf, std::size_t len) {
+    align_to_byte();
+    if (len <= m_buf_len - m_buf_pos) {
+        std::memcpy(buf, m_buf + m_buf_pos, len);
+        m_buf_pos += len;
+        return;
+    }
+    // What doesn't fit is past the end: there is nothing to refill from
+    std::memset(buf, 0, len);
+    eof_error(m_buf_pos);
+}
+
+template <>
+inline bool basic_kstream<generic_backend>::is_eof() const {
+    return kstream::is_eof();
+}
+
+template <>
+inline uint64_t basic_kstream<generic_backend>::pos() {
+    return kstream::pos();
+}
+
+template <>
+inline void basic_kstream<generic_backend>::read_aligned(unsigned char* buf, std::size_t len) {
+    align_to_byte();
+    if (len <= m_buf_len - m_buf_pos) {
+        std::memcpy(buf, m_buf + m_buf_pos, len);
+        m_buf_pos += len;
+        return;
+    }
+    read_raw_slow(reinterpret_cast<char*>(buf), len);
+}
+
+}
+
+#endif
@@ -1,14 +1,130 @@
 #ifndef KAITAI_CUSTOM_DECODER_H
 #define KAITAI_CUSTOM_DECODER_H
 
-#include <string>
+#include <stdint.h> // uint8_t
+
+#include <cstddef> // std::size_t
+#include <cstring> // std::memcpy
+#include <stdexcept> // std::logic_error
+#include <string> // std::string
 
 namespace kaitai {
 
+/**
+ * Base class of the decoders named in `process: ...` keys. A decoder either
+ * overrides decode(), which takes and returns whole strings, or
+ * decode_into(), which reads the input in place and appends its output to an
+ * output_buffer, saving the copies and allocations decode() implies.
+ * Generated code calls process(), which uses whichever one is implemented.
+ */
 class custom_decoder {
 public:
+    /**
+     * Growable output of decode_into(), appended to either by append() and
+     * push_back(), or by writing to the room returned by prepare() and then
+     * committing the bytes written.
+     */
+    class output_buffer {
+    public:
+        explicit output_buffer(std::string& str) : m_str(str), m_size(0) {}
+
+        /**
+         * Returns room for at least `n` more bytes after those written so
+         * far; pointers returned earlier are invalidated if it grows.
+         */
+        uint8_t* prepare(std::size_t n) {
+            if (m_str.size() - m_size < n) {
+                std::size_t grown = m_str.size() * 2;
+                m_str.resize(grown > m_size + n ? grown : m_size + n);
+            }
+            return m_str.empty() ? NULL : reinterpret_cast<uint8_t*>(&m_str[0]) + m_size;
+        }
+
+        /** Marks `n` bytes of the room returned by prepare() as written */
+        void commit(std::size_t n) { m_size += n; }
+
+        void append(const uint8_t* data, std::size_t n) {
+            if (n == 0)
+                return;
+            std::memcpy(prepare(n), data, n);
+            commit(n);
+        }
+
+        void push_back(uint8_t byte) {
+            *prepare(1) = byte;
+            commit(1);
+        }
+
+        /** Start of the bytes written so far */
+        uint8_t* data() { return prepare(0); }
+        std::size_t size() const { return m_size; }
+
+    private:
+        friend class custom_decoder;
+
+        void finish() { m_str.resize(m_size); }
+
+        std::string& m_str;
+        std::size_t m_size;
+
+        output_buffer(const output_buffer&);
+        output_buffer& operator=(const output_buffer&);
+    };
+
     virtual ~custom_decoder() {};
-    virtual std::string decode(std::string src) = 0;
+
+    /**
+     * Decodes `src` as a whole. Decoders implementing decode_into() need not
+     * override it.
+     */
+    virtual std::string decode(std::string src) {
+        std::string res;
+        output_buffer out(res);
+        if (!decode_into(reinterpret_cast<const uint8_t*>(src.data()), src.size(), out))
+            throw std::logic_error("custom_decoder: neither decode() nor decode_into() is implemented");
+        out.finish();
+        return res;
+    }
+
+    /**
+     * Decodes `n` bytes at `in`, appending the result to `out`.
+     * \return false if the decoder doesn't implement it (the default), in
+     *   which case it must not have written anything
+     */
+    virtual bool decode_into(const uint8_t* in, std::size_t n, output_buffer& out) {
+        (void)in;
+        (void)n;
+        (void)out;
+        return false;
+    }
+
+    /**
+     * Tells that decode_into() can decode its input in place: `in` then
+     * points to `out.data()`, and the output must never get ahead of the
+     * input read so far (which also means it can't get longer).
+     */
+    virtual bool decodes_in_place() const { return false; }
+
+    /**
+     * Decodes `src` with decode_into() if the decoder implements it, and
+     * with decode() otherwise. The result is built right in the returned
+     * string: decoding in place, it takes a single copy of `src`.
+     */
+    std::string process(const std::string& src) {
+        std::string res;
+        output_buffer out(res);
+        bool done;
+        if (decodes_in_place()) {
+            res = src;
+            done = decode_into(out.data(), res.size(), out);
+        } else {
+            done = decode_into(reinterpret_cast<const uint8_t*>(src.data()), src.size(), out);
+        }
+        if (!done)
+            return decode(src);
+        out.finish();
+        return res;
+    }
 };
 
 }
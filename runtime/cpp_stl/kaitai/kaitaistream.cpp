@@ -57,18 +57,35 @@
 
 #include <stdint.h> // int8_t, int16_t, int32_t, int64_t, uint8_t, uint16_t, uint32_t, uint64_t
 
-#include <algorithm> // std::reverse
+#include <algorithm> // std::reverse, std::min, std::max, std::upper_bound
 #include <cerrno> // errno, EINVAL, E2BIG, EILSEQ, ERANGE
 #include <cstdlib> // std::size_t, std::strtoll
-#include <cstring> // std::memcpy
+#include <cstring> // std::memcpy, std::memchr, std::memcmp, std::strcmp, std::strncmp, std::strerror
 #include <ios> // std::streamsize
 #include <istream> // std::istream  // IWYU pragma: keep
 #include <limits> // std::numeric_limits
 #include <sstream> // std::stringstream, std::ostringstream  // IWYU pragma: keep
-#include <stdexcept> // std::runtime_error, std::invalid_argument, std::out_of_range
+#include <stdexcept> // std::runtime_error, std::invalid_argument, std::out_of_range, std::logic_error
 #include <string> // std::string, std::getline
+#include <utility> // std::pair, std::make_pair
 #include <vector> // std::vector
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define KS_SIMD_SSE2
+#include <emmintrin.h> // _mm_loadu_si128, _mm_cmpeq_epi8, _mm_movemask_epi8, _mm_shufflelo_epi16...
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define KS_SIMD_NEON
+#include <arm_neon.h> // vld1q_u8, vrev16q_u8, vrev32q_u8, vrev64q_u8, vst1q_u8, veorq_u8, vshlq_u8...
+#endif
+
+// AVX2 and AVX-512 kernels are compiled with per-function target attributes
+// and picked at runtime with __builtin_cpu_supports()
+#if defined(KS_SIMD_SSE2) && (defined(__x86_64__) || defined(__i386__)) && \
+    ((defined(__clang__) && __clang_major__ >= 5) || (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 6))
+#define KS_SIMD_X86_DISPATCH
+#include <immintrin.h> // _mm256_loadu_si256, _mm512_loadu_si512, _mm512_sll_epi16...
+#endif
+
 namespace {
 
 void rewind_on_failed_read(std::istream* io, std::istream::pos_type pos_before_read) {
@@ -90,6 +107,10 @@ void read_exact(std::istream* io, char* buf, std::streamsize len) {
     }
 }
 
+void throw_eof() {
+    throw std::ios_base::failure("end of stream reached");
+}
+
 }
 
 #ifdef KAITAI_STREAM_H_CPP11_SUPPORT
@@ -148,23 +169,968 @@ static bit_cast(const From &src)
 }
 #endif
 
+// ========================================================================
+// Memory-mapped files
+// ========================================================================
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+
+namespace {
+
+void unmap_file(void *addr, std::size_t) {
+    UnmapViewOfFile(addr);
+}
+
+void advise_memory(const char *, std::size_t, kaitai::kstream::access_hint_t) {
+    // No equivalent of `posix_madvise()` that would be worth it
+}
+
+void throw_mmap_error(const char *what, const std::string &path) {
+    throw std::runtime_error(
+        std::string("from_mmap: ") + what + " failed for '" + path + "': error code " +
+            kaitai::kstream::to_string(static_cast<unsigned long>(GetLastError()))
+    );
+}
+
+}
+
+kaitai::kstream *kaitai::kstream::from_mmap(const std::string &path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        throw_mmap_error("CreateFileA()", path);
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        throw_mmap_error("GetFileSizeEx()", path);
+    }
+    if (static_cast<uint64_t>(file_size.QuadPart) > std::numeric_limits<std::size_t>::max()) {
+        CloseHandle(file);
+        throw std::runtime_error("from_mmap: file '" + path + "' is too large to be mapped");
+    }
+    std::size_t len = static_cast<std::size_t>(file_size.QuadPart);
+
+    void *addr = NULL;
+    if (len > 0) {
+        // The view keeps the mapping (and the file) alive after the handles are closed
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            CloseHandle(file);
+            throw_mmap_error("CreateFileMappingA()", path);
+        }
+        addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (addr == NULL) {
+            CloseHandle(file);
+            throw_mmap_error("MapViewOfFile()", path);
+        }
+    }
+    CloseHandle(file);
+
+    return from_mapping(addr, len);
+}
+#else
+#include <fcntl.h> // open, O_RDONLY
+#include <sys/mman.h> // mmap, munmap, posix_madvise
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close, pread, sysconf
+
+namespace {
+
+void unmap_file(void *addr, std::size_t len) {
+    munmap(addr, len);
+}
+
+void advise_memory(const char *addr, std::size_t len, kaitai::kstream::access_hint_t hint) {
+    int advice;
+    switch (hint) {
+        case kaitai::kstream::HINT_SEQUENTIAL:
+            advice = POSIX_MADV_SEQUENTIAL;
+            break;
+        case kaitai::kstream::HINT_RANDOM:
+            advice = POSIX_MADV_RANDOM;
+            break;
+        case kaitai::kstream::HINT_WILLNEED:
+            advice = POSIX_MADV_WILLNEED;
+            break;
+        default:
+            advice = POSIX_MADV_NORMAL;
+            break;
+    }
+    // The address has to be page-aligned. Failures are ignored, it's just a hint.
+    uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+    uintptr_t aligned_start = start & ~(page_size - 1);
+    posix_madvise(reinterpret_cast<void *>(aligned_start), len + (start - aligned_start), advice);
+}
+
+void throw_mmap_error(const char *what, const std::string &path, int err) {
+    throw std::runtime_error(
+        std::string("from_mmap: ") + what + " failed for '" + path + "': " + std::strerror(err)
+    );
+}
+
+}
+
+kaitai::kstream *kaitai::kstream::from_mmap(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw_mmap_error("open()", path, errno);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        throw_mmap_error("fstat()", path, err);
+    }
+    if (static_cast<uint64_t>(st.st_size) > std::numeric_limits<std::size_t>::max()) {
+        ::close(fd);
+        throw std::runtime_error("from_mmap: file '" + path + "' is too large to be mapped");
+    }
+    std::size_t len = static_cast<std::size_t>(st.st_size);
+
+    // `mmap()` rejects zero-length mappings, so an empty file is just an empty buffer
+    void *addr = NULL;
+    if (len > 0) {
+        addr = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw_mmap_error("mmap()", path, err);
+        }
+    }
+    // The mapping stays valid after the file descriptor is closed
+    ::close(fd);
+
+    return from_mapping(addr, len);
+}
+#endif
+
+kaitai::kstream *kaitai::kstream::from_mapping(void *addr, std::size_t len) {
+    kstream *ks;
+    try {
+        ks = new kstream(static_cast<const char *>(addr), len);
+    } catch (...) {
+        if (addr != NULL)
+            unmap_file(addr, len);
+        throw;
+    }
+    ks->m_mmap_addr = addr;
+    ks->m_mmap_len = len;
+    ks->m_buf_mapped = true;
+    return ks;
+}
+
+// ========================================================================
+// Block sources
+// ========================================================================
+
+/**
+ * Source of data for streams that are read through a window of a limited
+ * size (as opposed to legacy unbuffered std::istream and in-memory buffers).
+ * kstream reads from the current window directly; a source is only asked
+ * for another window when a read crosses its end or a seek leaves it.
+ */
+class kaitai::kstream_source {
+public:
+    virtual ~kstream_source() {}
+
+    /**
+     * Provides a window of data that contains absolute position `pos`.
+     * \param pos position that has to be covered by the window
+     * \param data set to the start of the window
+     * \param start set to absolute position of the start of the window,
+     *   `start <= pos`
+     * \return window length, such that `start + len >= pos`; the window ends
+     *   at `pos` only if there is no data at `pos` (end of stream)
+     */
+    virtual std::size_t fetch(uint64_t pos, const char *&data, uint64_t &start) = 0;
+
+    /**
+     * Called when the stream is about to be positioned to `pos` outside of
+     * the current window, before any data is fetched from there. May throw
+     * if the source cannot get there.
+     */
+    virtual void seek(uint64_t pos) {
+        (void) pos;
+    }
+
+    /**
+     * \return total size of the data in bytes
+     */
+    virtual uint64_t size() = 0;
+
+    /**
+     * Provides `len` bytes at absolute position `pos` as a contiguous buffer
+     * that stays valid as long as the underlying data does (independently of
+     * fetch()), if possible.
+     * \return pointer to the first byte, or NULL if there is no such buffer
+     */
+    virtual const char *contiguous(uint64_t pos, uint64_t len) {
+        (void) pos;
+        (void) len;
+        return NULL;
+    }
+
+    /**
+     * Passes an access pattern hint for the range of `len` bytes (or up to
+     * the end if `len` is 0) at `pos` to the operating system, if applicable.
+     */
+    virtual void advise(kaitai::kstream::access_hint_t hint, uint64_t pos, uint64_t len) {
+        (void) hint;
+        (void) pos;
+        (void) len;
+    }
+};
+
+namespace {
+
+/**
+ * Reads an std::istream in blocks through its stream buffer, which avoids
+ * per-read sentry, tellg() and exception mask handling of std::istream.
+ */
+class istream_source : public kaitai::kstream_source {
+public:
+    istream_source(std::istream *io, std::size_t block_size, uint64_t io_pos) :
+        m_sb(io->rdbuf()), m_block(block_size), m_io_pos(io_pos) {}
+
+    std::size_t fetch(uint64_t pos, const char *&data, uint64_t &start) {
+        if (pos != m_io_pos) {
+            if (m_sb->pubseekpos(pos, std::ios_base::in) == std::streampos(-1))
+                throw std::ios_base::failure("seek: cannot reposition the underlying stream");
+            m_io_pos = pos;
+        }
+        std::streamsize n = m_sb->sgetn(&m_block[0], static_cast<std::streamsize>(m_block.size()));
+        m_io_pos += n;
+        data = &m_block[0];
+        start = pos;
+        return static_cast<std::size_t>(n);
+    }
+
+    uint64_t size() {
+        std::streampos end = m_sb->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+        if (end == std::streampos(-1) ||
+                m_sb->pubseekpos(m_io_pos, std::ios_base::in) == std::streampos(-1))
+            throw std::ios_base::failure("size: the underlying stream is not seekable");
+        return end;
+    }
+
+private:
+    std::streambuf *m_sb;
+    std::vector<char> m_block;
+    // Current position of `m_sb`
+    uint64_t m_io_pos;
+};
+
+/**
+ * Source of data that can only be produced in order (read from a pipe,
+ * decompressed, etc.). Data is produced in blocks and at least
+ * `rewind_size` bytes before the current position are kept, so that seeking
+ * back that far still works.
+ */
+class forward_source : public kaitai::kstream_source {
+public:
+    forward_source(std::size_t block_size, std::size_t rewind_size) :
+        m_block_size(block_size), m_rewind_size(rewind_size), m_base(0) {}
+
+    std::size_t fetch(uint64_t pos, const char *&data, uint64_t &start) {
+        seek(pos);
+        while (pos >= m_base + m_data.size()) {
+            // Forget what is too far behind `pos` and append the next block
+            uint64_t keep_from = pos > m_rewind_size ? pos - m_rewind_size : 0;
+            std::size_t drop = static_cast<std::size_t>(
+                std::min<uint64_t>(keep_from > m_base ? keep_from - m_base : 0, m_data.size()));
+            m_data.erase(m_data.begin(), m_data.begin() + drop);
+            m_base += drop;
+
+            std::size_t old_len = m_data.size();
+            m_data.resize(old_len + m_block_size);
+            std::size_t n = produce(&m_data[old_len], m_block_size);
+            m_data.resize(old_len + n);
+            if (n == 0) {
+                // End of stream: return an empty window at `pos`
+                data = NULL;
+                start = pos;
+                return 0;
+            }
+        }
+        data = &m_data[0];
+        start = m_base;
+        return m_data.size();
+    }
+
+    void seek(uint64_t pos) {
+        if (pos >= m_base)
+            return;
+        if (!restart()) {
+            throw std::ios_base::failure(
+                "seek: position " + kaitai::kstream::to_string(pos) +
+                " is outside of the rewind window of a non-seekable stream (it starts at " +
+                kaitai::kstream::to_string(m_base) + ")"
+            );
+        }
+        m_data.clear();
+        m_base = 0;
+    }
+
+protected:
+    /**
+     * Produces up to `len` next bytes of data into `buf`.
+     * \return number of bytes produced, 0 only at the end of data
+     */
+    virtual std::size_t produce(char *buf, std::size_t len) = 0;
+
+    /**
+     * Makes produce() start from the beginning of data again, if possible.
+     * \return false if the source cannot do that
+     */
+    virtual bool restart() {
+        return false;
+    }
+
+    // Number of bytes produced so far
+    uint64_t produced() const {
+        return m_base + m_data.size();
+    }
+
+private:
+    std::size_t m_block_size;
+    std::size_t m_rewind_size;
+    // Data that is still kept, starting at absolute position `m_base`
+    std::vector<char> m_data;
+    uint64_t m_base;
+};
+
+/**
+ * Reads a forward-only std::istream (a pipe, a socket, decompressor output),
+ * which is never asked to seek.
+ */
+class forward_istream_source : public forward_source {
+public:
+    forward_istream_source(std::istream *io, std::size_t block_size, std::size_t rewind_size) :
+        forward_source(block_size, rewind_size), m_sb(io->rdbuf()) {}
+
+    uint64_t size() {
+        throw std::ios_base::failure("size: size of a non-seekable stream is not known");
+    }
+
+protected:
+    std::size_t produce(char *buf, std::size_t len) {
+        return static_cast<std::size_t>(m_sb->sgetn(buf, static_cast<std::streamsize>(len)));
+    }
+
+private:
+    std::streambuf *m_sb;
+};
+
+}
+
+// ========================================================================
+// Segmented buffers
+// ========================================================================
+
+namespace {
+
+/**
+ * Reads a list of non-contiguous in-memory segments, one segment per window.
+ */
+class segments_source : public kaitai::kstream_source {
+public:
+    segments_source(const std::vector<kaitai::kstream::segment> &segments) : m_size(0), m_cur(0) {
+        for (std::size_t i = 0; i < segments.size(); i++) {
+            // Empty segments would only get in the way of finding a segment by position
+            if (segments[i].second == 0)
+                continue;
+            m_segs.push_back(segments[i]);
+            m_starts.push_back(m_size);
+            m_size += segments[i].second;
+        }
+    }
+
+    std::size_t fetch(uint64_t pos, const char *&data, uint64_t &start) {
+        if (pos >= m_size) {
+            data = NULL;
+            start = pos;
+            return 0;
+        }
+        // Reading usually goes on in the next segment
+        std::size_t next = m_cur + 1;
+        if (next < m_segs.size() && m_starts[next] <= pos && pos - m_starts[next] < m_segs[next].second) {
+            m_cur = next;
+        } else {
+            m_cur = find(pos);
+        }
+        data = m_segs[m_cur].first;
+        start = m_starts[m_cur];
+        return m_segs[m_cur].second;
+    }
+
+    void seek(uint64_t pos) {
+        if (pos > m_size)
+            throw std::ios_base::failure("seek: position is beyond the end of stream");
+    }
+
+    uint64_t size() {
+        return m_size;
+    }
+
+    const char *contiguous(uint64_t pos, uint64_t len) {
+        if (pos >= m_size || len > m_size - pos)
+            return NULL;
+        std::size_t i = find(pos);
+        uint64_t offset = pos - m_starts[i];
+        if (len > m_segs[i].second - offset)
+            return NULL;
+        return m_segs[i].first + offset;
+    }
+
+private:
+    // Index of the segment containing `pos`, which must be less than `m_size`
+    std::size_t find(uint64_t pos) const {
+        return static_cast<std::size_t>(
+            std::upper_bound(m_starts.begin(), m_starts.end(), pos) - m_starts.begin()) - 1;
+    }
+
+    std::vector<kaitai::kstream::segment> m_segs;
+    // Absolute positions of the segments
+    std::vector<uint64_t> m_starts;
+    uint64_t m_size;
+    // Index of the segment fetched last
+    std::size_t m_cur;
+};
+
+}
+
+// ========================================================================
+// Positional file reads
+// ========================================================================
+
+#ifdef _WIN32
+#include <io.h> // _get_osfhandle
+
+namespace {
+
+void throw_fd_error(const char *what) {
+    throw std::ios_base::failure(
+        std::string(what) + " failed: error code " +
+            kaitai::kstream::to_string(static_cast<unsigned long>(GetLastError()))
+    );
+}
+
+// Reads up to `len` bytes at offset `pos` without using the file pointer
+std::size_t read_fd_at(int fd, uint64_t pos, char *buf, std::size_t len) {
+    HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+    std::size_t done = 0;
+    while (done < len) {
+        OVERLAPPED ov;
+        std::memset(&ov, 0, sizeof ov);
+        ov.Offset = static_cast<DWORD>(pos + done);
+        ov.OffsetHigh = static_cast<DWORD>((pos + done) >> 32);
+        DWORD chunk = static_cast<DWORD>(std::min<std::size_t>(len - done, 0x40000000));
+        DWORD n;
+        if (!ReadFile(file, buf + done, chunk, &n, &ov)) {
+            if (GetLastError() == ERROR_HANDLE_EOF)
+                break;
+            throw_fd_error("ReadFile()");
+        }
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+void advise_fd(int, uint64_t, uint64_t, kaitai::kstream::access_hint_t) {
+    // No equivalent of `posix_fadvise()`
+}
+
+uint64_t fd_size(int fd) {
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), &file_size))
+        throw_fd_error("GetFileSizeEx()");
+    return static_cast<uint64_t>(file_size.QuadPart);
+}
+
+}
+#else
+namespace {
+
+void throw_fd_error(const char *what, int err) {
+    throw std::ios_base::failure(std::string(what) + " failed: " + std::strerror(err));
+}
+
+// Reads up to `len` bytes at offset `pos` without using the file offset
+std::size_t read_fd_at(int fd, uint64_t pos, char *buf, std::size_t len) {
+    std::size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pread(fd, buf + done, len - done, static_cast<off_t>(pos + done));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            throw_fd_error("pread()", errno);
+        }
+        if (n == 0)
+            break;
+        done += static_cast<std::size_t>(n);
+    }
+    return done;
+}
+
+void advise_fd(int fd, uint64_t pos, uint64_t len, kaitai::kstream::access_hint_t hint) {
+#ifdef POSIX_FADV_NORMAL
+    int advice;
+    switch (hint) {
+        case kaitai::kstream::HINT_SEQUENTIAL:
+            advice = POSIX_FADV_SEQUENTIAL;
+            break;
+        case kaitai::kstream::HINT_RANDOM:
+            advice = POSIX_FADV_RANDOM;
+            break;
+        case kaitai::kstream::HINT_WILLNEED:
+            advice = POSIX_FADV_WILLNEED;
+            break;
+        default:
+            advice = POSIX_FADV_NORMAL;
+            break;
+    }
+    // Failures are ignored, it's just a hint
+    posix_fadvise(fd, static_cast<off_t>(pos), static_cast<off_t>(len), advice);
+#else
+    // e.g. macOS doesn't have `posix_fadvise()`
+    (void) fd;
+    (void) pos;
+    (void) len;
+    (void) hint;
+#endif
+}
+
+uint64_t fd_size(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        throw_fd_error("fstat()", errno);
+    return static_cast<uint64_t>(st.st_size);
+}
+
+}
+#endif
+
+namespace {
+
+/**
+ * Reads a file descriptor in blocks with positional reads. As the position
+ * lives in the stream and not in the file description, any number of these
+ * may share one descriptor (also across threads).
+ */
+class fd_source : public kaitai::kstream_source {
+public:
+    fd_source(int fd, std::size_t block_size) : m_fd(fd), m_block(block_size) {}
+
+    std::size_t fetch(uint64_t pos, const char *&data, uint64_t &start) {
+        data = &m_block[0];
+        start = pos;
+        return read_fd_at(m_fd, pos, &m_block[0], m_block.size());
+    }
+
+    uint64_t size() {
+        return fd_size(m_fd);
+    }
+
+    void advise(kaitai::kstream::access_hint_t hint, uint64_t pos, uint64_t len) {
+        advise_fd(m_fd, pos, len, hint);
+    }
+
+private:
+    int m_fd;
+    std::vector<char> m_block;
+};
+
+}
+
+#ifdef KAITAI_STREAM_H_CPP11_SUPPORT
+#include <chrono> // std::chrono::milliseconds
+#include <condition_variable> // std::condition_variable
+#include <deque> // std::deque
+#include <exception> // std::exception_ptr, std::current_exception, std::rethrow_exception
+#include <mutex> // std::mutex, std::unique_lock
+#include <thread> // std::thread
+
+namespace {
+
+/**
+ * Like fd_source, but a background thread keeps reading the blocks that
+ * follow the one being parsed into a ring of `ring_size` blocks, so that
+ * I/O overlaps with parsing. Once the stream is positioned outside of the
+ * range being read ahead, the read-ahead is dropped and starts over there.
+ */
+class prefetch_fd_source : public kaitai::kstream_source {
+public:
+    prefetch_fd_source(int fd, std::size_t block_size, std::size_t ring_size) :
+        m_fd(fd), m_block_size(block_size), m_current(NULL), m_next_pos(0),
+        m_generation(0), m_eof(false), m_stop(false) {
+        // One more block than the ring holds is the one handed out by fetch()
+        m_blocks.resize(ring_size + 1);
+        for (std::size_t i = 0; i < m_blocks.size(); i++) {
+            m_blocks[i].data.resize(block_size);
+            m_free.push_back(&m_blocks[i]);
+        }
+        m_worker = std::thread(&prefetch_fd_source::run, this);
+    }
+
+    ~prefetch_fd_source() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        m_worker.join();
+    }
+
+    std::size_t fetch(uint64_t pos, const char *&data, uint64_t &start) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_current != NULL) {
+            // Asked again for the block handed out last: keep it, and the
+            // blocks read ahead after it
+            if (pos >= m_current->start && pos < m_current->start + m_current->len) {
+                data = &m_current->data[0];
+                start = m_current->start;
+                return m_current->len;
+            }
+            m_free.push_back(m_current);
+            m_current = NULL;
+        }
+        if (!ahead(pos))
+            restart(pos);
+        // Skip the blocks before `pos`
+        while (!m_ready.empty() && m_ready.front()->len > 0 && m_ready.front()->start + m_ready.front()->len <= pos) {
+            m_free.push_back(m_ready.front());
+            m_ready.pop_front();
+        }
+        m_cond.notify_all();
+
+        wait(lock, [this] { return !m_ready.empty() || m_error || m_eof; });
+        if (m_ready.empty()) {
+            if (m_error) {
+                // Let the worker try again if the stream is read further
+                std::exception_ptr error = m_error;
+                m_error = nullptr;
+                m_eof = false;
+                m_cond.notify_all();
+                std::rethrow_exception(error);
+            }
+            data = NULL;
+            start = pos;
+            return 0;
+        }
+        m_current = m_ready.front();
+        m_ready.pop_front();
+        data = &m_current->data[0];
+        start = m_current->start;
+        return m_current->len;
+    }
+
+    void seek(uint64_t pos) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!ahead(pos)) {
+            restart(pos);
+            m_cond.notify_all();
+        }
+    }
+
+    uint64_t size() {
+        return fd_size(m_fd);
+    }
+
+    void advise(kaitai::kstream::access_hint_t hint, uint64_t pos, uint64_t len) {
+        advise_fd(m_fd, pos, len, hint);
+    }
+
+private:
+    struct block {
+        uint64_t start;
+        std::size_t len;
+        std::vector<char> data;
+    };
+
+    // Same as `m_cond.wait(lock, pred)`, but the timed wait does not make the
+    // library require libstdc++ from GCC 12 or newer when built by it (unlike
+    // untimed `std::condition_variable::wait()`)
+    template<class Predicate>
+    void wait(std::unique_lock<std::mutex> &lock, Predicate pred) {
+        while (!pred())
+            m_cond.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    // Whether `pos` is in the range read ahead (or being read ahead) now
+    bool ahead(uint64_t pos) const {
+        uint64_t from = m_ready.empty() ? m_next_pos : m_ready.front()->start;
+        return pos >= from && pos <= m_next_pos;
+    }
+
+    // Drops the read-ahead and makes the worker continue from `pos`
+    void restart(uint64_t pos) {
+        while (!m_ready.empty()) {
+            m_free.push_back(m_ready.front());
+            m_ready.pop_front();
+        }
+        // A block the worker is reading now will be thrown away
+        m_generation++;
+        m_next_pos = pos;
+        m_eof = false;
+        m_error = nullptr;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            wait(lock, [this] { return m_stop || (!m_free.empty() && !m_eof); });
+            if (m_stop)
+                return;
+            block *b = m_free.back();
+            m_free.pop_back();
+            uint64_t pos = m_next_pos;
+            unsigned generation = m_generation;
+
+            lock.unlock();
+            std::exception_ptr error;
+            std::size_t len = 0;
+            try {
+                len = read_fd_at(m_fd, pos, &b->data[0], m_block_size);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            lock.lock();
+
+            if (generation != m_generation || error) {
+                m_free.push_back(b);
+                if (generation == m_generation) {
+                    m_error = error;
+                    m_eof = true;
+                    m_cond.notify_all();
+                }
+                continue;
+            }
+            b->start = pos;
+            b->len = len;
+            m_ready.push_back(b);
+            m_next_pos = pos + len;
+            // An empty block marks the end of the file
+            if (len == 0)
+                m_eof = true;
+            m_cond.notify_all();
+        }
+    }
+
+    int m_fd;
+    std::size_t m_block_size;
+    std::vector<block> m_blocks;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    // Blocks read ahead, in order, covering [m_ready.front()->start, m_next_pos)
+    std::deque<block *> m_ready;
+    std::vector<block *> m_free;
+    // Block returned by the last fetch()
+    block *m_current;
+    // Position the worker reads from next
+    uint64_t m_next_pos;
+    // Incremented whenever the read-ahead is dropped
+    unsigned m_generation;
+    // The worker has nothing more to read (end of file or an error)
+    bool m_eof;
+    std::exception_ptr m_error;
+    bool m_stop;
+
+    std::thread m_worker;
+};
+
+}
+#endif
+
+kaitai::kstream *kaitai::kstream::from_fd(int fd, std::size_t buffer_size, std::size_t prefetch_blocks) {
+    if (buffer_size == 0)
+        buffer_size = DEFAULT_BUFFER_SIZE;
+#ifdef KAITAI_STREAM_H_CPP11_SUPPORT
+    if (prefetch_blocks > 0)
+        return new kstream(new prefetch_fd_source(fd, buffer_size, prefetch_blocks));
+#else
+    (void) prefetch_blocks;
+#endif
+    return new kstream(new fd_source(fd, buffer_size));
+}
+
+// ========================================================================
+// Construction
+// ========================================================================
+
+const std::size_t kaitai::kstream::DEFAULT_BUFFER_SIZE;
+
 kaitai::kstream::kstream(std::istream *io) {
     m_io = io;
+    m_buf = NULL;
+    m_buf_len = 0;
+    init();
+}
+
+kaitai::kstream::kstream(std::istream *io, std::size_t buffer_size) {
+    m_io = io;
+    m_buf = NULL;
+    m_buf_len = 0;
+    init();
+    if (buffer_size == 0)
+        return;
+
+    std::streampos io_pos = io->rdbuf()->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+    if (io_pos == std::streampos(-1)) {
+        // Non-seekable streams (pipes) just start at 0
+        m_src = new forward_istream_source(io, buffer_size, buffer_size);
+    } else {
+        m_buf_start = static_cast<uint64_t>(io_pos);
+        m_src = new istream_source(io, buffer_size, m_buf_start);
+    }
+    m_io = NULL;
+}
+
+kaitai::kstream::kstream(std::istream *io, std::size_t buffer_size, std::size_t rewind_size) {
+    m_io = NULL;
+    m_buf = NULL;
+    m_buf_len = 0;
+    init();
+    m_src = new forward_istream_source(io, buffer_size > 0 ? buffer_size : DEFAULT_BUFFER_SIZE, rewind_size);
+}
+
+kaitai::kstream::kstream(kstream_source *src) {
+    m_io = NULL;
+    m_buf = NULL;
+    m_buf_len = 0;
+    init();
+    m_src = src;
+}
+
+kaitai::kstream::kstream(const std::string &data) : m_buf_owned(data) {
+    m_io = NULL;
+    m_buf = m_buf_owned.data();
+    m_buf_len = m_buf_owned.length();
+    init();
+}
+
+kaitai::kstream::kstream(const char *data, std::size_t len) {
+    m_io = NULL;
+    m_buf = data;
+    m_buf_len = len;
     init();
 }
 
-kaitai::kstream::kstream(const std::string &data) : m_io_str(data) {
-    m_io = &m_io_str;
+kaitai::kstream::kstream(const std::vector<segment> &segments) {
+    m_io = NULL;
+    m_buf = NULL;
+    m_buf_len = 0;
     init();
+    m_src = new segments_source(segments);
+}
+
+kaitai::kstream::kstream(kstream *parent, uint64_t offset, uint64_t len) {
+    m_io = NULL;
+    const char *view;
+    bool mapped = false;
+    if (parent->m_io == NULL && parent->m_src == NULL) {
+        if (offset > parent->m_buf_len || len > parent->m_buf_len - offset) {
+            // Left empty in the ERRORS_STATUS mode
+            parent->eof_error(offset);
+            m_buf = NULL;
+            m_buf_len = 0;
+        } else {
+            m_buf = parent->m_buf + offset;
+            m_buf_len = static_cast<std::size_t>(len);
+            mapped = parent->m_buf_mapped;
+        }
+    } else if (parent->m_src != NULL && (view = parent->m_src->contiguous(offset, len)) != NULL) {
+        m_buf = view;
+        m_buf_len = static_cast<std::size_t>(len);
+    } else {
+        uint64_t parent_pos = parent->pos();
+        parent->seek(offset);
+        try {
+            m_buf_owned = parent->read_bytes(static_cast<std::streamsize>(len));
+        } catch (...) {
+            parent->seek(parent_pos);
+            throw;
+        }
+        parent->seek(parent_pos);
+        m_buf = m_buf_owned.data();
+        m_buf_len = m_buf_owned.length();
+    }
+    init();
+    m_buf_mapped = mapped;
+    if (parent->m_error_mode == ERRORS_STATUS)
+        set_error_parent(parent, offset);
 }
 
 void kaitai::kstream::init() {
-    exceptions_enable();
+    m_buf_pos = 0;
+    m_buf_start = 0;
+    m_src = NULL;
+    m_mmap_addr = NULL;
+    m_mmap_len = 0;
+    m_buf_mapped = false;
+    m_hint = HINT_NORMAL;
+    m_error_mode = ERRORS_THROW;
+    m_status = STATUS_OK;
+    m_error_pos = 0;
+    m_error_parent = NULL;
+    m_error_offset = 0;
+    m_size = 0;
+    m_size_known = false;
+    if (m_io != NULL) {
+        exceptions_enable();
+        cache_io_size();
+    }
+    m_bits_pos = 0;
+    m_bits_le = false;
     align_to_byte();
 }
 
+// Remembers the size of a seekable std::istream, so that is_eof() and size()
+// are answered without touching its state or position
+void kaitai::kstream::cache_io_size() {
+    std::streambuf *sb = m_io->rdbuf();
+    std::streampos cur = sb->pubseekoff(0, std::ios_base::cur, std::ios_base::in);
+    if (cur == std::streampos(-1))
+        return;
+    std::streampos end = sb->pubseekoff(0, std::ios_base::end, std::ios_base::in);
+    if (end == std::streampos(-1))
+        return;
+    if (sb->pubseekpos(cur, std::ios_base::in) == std::streampos(-1))
+        throw std::ios_base::failure("size: cannot reposition the underlying stream");
+    m_size = static_cast<uint64_t>(end);
+    m_size_known = true;
+}
+
+kaitai::kstream::~kstream() {
+    close();
+}
+
 void kaitai::kstream::close() {
     //  m_io->close();
+    if (m_src != NULL) {
+        delete m_src;
+        m_src = NULL;
+        m_buf = NULL;
+        m_buf_len = 0;
+        m_buf_pos = 0;
+    }
+    if (m_mmap_addr != NULL) {
+        unmap_file(m_mmap_addr, m_mmap_len);
+        m_mmap_addr = NULL;
+        m_mmap_len = 0;
+        m_buf = NULL;
+        m_buf_len = 0;
+        m_buf_pos = 0;
+    }
 }
 
 void kaitai::kstream::exceptions_enable() const {
@@ -175,14 +1141,128 @@ void kaitai::kstream::exceptions_enable() const {
     );
 }
 
+// Reads exactly `len` bytes into `buf`. If they are all in the current
+// window, this is just a bounds check and a copy; everything else is left to
+// `read_raw_slow()`. The window may be empty with `m_buf` NULL, which
+// memcpy() must not be given even for 0 bytes.
+inline void kaitai::kstream::read_raw(char *buf, std::size_t len) {
+    if (len <= m_buf_len - m_buf_pos) {
+        if (len != 0)
+            std::memcpy(buf, m_buf + m_buf_pos, len);
+        m_buf_pos += len;
+        return;
+    }
+    read_raw_slow(buf, len);
+}
+
+void kaitai::kstream::read_raw_slow(char *buf, std::size_t len) {
+    if (m_io != NULL) {
+        if (m_error_mode != ERRORS_STATUS) {
+            read_exact(m_io, buf, static_cast<std::streamsize>(len));
+            return;
+        }
+        uint64_t pos_before_read = pos();
+        try {
+            read_exact(m_io, buf, static_cast<std::streamsize>(len));
+        } catch (std::ios_base::failure&) {
+            std::memset(buf, 0, len);
+            eof_error(pos_before_read);
+        }
+        return;
+    }
+    if (m_src == NULL) {
+        std::memset(buf, 0, len);
+        eof_error(pos());
+        return;
+    }
+
+    uint64_t pos_before_read = pos();
+    char *start = buf;
+    std::size_t total = len;
+    while (true) {
+        std::size_t n = m_buf_len - m_buf_pos;
+        if (n > len)
+            n = len;
+        if (n > 0) {
+            std::memcpy(buf, m_buf + m_buf_pos, n);
+            m_buf_pos += n;
+            buf += n;
+            len -= n;
+        }
+        if (len == 0)
+            return;
+        if (!refill()) {
+            seek(pos_before_read);
+            std::memset(start, 0, total);
+            eof_error(pos_before_read);
+            return;
+        }
+    }
+}
+
+std::size_t kaitai::kstream::read_partial(char *buf, std::size_t len) {
+    std::size_t done = 0;
+    while (done < len) {
+        if (m_buf_pos == m_buf_len && !refill())
+            break;
+        std::size_t n = m_buf_len - m_buf_pos;
+        if (n > len - done)
+            n = len - done;
+        std::memcpy(buf + done, m_buf + m_buf_pos, n);
+        m_buf_pos += n;
+        done += n;
+    }
+    return done;
+}
+
+bool kaitai::kstream::refill() const {
+    if (m_src == NULL)
+        return false;
+    uint64_t pos = m_buf_start + m_buf_pos;
+    m_buf_len = m_src->fetch(pos, m_buf, m_buf_start);
+    m_buf_pos = static_cast<std::size_t>(pos - m_buf_start);
+    return m_buf_pos < m_buf_len;
+}
+
+bool kaitai::kstream::ensure_available_slow(std::size_t n) {
+    // Only fetch the next window once the current one is used up: bytes
+    // crossing its end are left to the checked reads, as refetching from
+    // the middle of a window would re-read data (or, with read-ahead, drop
+    // the blocks already read ahead). Don't fetch if there is no source or
+    // the bytes go past the end of stream either.
+    if (m_src == NULL || m_buf_pos < m_buf_len)
+        return false;
+    uint64_t pos = m_buf_start + m_buf_pos;
+    if (m_size_known && (pos > m_size || n > m_size - pos))
+        return false;
+
+    // If the bytes are still not all in the new window (they span a block or
+    // segment boundary), fall back to the checked reads as well
+    if (!refill())
+        return false;
+    return n <= m_buf_len - m_buf_pos;
+}
+
 // ========================================================================
 // Stream positioning
 // ========================================================================
 
 bool kaitai::kstream::is_eof() const {
-    if (m_bits_left > 0) {
+    // Bytes read ahead for bit reads are not consumed
+    if ((m_bits_left & 7) != 0) {
         return false;
     }
+    if (m_io == NULL) {
+        if (m_buf_pos < m_buf_len)
+            return false;
+        if (m_src != NULL && m_size_known)
+            return m_buf_start + m_buf_pos >= m_size;
+        return !refill();
+    }
+    if (m_size_known)
+        return static_cast<uint64_t>(m_io->tellg()) >= m_size;
+
+    // Not seekable: try to read a byte
     char t;
     m_io->exceptions(std::istream::badbit);
     m_io->get(t);
@@ -199,14 +1279,48 @@ bool kaitai::kstream::is_eof() const {
 
 void kaitai::kstream::seek(uint64_t pos) {
     align_to_byte();
+    if (m_io == NULL) {
+        if (pos >= m_buf_start && pos - m_buf_start <= m_buf_len) {
+            m_buf_pos = static_cast<std::size_t>(pos - m_buf_start);
+            return;
+        }
+        if (m_src == NULL) {
+            if (m_error_mode == ERRORS_STATUS) {
+                set_error(STATUS_EOF, pos);
+                return;
+            }
+            throw std::ios_base::failure("seek: position is beyond the end of stream");
+        }
+        // Leave the current window, the next read will fetch a new one
+        m_src->seek(pos);
+        m_buf = NULL;
+        m_buf_len = 0;
+        m_buf_pos = 0;
+        m_buf_start = pos;
+        return;
+    }
     m_io->seekg(pos);
 }
 
 uint64_t kaitai::kstream::pos() {
+    if (m_io == NULL)
+        return m_buf_start + m_buf_pos;
     return m_io->tellg();
 }
 
 uint64_t kaitai::kstream::size() {
+    if (m_io == NULL) {
+        if (m_src == NULL)
+            return m_buf_len;
+        // Sources that can't tell their size throw here, so it's never cached
+        if (!m_size_known) {
+            m_size = m_src->size();
+            m_size_known = true;
+        }
+        return m_size;
+    }
+    if (m_size_known)
+        return m_size;
     std::istream::pos_type cur_pos = m_io->tellg();
     m_io->seekg(0, std::istream::end);
     std::istream::pos_type len = m_io->tellg();
@@ -214,6 +1328,67 @@ uint64_t kaitai::kstream::size() {
     return len;
 }
 
+void kaitai::kstream::advise(access_hint_t hint) {
+    if (hint == m_hint)
+        return;
+    m_hint = hint;
+    if (m_src != NULL) {
+        m_src->advise(hint, 0, 0);
+    } else if (m_buf_mapped) {
+        advise_memory(m_buf, m_buf_len, hint);
+    }
+}
+
+namespace {
+
+// Ranges shorter than this (a page on most systems) are loaded in a single
+// page fault or read anyway, so hinting them would only cost a system call
+const uint64_t ADVISE_MIN_LEN = 4096;
+
+}
+
+void kaitai::kstream::advise(access_hint_t hint, uint64_t pos, uint64_t len) {
+    if (len < ADVISE_MIN_LEN)
+        return;
+    if (m_src != NULL) {
+        m_src->advise(hint, pos, len);
+    } else if (m_buf_mapped && pos < m_buf_len) {
+        advise_memory(m_buf + pos, static_cast<std::size_t>(std::min<uint64_t>(len, m_buf_len - pos)), hint);
+    }
+}
+
+// ========================================================================
+// Error reporting
+// ========================================================================
+
+void kaitai::kstream::set_error(status_t status, uint64_t pos) {
+    if (m_status == STATUS_OK) {
+        m_status = status;
+        m_error_pos = pos;
+    }
+    if (m_error_parent != NULL)
+        m_error_parent->set_error(status, m_error_offset + pos);
+}
+
+void kaitai::kstream::clear_error() {
+    m_status = STATUS_OK;
+    m_error_pos = 0;
+}
+
+void kaitai::kstream::set_error_parent(kstream *parent, uint64_t offset) {
+    m_error_mode = parent->m_error_mode;
+    m_error_parent = parent;
+    m_error_offset = offset;
+}
+
+// Reports a read or seek beyond the end of stream at `pos`: throws or, in the
+// ERRORS_STATUS mode, records it
+void kaitai::kstream::eof_error(uint64_t pos) {
+    if (m_error_mode != ERRORS_STATUS)
+        throw_eof();
+    set_error(STATUS_EOF, pos);
+}
+
 // ========================================================================
 // Integer numbers
 // ========================================================================
@@ -225,7 +1400,7 @@ uint64_t kaitai::kstream::size() {
 int8_t kaitai::kstream::read_s1() {
     align_to_byte();
     char t;
-    read_exact(m_io, &t, 1);
+    read_raw(&t, 1);
     return t;
 }
 
@@ -236,7 +1411,7 @@ int8_t kaitai::kstream::read_s1() {
 int16_t kaitai::kstream::read_s2be() {
     align_to_byte();
     int16_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 2);
+    read_raw(reinterpret_cast<char *>(&t), 2);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     t = bswap_16(t);
 #endif
@@ -246,7 +1421,7 @@ int16_t kaitai::kstream::read_s2be() {
 int32_t kaitai::kstream::read_s4be() {
     align_to_byte();
     int32_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 4);
+    read_raw(reinterpret_cast<char *>(&t), 4);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     t = bswap_32(t);
 #endif
@@ -256,7 +1431,7 @@ int32_t kaitai::kstream::read_s4be() {
 int64_t kaitai::kstream::read_s8be() {
     align_to_byte();
     int64_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 8);
+    read_raw(reinterpret_cast<char *>(&t), 8);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     t = bswap_64(t);
 #endif
@@ -270,7 +1445,7 @@ int64_t kaitai::kstream::read_s8be() {
 int16_t kaitai::kstream::read_s2le() {
     align_to_byte();
     int16_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 2);
+    read_raw(reinterpret_cast<char *>(&t), 2);
 #if __BYTE_ORDER == __BIG_ENDIAN
     t = bswap_16(t);
 #endif
@@ -280,7 +1455,7 @@ int16_t kaitai::kstream::read_s2le() {
 int32_t kaitai::kstream::read_s4le() {
     align_to_byte();
     int32_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 4);
+    read_raw(reinterpret_cast<char *>(&t), 4);
 #if __BYTE_ORDER == __BIG_ENDIAN
     t = bswap_32(t);
 #endif
@@ -290,7 +1465,7 @@ int32_t kaitai::kstream::read_s4le() {
 int64_t kaitai::kstream::read_s8le() {
     align_to_byte();
     int64_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 8);
+    read_raw(reinterpret_cast<char *>(&t), 8);
 #if __BYTE_ORDER == __BIG_ENDIAN
     t = bswap_64(t);
 #endif
@@ -304,7 +1479,7 @@ int64_t kaitai::kstream::read_s8le() {
 uint8_t kaitai::kstream::read_u1() {
     align_to_byte();
     char t;
-    read_exact(m_io, &t, 1);
+    read_raw(&t, 1);
     return t;
 }
 
@@ -315,7 +1490,7 @@ uint8_t kaitai::kstream::read_u1() {
 uint16_t kaitai::kstream::read_u2be() {
     align_to_byte();
     uint16_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 2);
+    read_raw(reinterpret_cast<char *>(&t), 2);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     t = bswap_16(t);
 #endif
@@ -325,7 +1500,7 @@ uint16_t kaitai::kstream::read_u2be() {
 uint32_t kaitai::kstream::read_u4be() {
     align_to_byte();
     uint32_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 4);
+    read_raw(reinterpret_cast<char *>(&t), 4);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     t = bswap_32(t);
 #endif
@@ -335,7 +1510,7 @@ uint32_t kaitai::kstream::read_u4be() {
 uint64_t kaitai::kstream::read_u8be() {
     align_to_byte();
     uint64_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 8);
+    read_raw(reinterpret_cast<char *>(&t), 8);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     t = bswap_64(t);
 #endif
@@ -349,7 +1524,7 @@ uint64_t kaitai::kstream::read_u8be() {
 uint16_t kaitai::kstream::read_u2le() {
     align_to_byte();
     uint16_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 2);
+    read_raw(reinterpret_cast<char *>(&t), 2);
 #if __BYTE_ORDER == __BIG_ENDIAN
     t = bswap_16(t);
 #endif
@@ -359,7 +1534,7 @@ uint16_t kaitai::kstream::read_u2le() {
 uint32_t kaitai::kstream::read_u4le() {
     align_to_byte();
     uint32_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 4);
+    read_raw(reinterpret_cast<char *>(&t), 4);
 #if __BYTE_ORDER == __BIG_ENDIAN
     t = bswap_32(t);
 #endif
@@ -369,7 +1544,7 @@ uint32_t kaitai::kstream::read_u4le() {
 uint64_t kaitai::kstream::read_u8le() {
     align_to_byte();
     uint64_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 8);
+    read_raw(reinterpret_cast<char *>(&t), 8);
 #if __BYTE_ORDER == __BIG_ENDIAN
     t = bswap_64(t);
 #endif
@@ -387,7 +1562,7 @@ uint64_t kaitai::kstream::read_u8le() {
 float kaitai::kstream::read_f4be() {
     align_to_byte();
     uint32_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 4);
+    read_raw(reinterpret_cast<char *>(&t), 4);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     t = bswap_32(t);
 #endif
@@ -397,7 +1572,7 @@ float kaitai::kstream::read_f4be() {
 double kaitai::kstream::read_f8be() {
     align_to_byte();
     uint64_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 8);
+    read_raw(reinterpret_cast<char *>(&t), 8);
 #if __BYTE_ORDER == __LITTLE_ENDIAN
     t = bswap_64(t);
 #endif
@@ -411,7 +1586,7 @@ double kaitai::kstream::read_f8be() {
 float kaitai::kstream::read_f4le() {
     align_to_byte();
     uint32_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 4);
+    read_raw(reinterpret_cast<char *>(&t), 4);
 #if __BYTE_ORDER == __BIG_ENDIAN
     t = bswap_32(t);
 #endif
@@ -421,23 +1596,241 @@ float kaitai::kstream::read_f4le() {
 double kaitai::kstream::read_f8le() {
     align_to_byte();
     uint64_t t;
-    read_exact(m_io, reinterpret_cast<char *>(&t), 8);
+    read_raw(reinterpret_cast<char *>(&t), 8);
 #if __BYTE_ORDER == __BIG_ENDIAN
     t = bswap_64(t);
 #endif
     return bit_cast<double>(t);
 }
 
+// ========================================================================
+// Arrays of numbers
+// ========================================================================
+
+namespace {
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+const bool SWAP_BE = true;
+const bool SWAP_LE = false;
+#else
+const bool SWAP_BE = false;
+const bool SWAP_LE = true;
+#endif
+
+// Reverses the byte order of each of the `n` items of `width` (2, 4 or 8)
+// bytes at `p`. The SIMD versions do 16 bytes at once: with SSE2, the bytes
+// of each 16-bit word are swapped by shifts and then the words of each item
+// are reversed by shuffles.
+void bswap_items(char *p, std::size_t n, std::size_t width) {
+    std::size_t len = n * width;
+    std::size_t i = 0;
+#if defined(KS_SIMD_SSE2)
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        if (width == 4) {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        } else if (width == 8) {
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), v);
+    }
+#elif defined(KS_SIMD_NEON)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p + i));
+        if (width == 2) {
+            v = vrev16q_u8(v);
+        } else if (width == 4) {
+            v = vrev32q_u8(v);
+        } else {
+            v = vrev64q_u8(v);
+        }
+        vst1q_u8(reinterpret_cast<uint8_t *>(p + i), v);
+    }
+#endif
+    switch (width) {
+    case 2:
+        for (; i < len; i += 2) {
+            uint16_t t;
+            std::memcpy(&t, p + i, 2);
+            t = bswap_16(t);
+            std::memcpy(p + i, &t, 2);
+        }
+        break;
+    case 4:
+        for (; i < len; i += 4) {
+            uint32_t t;
+            std::memcpy(&t, p + i, 4);
+            t = bswap_32(t);
+            std::memcpy(p + i, &t, 4);
+        }
+        break;
+    case 8:
+        for (; i < len; i += 8) {
+            uint64_t t;
+            std::memcpy(&t, p + i, 8);
+            t = bswap_64(t);
+            std::memcpy(p + i, &t, 8);
+        }
+        break;
+    }
+}
+
+}
+
+// Returns how many items of `width` bytes (at most `max`) are known to be
+// readable right away: the rest of the current window of an in-memory
+// stream, or the rest of a std::istream of a known size
+std::size_t kaitai::kstream::items_available(std::size_t width, std::size_t max) {
+    uint64_t avail;
+    if (m_io == NULL) {
+        avail = m_buf_len - m_buf_pos;
+    } else if (m_size_known) {
+        uint64_t p = pos();
+        avail = p < m_size ? m_size - p : 0;
+    } else {
+        return 0;
+    }
+    avail /= width;
+    return avail < max ? static_cast<std::size_t>(avail) : max;
+}
+
+// Reads a single item, just like read_u2be() & co. Returns false if it
+// failed in the ERRORS_STATUS mode, in which case the array ends with it.
+bool kaitai::kstream::read_item(char *buf, std::size_t width, bool swap) {
+    read_raw(buf, width);
+    if (swap)
+        bswap_items(buf, 1, width);
+    return m_error_mode != ERRORS_STATUS || m_status == STATUS_OK;
+}
+
+template <typename T>
+void kaitai::kstream::read_array(T *buf, std::size_t n, bool swap) {
+    align_to_byte();
+    while (n > 0) {
+        std::size_t k = items_available(sizeof(T), n);
+        if (k == 0) {
+            // The next item crosses a window boundary or the end of stream
+            if (!read_item(reinterpret_cast<char *>(buf), sizeof(T), swap))
+                return;
+            k = 1;
+        } else {
+            read_raw(reinterpret_cast<char *>(buf), k * sizeof(T));
+            if (swap)
+                bswap_items(reinterpret_cast<char *>(buf), k, sizeof(T));
+        }
+        buf += k;
+        n -= k;
+    }
+}
+
+template <typename T>
+void kaitai::kstream::read_array(std::vector<T> &vec, std::size_t n, bool swap) {
+    align_to_byte();
+    while (n > 0) {
+        std::size_t k = items_available(sizeof(T), n);
+        if (k == 0) {
+            T item;
+            bool ok = read_item(reinterpret_cast<char *>(&item), sizeof(T), swap);
+            vec.push_back(item);
+            if (!ok)
+                return;
+            n--;
+            continue;
+        }
+        std::size_t old_size = vec.size();
+        vec.resize(old_size + k);
+        read_raw(reinterpret_cast<char *>(&vec[old_size]), k * sizeof(T));
+        if (swap)
+            bswap_items(reinterpret_cast<char *>(&vec[old_size]), k, sizeof(T));
+        n -= k;
+    }
+}
+
+template <typename T>
+void kaitai::kstream::read_array_eos(std::vector<T> &vec, bool swap) {
+    while (!is_eof()) {
+        std::size_t k = items_available(sizeof(T), static_cast<std::size_t>(-1));
+        read_array(vec, k > 0 ? k : 1, swap);
+        if (m_error_mode == ERRORS_STATUS && m_status != STATUS_OK)
+            return;
+    }
+}
+
+#define KS_ARRAY_READERS(NAME, TYPE, SWAP) \
+    void kaitai::kstream::read_##NAME##_array(TYPE *buf, std::size_t n) { \
+        read_array(buf, n, SWAP); \
+    } \
+    void kaitai::kstream::read_##NAME##_array(std::vector<TYPE> &vec, std::size_t n) { \
+        read_array(vec, n, SWAP); \
+    } \
+    void kaitai::kstream::read_##NAME##_array_eos(std::vector<TYPE> &vec) { \
+        read_array_eos(vec, SWAP); \
+    }
+
+KS_ARRAY_READERS(s1, int8_t, false)
+KS_ARRAY_READERS(u1, uint8_t, false)
+
+KS_ARRAY_READERS(s2be, int16_t, SWAP_BE)
+KS_ARRAY_READERS(s4be, int32_t, SWAP_BE)
+KS_ARRAY_READERS(s8be, int64_t, SWAP_BE)
+KS_ARRAY_READERS(u2be, uint16_t, SWAP_BE)
+KS_ARRAY_READERS(u4be, uint32_t, SWAP_BE)
+KS_ARRAY_READERS(u8be, uint64_t, SWAP_BE)
+KS_ARRAY_READERS(f4be, float, SWAP_BE)
+KS_ARRAY_READERS(f8be, double, SWAP_BE)
+
+KS_ARRAY_READERS(s2le, int16_t, SWAP_LE)
+KS_ARRAY_READERS(s4le, int32_t, SWAP_LE)
+KS_ARRAY_READERS(s8le, int64_t, SWAP_LE)
+KS_ARRAY_READERS(u2le, uint16_t, SWAP_LE)
+KS_ARRAY_READERS(u4le, uint32_t, SWAP_LE)
+KS_ARRAY_READERS(u8le, uint64_t, SWAP_LE)
+KS_ARRAY_READERS(f4le, float, SWAP_LE)
+KS_ARRAY_READERS(f8le, double, SWAP_LE)
+
+#undef KS_ARRAY_READERS
+
 // ========================================================================
 // Unaligned bit values
 // ========================================================================
 
-void kaitai::kstream::align_to_byte() {
-    m_bits_left = 0;
-    m_bits = 0;
+// Drops the whole bytes read ahead into `m_bits`, keeping only the bits
+// left of the last byte consumed
+void kaitai::kstream::drop_bits_ahead() {
+    const int ahead = m_bits_left >> 3;
+    if (ahead == 0)
+        return;
+    m_bits_left &= 7;
+    if (m_bits_le) {
+        m_bits &= (static_cast<uint64_t>(1) << m_bits_left) - 1;
+    } else {
+        m_bits = ahead < 8 ? m_bits >> (ahead * 8) : 0;
+    }
 }
 
-uint64_t kaitai::kstream::read_bits_int_be(int n) {
+uint64_t kaitai::kstream::read_bits_int_be_slow(int n) {
+    if (!bits_ahead_usable(false))
+        drop_bits_ahead();
+    if (n >= 1 && n <= m_bits_left)
+        return take_bits_be(n);
+
+    // Refill the accumulator with the next whole bytes of a 64-bit word of
+    // the window, if it has one
+    if (n >= 1 && n <= 56 && m_io == NULL) {
+        const int ahead = m_bits_left >> 3;
+        if (m_buf_len - m_buf_pos >= static_cast<std::size_t>(ahead) + 8) {
+            const int refill_bytes = (64 - m_bits_left) >> 3;
+            const uint64_t word = load_u8be(reinterpret_cast<const unsigned char *>(m_buf + m_buf_pos + ahead));
+            m_bits = (refill_bytes < 8 ? m_bits << (refill_bytes * 8) : 0) | word >> (64 - refill_bytes * 8);
+            m_bits_left += refill_bytes * 8;
+            return take_bits_be(n);
+        }
+    }
+    drop_bits_ahead();
+
     uint64_t res = 0;
 
     int bits_needed = n - m_bits_left;
@@ -451,7 +1844,7 @@ uint64_t kaitai::kstream::read_bits_int_be(int n) {
         if (bytes_needed > 8)
             throw std::runtime_error("read_bits_int_be: more than 8 bytes requested");
         uint8_t buf[8];
-        read_exact(m_io, reinterpret_cast<char *>(buf), bytes_needed);
+        read_raw(reinterpret_cast<char *>(buf), bytes_needed);
         for (int i = 0; i < bytes_needed; i++) {
             res = res << 8 | buf[i];
         }
@@ -474,7 +1867,28 @@ uint64_t kaitai::kstream::read_bits_int(int n) {
     return read_bits_int_be(n);
 }
 
-uint64_t kaitai::kstream::read_bits_int_le(int n) {
+uint64_t kaitai::kstream::read_bits_int_le_slow(int n) {
+    if (!bits_ahead_usable(true))
+        drop_bits_ahead();
+    if (n >= 1 && n <= m_bits_left)
+        return take_bits_le(n);
+
+    // Same refill as in read_bits_int_be_slow(), with the bytes read ahead
+    // above the bits left instead of below them
+    if (n >= 1 && n <= 56 && m_io == NULL) {
+        const int ahead = m_bits_left >> 3;
+        if (m_buf_len - m_buf_pos >= static_cast<std::size_t>(ahead) + 8) {
+            const int refill_bytes = (64 - m_bits_left) >> 3;
+            uint64_t word = load_u8le(reinterpret_cast<const unsigned char *>(m_buf + m_buf_pos + ahead));
+            if (refill_bytes < 8)
+                word &= (static_cast<uint64_t>(1) << (refill_bytes * 8)) - 1;
+            m_bits |= word << m_bits_left;
+            m_bits_left += refill_bytes * 8;
+            return take_bits_le(n);
+        }
+    }
+    drop_bits_ahead();
+
     uint64_t res = 0;
     int bits_needed = n - m_bits_left;
 
@@ -486,7 +1900,7 @@ uint64_t kaitai::kstream::read_bits_int_le(int n) {
         if (bytes_needed > 8)
             throw std::runtime_error("read_bits_int_le: more than 8 bytes requested");
         uint8_t buf[8];
-        read_exact(m_io, reinterpret_cast<char *>(buf), bytes_needed);
+        read_raw(reinterpret_cast<char *>(buf), bytes_needed);
         for (int i = 0; i < bytes_needed; i++) {
             res |= static_cast<uint64_t>(buf[i]) << (i * 8);
         }
@@ -520,16 +1934,53 @@ uint64_t kaitai::kstream::read_bits_int_le(int n) {
 
 std::string kaitai::kstream::read_bytes(std::streamsize len) {
     align_to_byte();
-    std::vector<char> result(len);
 
     // NOTE: streamsize type is signed, negative values are only *supposed* to not be used.
     // https://en.cppreference.com/w/cpp/io/streamsize
     if (len < 0) {
+        if (m_error_mode == ERRORS_STATUS) {
+            set_error(STATUS_INVALID, pos());
+            return std::string();
+        }
         throw std::runtime_error("read_bytes: requested a negative amount");
     }
 
+    if (m_io == NULL) {
+        if (static_cast<uint64_t>(len) <= m_buf_len - m_buf_pos) {
+            std::string result(m_buf + m_buf_pos, static_cast<std::size_t>(len));
+            m_buf_pos += static_cast<std::size_t>(len);
+            return result;
+        }
+        if (m_src == NULL) {
+            eof_error(pos());
+            return std::string();
+        }
+
+        // Collect the data window by window rather than allocating `len`
+        // bytes upfront, as `len` may well be bogus
+        uint64_t pos_before_read = pos();
+        std::string result;
+        std::size_t left = static_cast<std::size_t>(len);
+        while (left > 0) {
+            if (m_buf_pos == m_buf_len && !refill()) {
+                seek(pos_before_read);
+                eof_error(pos_before_read);
+                return std::string();
+            }
+            std::size_t n = m_buf_len - m_buf_pos;
+            if (n > left)
+                n = left;
+            result.append(m_buf + m_buf_pos, n);
+            m_buf_pos += n;
+            left -= n;
+        }
+        return result;
+    }
+
+    std::vector<char> result(len);
+
     if (len > 0) {
-        read_exact(m_io, &result[0], len);
+        read_raw(&result[0], len);
     }
 
     return std::string(result.begin(), result.end());
@@ -537,6 +1988,16 @@ std::string kaitai::kstream::read_bytes(std::streamsize len) {
 
 std::string kaitai::kstream::read_bytes_full() {
     align_to_byte();
+    if (m_io == NULL) {
+        std::string result(m_buf + m_buf_pos, m_buf_len - m_buf_pos);
+        m_buf_pos = m_buf_len;
+        while (refill()) {
+            result.append(m_buf + m_buf_pos, m_buf_len - m_buf_pos);
+            m_buf_pos = m_buf_len;
+        }
+        return result;
+    }
+
     std::istream::pos_type p1 = m_io->tellg();
     m_io->seekg(0, std::istream::end);
     std::istream::pos_type p2 = m_io->tellg();
@@ -552,17 +2013,120 @@ std::string kaitai::kstream::read_bytes_full() {
     return result;
 }
 
+kaitai::bytes_view kaitai::kstream::read_bytes_view(std::streamsize len) {
+    align_to_byte();
+    if (m_io == NULL && len > 0) {
+        if (m_src == NULL) {
+            if (static_cast<uint64_t>(len) <= m_buf_len - m_buf_pos) {
+                bytes_view result(m_buf + m_buf_pos, static_cast<std::size_t>(len));
+                m_buf_pos += static_cast<std::size_t>(len);
+                return result;
+            }
+        } else {
+            uint64_t pos_before_read = pos();
+            const char *data = m_src->contiguous(pos_before_read, static_cast<uint64_t>(len));
+            if (data != NULL) {
+                seek(pos_before_read + static_cast<uint64_t>(len));
+                return bytes_view(data, static_cast<std::size_t>(len));
+            }
+        }
+    }
+    bool was_ok = ok();
+    std::string bytes = read_bytes(len);
+    return no_view(bytes, was_ok);
+}
+
+kaitai::bytes_view kaitai::kstream::read_bytes_full_view() {
+    align_to_byte();
+    if (m_io == NULL) {
+        if (m_src == NULL) {
+            bytes_view result(m_buf + m_buf_pos, m_buf_len - m_buf_pos);
+            m_buf_pos = m_buf_len;
+            return result;
+        }
+        // Only ask for the size if it's cheap (it may take decompressing
+        // the rest of the data or not be known at all)
+        uint64_t pos_before_read = pos();
+        if (m_size_known && pos_before_read <= m_size) {
+            uint64_t len = m_size - pos_before_read;
+            const char *data = m_src->contiguous(pos_before_read, len);
+            if (data != NULL) {
+                seek(m_size);
+                return bytes_view(data, static_cast<std::size_t>(len));
+            }
+        }
+    }
+    bool was_ok = ok();
+    std::string bytes = read_bytes_full();
+    return no_view(bytes, was_ok);
+}
+
+// Called with the bytes read by the regular methods when they couldn't be
+// viewed: fine if there are none or the read failed in the ERRORS_STATUS mode
+// (returning a dummy value), but keeping a copy for every view would hold on
+// to all bytes fields ever read from a streamed file
+kaitai::bytes_view kaitai::kstream::no_view(const std::string &bytes, bool was_ok) {
+    if (!bytes.empty() && !(was_ok && !ok()))
+        throw std::logic_error("read_bytes_view: the bytes are not contiguous in memory, so they can't be viewed");
+    return bytes_view();
+}
+
 std::string kaitai::kstream::read_bytes_term(char term, bool include, bool consume, bool eos_error) {
     align_to_byte();
+    if (m_io == NULL) {
+        uint64_t pos_before_read = pos();
+        std::string result;
+        while (true) {
+            // The window is empty (and `m_buf` possibly NULL) at the start
+            // of a buffered stream and at the end of data
+            const char *start = m_buf + m_buf_pos;
+            std::size_t avail = m_buf_len - m_buf_pos;
+            if (avail != 0) {
+                const char *found = static_cast<const char *>(std::memchr(start, term, avail));
+                if (found != NULL) {
+                    // encountered terminator
+                    std::size_t len = static_cast<std::size_t>(found - start);
+                    result.append(start, len + (include ? 1 : 0));
+                    m_buf_pos += len + (consume ? 1 : 0);
+                    return result;
+                }
+                result.append(start, avail);
+                m_buf_pos = m_buf_len;
+            }
+            if (!refill()) {
+                // encountered EOF
+                if (eos_error) {
+                    seek(pos_before_read);
+                    if (m_error_mode == ERRORS_STATUS) {
+                        set_error(STATUS_EOF, pos_before_read);
+                        return std::string();
+                    }
+                    throw std::runtime_error("read_bytes_term: encountered EOF");
+                }
+                return result;
+            }
+        }
+    }
+
+    uint64_t pos_before_read = pos();
     std::string result;
+    m_io->exceptions(std::istream::badbit);
     std::getline(*m_io, result, term);
     if (m_io->eof()) {
         // encountered EOF
+        m_io->clear();
+        exceptions_enable();
         if (eos_error) {
+            seek(pos_before_read);
+            if (m_error_mode == ERRORS_STATUS) {
+                set_error(STATUS_EOF, pos_before_read);
+                return std::string();
+            }
             throw std::runtime_error("read_bytes_term: encountered EOF");
         }
     } else {
         // encountered terminator
+        exceptions_enable();
         if (include)
             result.push_back(term);
         if (!consume)
@@ -571,6 +2135,44 @@ std::string kaitai::kstream::read_bytes_term(char term, bool include, bool consu
     return result;
 }
 
+namespace {
+
+// Returns the offset of the first occurrence of `term` in the first `len`
+// bytes at `p` that starts at a multiple of the terminator length, or `len`
+// if there is none. `term` must not be empty and `len` must be a multiple of
+// its length. With SSE2, 2- and 4-byte terminators (UTF-16 and UTF-32 NULs)
+// are checked 16 bytes at a time: a unit matches if all its bytes are equal.
+std::size_t find_term_unit(const char *p, std::size_t len, const std::string &term) {
+    std::size_t term_len = term.length();
+    std::size_t i = 0;
+#if defined(KS_SIMD_SSE2)
+    if (term_len == 2 || term_len == 4) {
+        char pattern_bytes[16];
+        for (std::size_t k = 0; k < 16; k++)
+            pattern_bytes[k] = term[k % term_len];
+        __m128i pattern = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern_bytes));
+        int unit_starts = term_len == 2 ? 0x5555 : 0x1111;
+        for (; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+            int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+            int match = eq & (eq >> 1);
+            if (term_len == 4)
+                match &= match >> 2;
+            if ((match & unit_starts) != 0)
+                break;
+        }
+    }
+#endif
+    const char *t = term.data();
+    for (; i < len; i += term_len) {
+        if (p[i] == t[0] && std::memcmp(p + i + 1, t + 1, term_len - 1) == 0)
+            return i;
+    }
+    return len;
+}
+
+} // namespace
+
 std::string kaitai::kstream::read_bytes_term_multi(std::string term, bool include, bool consume, bool eos_error) {
     align_to_byte();
     std::size_t term_len = term.length();
@@ -578,7 +2180,57 @@ std::string kaitai::kstream::read_bytes_term_multi(std::string term, bool includ
         throw std::runtime_error("read_bytes_term_multi: terminator too long");
     }
     std::streamsize unit_size = static_cast<std::streamsize>(term_len);
+    if (term_len == 0) {
+        return std::string();
+    }
+
+    if (m_io == NULL) {
+        uint64_t pos_before_read = pos();
+        std::string result;
+        std::string c(term_len, ' ');
+        while (true) {
+            // Whole units within the current window
+            const char *start = m_buf + m_buf_pos;
+            std::size_t avail = m_buf_len - m_buf_pos;
+            std::size_t units_len = avail - avail % term_len;
+            std::size_t len = find_term_unit(start, units_len, term);
+            if (len < units_len) {
+                result.append(start, len + (include ? term_len : 0));
+                m_buf_pos += len + (consume ? term_len : 0);
+                return result;
+            }
+            if (units_len != 0) {
+                result.append(start, units_len);
+                m_buf_pos += units_len;
+            }
+
+            // A unit crossing the end of the window (or the end of stream)
+            std::size_t n = read_partial(&c[0], term_len);
+            if (n < term_len) {
+                // encountered EOF
+                if (eos_error) {
+                    seek(pos_before_read);
+                    if (m_error_mode == ERRORS_STATUS) {
+                        set_error(STATUS_EOF, pos_before_read);
+                        return std::string();
+                    }
+                    throw std::runtime_error("read_bytes_term_multi: encountered EOF");
+                }
+                result.append(c, 0, n);
+                return result;
+            }
+            if (c == term) {
+                if (include)
+                    result += c;
+                if (!consume)
+                    seek(pos() - term_len);
+                return result;
+            }
+            result += c;
+        }
+    }
 
+    uint64_t pos_before_read = pos();
     std::string result;
     std::string c(term_len, ' ');
     m_io->exceptions(std::istream::badbit);
@@ -591,6 +2243,11 @@ std::string kaitai::kstream::read_bytes_term_multi(std::string term, bool includ
             m_io->clear();
             exceptions_enable();
             if (eos_error) {
+                seek(pos_before_read);
+                if (m_error_mode == ERRORS_STATUS) {
+                    set_error(STATUS_EOF, pos_before_read);
+                    return std::string();
+                }
                 throw std::runtime_error("read_bytes_term_multi: encountered EOF");
             }
             result.append(c, 0, static_cast<std::size_t>(m_io->gcount()));
@@ -612,9 +2269,16 @@ std::string kaitai::kstream::read_bytes_term_multi(std::string term, bool includ
 }
 
 std::string kaitai::kstream::ensure_fixed_contents(std::string expected) {
+    uint64_t pos_before_read = pos();
     std::string actual = read_bytes(expected.length());
 
     if (actual != expected) {
+        if (m_error_mode == ERRORS_STATUS) {
+            // A short read has already recorded STATUS_EOF, which is kept
+            seek(pos_before_read);
+            set_error(STATUS_INVALID, pos_before_read);
+            return std::string();
+        }
         // NOTE: I think printing it outright is not best idea, it could contain non-ASCII characters
         // like backspace and beeps and whatnot. It would be better to print hexlified version, and
         // also to redirect it to stderr.
@@ -630,84 +2294,316 @@ std::string kaitai::kstream::bytes_strip_right(std::string src, char pad_byte) {
     while (new_len > 0 && src[new_len - 1] == pad_byte)
         new_len--;
 
-    return src.substr(0, new_len);
+    return src.substr(0, new_len);
+}
+
+std::string kaitai::kstream::bytes_terminate(std::string src, char term, bool include) {
+    // memchr() is vectorized by every major libc, so it beats a byte loop
+    // even on short strings
+    const char *found = static_cast<const char *>(std::memchr(src.data(), term, src.length()));
+    if (found != NULL) {
+        src.resize(static_cast<std::size_t>(found - src.data()) + (include ? 1 : 0));
+    }
+    return src;
+}
+
+std::string kaitai::kstream::bytes_terminate_multi(std::string src, std::string term, bool include) {
+    std::size_t unit_size = term.length();
+    if (unit_size == 0) {
+        return std::string();
+    }
+    std::size_t units_len = src.length() - src.length() % unit_size;
+    std::size_t len = find_term_unit(src.data(), units_len, term);
+    if (len < units_len) {
+        src.resize(len + (include ? unit_size : 0));
+    }
+    return src;
+}
+
+// ========================================================================
+// Byte array processing
+// ========================================================================
+
+namespace {
+
+// Kernels for process_xor_*() and process_rotate_left(). Each one works on
+// whole vectors from the start of the buffer and returns how many bytes it has
+// processed; the caller finishes the tail byte by byte. For XOR, `ext` is the
+// key repeated to `key_len + 64` bytes, so that a vector of key bytes starting
+// at any key offset can be loaded directly. Rotations are done with 16-bit
+// shifts, masking out the bits that cross into the neighbouring byte.
+
+#if defined(KS_SIMD_SSE2)
+std::size_t xor_sse2(char *p, std::size_t len, const char *ext, std::size_t key_len) {
+    std::size_t step = 16 % key_len;
+    std::size_t ki = 0;
+    std::size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ext + ki));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), _mm_xor_si128(v, k));
+        ki += step;
+        if (ki >= key_len)
+            ki -= key_len;
+    }
+    return i;
+}
+
+std::size_t rotate_sse2(char *p, std::size_t len, int amount) {
+    __m128i left = _mm_cvtsi32_si128(amount);
+    __m128i right = _mm_cvtsi32_si128(8 - amount);
+    __m128i left_mask = _mm_set1_epi8(static_cast<char>(0xff << amount));
+    __m128i right_mask = _mm_set1_epi8(static_cast<char>(0xff >> (8 - amount)));
+    std::size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        v = _mm_or_si128(
+            _mm_and_si128(_mm_sll_epi16(v, left), left_mask),
+            _mm_and_si128(_mm_srl_epi16(v, right), right_mask)
+        );
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), v);
+    }
+    return i;
+}
+#elif defined(KS_SIMD_NEON)
+std::size_t xor_neon(char *p, std::size_t len, const char *ext, std::size_t key_len) {
+    std::size_t step = 16 % key_len;
+    std::size_t ki = 0;
+    std::size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p + i));
+        uint8x16_t k = vld1q_u8(reinterpret_cast<const uint8_t *>(ext + ki));
+        vst1q_u8(reinterpret_cast<uint8_t *>(p + i), veorq_u8(v, k));
+        ki += step;
+        if (ki >= key_len)
+            ki -= key_len;
+    }
+    return i;
+}
+
+std::size_t rotate_neon(char *p, std::size_t len, int amount) {
+    // vshlq_u8() shifts right by negative amounts
+    int8x16_t left = vdupq_n_s8(static_cast<int8_t>(amount));
+    int8x16_t right = vdupq_n_s8(static_cast<int8_t>(amount - 8));
+    std::size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p + i));
+        v = vorrq_u8(vshlq_u8(v, left), vshlq_u8(v, right));
+        vst1q_u8(reinterpret_cast<uint8_t *>(p + i), v);
+    }
+    return i;
+}
+#endif
+
+#if defined(KS_SIMD_X86_DISPATCH)
+__attribute__((target("avx2")))
+std::size_t xor_avx2(char *p, std::size_t len, const char *ext, std::size_t key_len) {
+    std::size_t step = 32 % key_len;
+    std::size_t ki = 0;
+    std::size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ext + ki));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + i), _mm256_xor_si256(v, k));
+        ki += step;
+        if (ki >= key_len)
+            ki -= key_len;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+std::size_t rotate_avx2(char *p, std::size_t len, int amount) {
+    __m128i left = _mm_cvtsi32_si128(amount);
+    __m128i right = _mm_cvtsi32_si128(8 - amount);
+    __m256i left_mask = _mm256_set1_epi8(static_cast<char>(0xff << amount));
+    __m256i right_mask = _mm256_set1_epi8(static_cast<char>(0xff >> (8 - amount)));
+    std::size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        v = _mm256_or_si256(
+            _mm256_and_si256(_mm256_sll_epi16(v, left), left_mask),
+            _mm256_and_si256(_mm256_srl_epi16(v, right), right_mask)
+        );
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p + i), v);
+    }
+    return i;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+std::size_t xor_avx512(char *p, std::size_t len, const char *ext, std::size_t key_len) {
+    std::size_t step = 64 % key_len;
+    std::size_t ki = 0;
+    std::size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_loadu_si512(p + i);
+        __m512i k = _mm512_loadu_si512(ext + ki);
+        _mm512_storeu_si512(p + i, _mm512_xor_si512(v, k));
+        ki += step;
+        if (ki >= key_len)
+            ki -= key_len;
+    }
+    return i;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+std::size_t rotate_avx512(char *p, std::size_t len, int amount) {
+    __m128i left = _mm_cvtsi32_si128(amount);
+    __m128i right = _mm_cvtsi32_si128(8 - amount);
+    __m512i left_mask = _mm512_set1_epi8(static_cast<char>(0xff << amount));
+    __m512i right_mask = _mm512_set1_epi8(static_cast<char>(0xff >> (8 - amount)));
+    std::size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i v = _mm512_loadu_si512(p + i);
+        v = _mm512_or_si512(
+            _mm512_and_si512(_mm512_sll_epi16(v, left), left_mask),
+            _mm512_and_si512(_mm512_srl_epi16(v, right), right_mask)
+        );
+        _mm512_storeu_si512(p + i, v);
+    }
+    return i;
+}
+#endif
+
+// Picks the widest kernel the CPU supports. AVX2 and AVX-512 are only probed
+// at runtime, so the library itself can still be built for baseline x86.
+std::size_t xor_vectors(char *p, std::size_t len, const char *ext, std::size_t key_len) {
+#if defined(KS_SIMD_X86_DISPATCH)
+    if (__builtin_cpu_supports("avx512bw"))
+        return xor_avx512(p, len, ext, key_len);
+    if (__builtin_cpu_supports("avx2"))
+        return xor_avx2(p, len, ext, key_len);
+#endif
+#if defined(KS_SIMD_SSE2)
+    return xor_sse2(p, len, ext, key_len);
+#elif defined(KS_SIMD_NEON)
+    return xor_neon(p, len, ext, key_len);
+#else
+    (void) p;
+    (void) len;
+    (void) ext;
+    (void) key_len;
+    return 0;
+#endif
+}
+
+std::size_t rotate_vectors(char *p, std::size_t len, int amount) {
+#if defined(KS_SIMD_X86_DISPATCH)
+    if (__builtin_cpu_supports("avx512bw"))
+        return rotate_avx512(p, len, amount);
+    if (__builtin_cpu_supports("avx2"))
+        return rotate_avx2(p, len, amount);
+#endif
+#if defined(KS_SIMD_SSE2)
+    return rotate_sse2(p, len, amount);
+#elif defined(KS_SIMD_NEON)
+    return rotate_neon(p, len, amount);
+#else
+    (void) p;
+    (void) len;
+    (void) amount;
+    return 0;
+#endif
 }
 
-std::string kaitai::kstream::bytes_terminate(std::string src, char term, bool include) {
-    std::size_t new_len = 0;
-    std::size_t max_len = src.length();
+} // namespace
 
-    while (new_len < max_len && src[new_len] != term)
-        new_len++;
+void kaitai::kstream::process_xor_one_in_place(char *data, std::size_t len, uint8_t key) {
+    char k = static_cast<char>(key);
+    process_xor_many_in_place(data, len, &k, 1);
+}
 
-    if (include && new_len < max_len)
-        new_len++;
+void kaitai::kstream::process_xor_many_in_place(char *data, std::size_t len, const char *key, std::size_t key_len) {
+    if (key_len == 0)
+        return;
 
-    return src.substr(0, new_len);
+    std::size_t done = 0;
+    if (len >= 16) {
+        std::size_t ext_len = key_len + 64;
+        char small_ext[256];
+        std::string big_ext;
+        char *ext = small_ext;
+        if (ext_len > sizeof(small_ext)) {
+            big_ext.resize(ext_len);
+            ext = &big_ext[0];
+        }
+        for (std::size_t i = 0; i < ext_len; i++)
+            ext[i] = key[i % key_len];
+        done = xor_vectors(data, len, ext, key_len);
+    }
+
+    std::size_t ki = done % key_len;
+    for (std::size_t i = done; i < len; i++) {
+        data[i] ^= key[ki];
+        ki++;
+        if (ki == key_len)
+            ki = 0;
+    }
 }
 
-std::string kaitai::kstream::bytes_terminate_multi(std::string src, std::string term, bool include) {
-    std::size_t unit_size = term.length();
-    if (unit_size == 0) {
-        return std::string();
+void kaitai::kstream::process_rotate_left_in_place(char *data, std::size_t len, int amount, int group_size) {
+    if (group_size < 1) {
+        throw std::invalid_argument("process_rotate_left: group size must be positive");
     }
-    std::size_t len = src.length();
-    std::size_t i_term = 0;
-    for (std::size_t i_src = 0; i_src < len;) {
-        if (src[i_src] != term[i_term]) {
-            i_src += unit_size - i_term;
-            i_term = 0;
-            continue;
+    std::size_t group_len = static_cast<std::size_t>(group_size);
+    if (len % group_len != 0) {
+        throw std::invalid_argument("process_rotate_left: data length is not a multiple of group size");
+    }
+    int group_bits = group_size * 8;
+    amount %= group_bits;
+    if (amount < 0)
+        amount += group_bits;
+    if (amount == 0)
+        return;
+
+    if (group_size == 1) {
+        std::size_t done = rotate_vectors(data, len, amount);
+        for (std::size_t i = done; i < len; i++) {
+            uint8_t bits = data[i];
+            data[i] = static_cast<char>((bits << amount) | (bits >> (8 - amount)));
         }
-        i_src++;
-        i_term++;
-        if (i_term == unit_size) {
-            return src.substr(0, i_src - (include ? 0 : unit_size));
+        return;
+    }
+
+    // Every group is a big-endian integer: rotating it by whole bytes moves
+    // bytes to the left, then each byte takes in the top bits of the next one
+    std::size_t byte_shift = static_cast<std::size_t>(amount / 8);
+    int bit_shift = amount % 8;
+    std::string group(group_len, '\0');
+    for (std::size_t pos = 0; pos < len; pos += group_len) {
+        char *p = data + pos;
+        std::memcpy(&group[0], p, group_len);
+        for (std::size_t j = 0; j < group_len; j++) {
+            uint8_t hi = group[(j + byte_shift) % group_len];
+            if (bit_shift == 0) {
+                p[j] = static_cast<char>(hi);
+            } else {
+                uint8_t lo = group[(j + byte_shift + 1) % group_len];
+                p[j] = static_cast<char>((hi << bit_shift) | (lo >> (8 - bit_shift)));
+            }
         }
     }
-    return src;
 }
 
-// ========================================================================
-// Byte array processing
-// ========================================================================
-
 std::string kaitai::kstream::process_xor_one(std::string data, uint8_t key) {
-    std::size_t len = data.length();
-    std::string result(len, ' ');
-
-    for (std::size_t i = 0; i < len; i++)
-        result[i] = data[i] ^ key;
-
-    return result;
+    if (!data.empty())
+        process_xor_one_in_place(&data[0], data.length(), key);
+    return data;
 }
 
 std::string kaitai::kstream::process_xor_many(std::string data, std::string key) {
-    std::size_t len = data.length();
-    std::size_t kl = key.length();
-    std::string result(len, ' ');
-
-    std::size_t ki = 0;
-    for (std::size_t i = 0; i < len; i++) {
-        result[i] = data[i] ^ key[ki];
-        ki++;
-        if (ki >= kl)
-            ki = 0;
-    }
-
-    return result;
+    if (!data.empty())
+        process_xor_many_in_place(&data[0], data.length(), key.data(), key.length());
+    return data;
 }
 
-std::string kaitai::kstream::process_rotate_left(std::string data, int amount) {
-    std::size_t len = data.length();
-    std::string result(len, ' ');
-
-    for (std::size_t i = 0; i < len; i++) {
-        uint8_t bits = data[i];
-        result[i] = (bits << amount) | (bits >> (8 - amount));
+std::string kaitai::kstream::process_rotate_left(std::string data, int amount, int group_size) {
+    if (!data.empty()) {
+        process_rotate_left_in_place(&data[0], data.length(), amount, group_size);
+    } else if (group_size < 1) {
+        throw std::invalid_argument("process_rotate_left: group size must be positive");
     }
-
-    return result;
+    return data;
 }
 
 #ifdef KS_ZLIB
@@ -721,117 +2617,349 @@ std::string kaitai::kstream::process_rotate_left(std::string data, int amount) {
 //
 // IWYU pragma: no_include <zconf.h>
 
-std::string kaitai::kstream::process_zlib(std::string data) {
-    unsigned char *src_ptr = reinterpret_cast<unsigned char *>(&data[0]);
-
-    z_stream strm;
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = 0;
-    strm.next_in = Z_NULL;
-
-    // See https://www.zlib.net/manual.html#:~:text=ZEXTERN%20int%20ZEXPORT-,inflateInit,-(z_streamp%20strm)%3B
-    int ret = inflateInit(&strm);
-    if (ret != Z_OK) {
-        std::string msg;
-        switch (ret) {
-            case Z_MEM_ERROR:
-                msg = "out of memory";
-                break;
-            case Z_VERSION_ERROR:
-                msg = "zlib version mismatch";
-                break;
-            case Z_STREAM_ERROR:
-                msg = "inconsistent stream state";
-                break;
-            default:
-                msg = "unknown error (return value: " + to_string(ret) + ")";
-                break;
+namespace {
+
+std::string inflate_init_error_msg(int ret) {
+    switch (ret) {
+        case Z_MEM_ERROR:
+            return "out of memory";
+        case Z_VERSION_ERROR:
+            return "zlib version mismatch";
+        case Z_STREAM_ERROR:
+            return "inconsistent stream state";
+        default:
+            return "unknown error (return value: " + kaitai::kstream::to_string(ret) + ")";
+    }
+}
+
+std::string inflate_error_msg(int ret, const z_stream &strm) {
+    switch (ret) {
+        // The note at https://www.zlib.net/zlib_how.html applies here as well:
+        // > For this routine, we have no idea what the dictionary is, so the
+        // > `Z_NEED_DICT` indication is converted to a `Z_DATA_ERROR`.
+        case Z_NEED_DICT:
+            return "preset dictionary needed";
+        case Z_DATA_ERROR:
+            if (strm.msg) {
+                return strm.msg;
+            } else {
+                // After looking at the [zlib source
+                // code](https://github.com/madler/zlib/blob/5a82f71ed1dfc0bec044d9702463dbdf84ea3b71/inflate.c#L590),
+                // it seems that this never happens (if `inflate()` returns
+                // `Z_DATA_ERROR`, it always sets a meaningful message to
+                // `strm->msg`), but let's handle it anyway.
+                return "invalid input data";
+            }
+        case Z_STREAM_ERROR:
+            return "inconsistent stream state";
+        case Z_MEM_ERROR:
+            return "out of memory";
+        case Z_BUF_ERROR:
+            return "incomplete or truncated input data";
+        default:
+            return "unknown error (return value: " + kaitai::kstream::to_string(ret) + ")";
+    }
+}
+
+}
+
+namespace {
+
+// `windowBits` values selecting the container around the deflate data, see
+// https://www.zlib.net/manual.html#:~:text=ZEXTERN%20int%20ZEXPORT-,inflateInit2,-(z_streamp%20strm%2C
+const int WINDOW_BITS_ZLIB = 15;
+const int WINDOW_BITS_DEFLATE = -15;
+const int WINDOW_BITS_GZIP = 16 + 15;
+
+// Deflate cannot compress better than about 1032:1, so a size hint larger
+// than that is not trusted when preallocating the output
+const uint64_t MAX_DEFLATE_RATIO = 1032;
+
+// Without a size hint, data is unpacked into a scratch buffer kept with the
+// inflate state and copied out once. A buffer grown beyond the limit by a
+// large input is released afterwards rather than kept around.
+const std::size_t INFLATE_SCRATCH_SIZE = 64 * 1024;
+const std::size_t INFLATE_SCRATCH_KEEP_LIMIT = 1024 * 1024;
+
+/**
+ * Inflate state kept for reuse: setting up a z_stream allocates about 7 KiB
+ * of state and a 32 KiB window, which dominates the cost of unpacking small
+ * records. With C++11, every thread keeps one and resets it between calls.
+ */
+class inflater {
+public:
+    inflater() : m_ready(false) {
+        m_strm.zalloc = Z_NULL;
+        m_strm.zfree = Z_NULL;
+        m_strm.opaque = Z_NULL;
+        m_strm.avail_in = 0;
+        m_strm.next_in = Z_NULL;
+    }
+
+    ~inflater() {
+        if (m_ready)
+            inflateEnd(&m_strm);
+    }
+
+    z_stream &start(int window_bits, const char *func_name) {
+        int ret;
+        if (m_ready) {
+            // See https://www.zlib.net/manual.html#:~:text=ZEXTERN%20int%20ZEXPORT-,inflateReset2,-(z_streamp%20strm%2C
+            ret = inflateReset2(&m_strm, window_bits);
+        } else {
+            ret = inflateInit2(&m_strm, window_bits);
+            m_ready = (ret == Z_OK);
         }
-        throw std::runtime_error("process_zlib: inflateInit() failed: " + msg);
+        if (ret != Z_OK) {
+            throw std::runtime_error(std::string(func_name) + ": inflateInit() failed: " + inflate_init_error_msg(ret));
+        }
+        return m_strm;
+    }
+
+    std::string &scratch() {
+        return m_scratch;
     }
 
-    strm.next_in = src_ptr;
+private:
+    z_stream m_strm;
+    bool m_ready;
+    std::string m_scratch;
+
+    inflater(const inflater&);
+    inflater& operator=(const inflater&);
+};
+
+std::string inflate_data(std::string &data, int window_bits, uint64_t size_hint, const char *func_name) {
     if (data.length() > std::numeric_limits<uInt>::max()) {
-        inflateEnd(&strm); // avoid a memory leak
         throw std::length_error(
-            "process_zlib: input is " + to_string(data.length()) + " bytes long, which exceeds"
-                " the maximum supported length of " + to_string(std::numeric_limits<uInt>::max()) + " bytes"
+            std::string(func_name) + ": input is " + kaitai::kstream::to_string(data.length()) + " bytes long, which exceeds"
+                " the maximum supported length of " + kaitai::kstream::to_string(std::numeric_limits<uInt>::max()) + " bytes"
         );
     }
+
+#ifdef KAITAI_STREAM_H_CPP11_SUPPORT
+    static thread_local inflater inf;
+#else
+    inflater inf;
+#endif
+    z_stream &strm = inf.start(window_bits, func_name);
+
+    strm.next_in = reinterpret_cast<Bytef *>(data.empty() ? NULL : &data[0]);
     strm.avail_in = static_cast<uInt>(data.length());
 
-    unsigned char outbuffer[ZLIB_BUF_SIZE];
-    std::string outstring;
+    // With a size hint, unpack straight into the result; either way, the
+    // buffer is doubled whenever it fills up
+    std::string result;
+    std::string &out = size_hint > 0 ? result : inf.scratch();
+    if (size_hint > 0) {
+        uint64_t max_expected = static_cast<uint64_t>(data.length()) * MAX_DEFLATE_RATIO + 64;
+        out.resize(static_cast<std::size_t>(std::min(size_hint, max_expected)));
+    } else if (out.size() < INFLATE_SCRATCH_SIZE) {
+        out.resize(INFLATE_SCRATCH_SIZE);
+    }
+    std::size_t done = 0;
 
-    // get the decompressed bytes blockwise using repeated calls to inflate
+    int ret;
     do {
-        strm.next_out = reinterpret_cast<Bytef *>(outbuffer);
-        strm.avail_out = sizeof(outbuffer);
+        if (done == out.size())
+            out.resize(out.size() * 2);
+        std::size_t avail = std::min<std::size_t>(out.size() - done, std::numeric_limits<uInt>::max());
+        strm.next_out = reinterpret_cast<Bytef *>(&out[done]);
+        strm.avail_out = static_cast<uInt>(avail);
 
         // See https://www.zlib.net/manual.html#:~:text=ZEXTERN%20int%20ZEXPORT-,inflate,-(z_streamp%20strm%2C%20int%20flush)%3B
         ret = inflate(&strm, Z_NO_FLUSH);
-
-        if (outstring.size() < strm.total_out) {
-            outstring.append(reinterpret_cast<char *>(outbuffer), strm.total_out - outstring.size());
-        }
+        done += avail - strm.avail_out;
     } while (ret == Z_OK);
 
     if (ret != Z_STREAM_END) { // an error occurred that was not EOF
-        std::string msg;
-        switch (ret) {
-            // The note at https://www.zlib.net/zlib_how.html applies here as well:
-            // > For this routine, we have no idea what the dictionary is, so the
-            // > `Z_NEED_DICT` indication is converted to a `Z_DATA_ERROR`.
-            case Z_NEED_DICT:
-                msg = "preset dictionary needed";
-                break;
-            case Z_DATA_ERROR:
-                if (strm.msg) {
-                    msg = strm.msg;
-                } else {
-                    // After looking at the [zlib source
-                    // code](https://github.com/madler/zlib/blob/5a82f71ed1dfc0bec044d9702463dbdf84ea3b71/inflate.c#L590),
-                    // it seems that this never happens (if `inflate()` returns
-                    // `Z_DATA_ERROR`, it always sets a meaningful message to
-                    // `strm->msg`), but let's handle it anyway.
-                    msg = "invalid input data";
-                }
-                break;
-            case Z_STREAM_ERROR:
-                msg = "inconsistent stream state";
-                break;
-            case Z_MEM_ERROR:
-                msg = "out of memory";
-                break;
-            case Z_BUF_ERROR:
-                msg = "incomplete or truncated input data";
-                break;
-            default:
-                msg = "unknown error (return value: " + to_string(ret) + ")";
-                break;
+        throw std::runtime_error(std::string(func_name) + ": inflate() failed: " + inflate_error_msg(ret, strm));
+    }
+
+    if (size_hint > 0) {
+        result.resize(done);
+    } else {
+        result.assign(out, 0, done);
+        if (out.size() > INFLATE_SCRATCH_KEEP_LIMIT)
+            std::string().swap(out);
+    }
+    return result;
+}
+
+}
+
+std::string kaitai::kstream::process_zlib(std::string data, uint64_t size_hint) {
+    return inflate_data(data, WINDOW_BITS_ZLIB, size_hint, "process_zlib");
+}
+
+std::string kaitai::kstream::process_deflate(std::string data, uint64_t size_hint) {
+    return inflate_data(data, WINDOW_BITS_DEFLATE, size_hint, "process_deflate");
+}
+
+std::string kaitai::kstream::process_gzip(std::string data, uint64_t size_hint) {
+    return inflate_data(data, WINDOW_BITS_GZIP, size_hint, "process_gzip");
+}
+
+namespace {
+
+/**
+ * Inflates zlib-compressed data as it is read. Seeking back beyond the
+ * rewind window restarts inflation from the beginning.
+ */
+class inflate_source : public forward_source {
+public:
+    inflate_source(std::string &data) :
+        forward_source(kaitai::kstream::DEFAULT_BUFFER_SIZE, kaitai::kstream::DEFAULT_BUFFER_SIZE),
+        m_in_pos(0), m_finished(false), m_size_known(false), m_size(0) {
+        m_in.swap(data);
+
+        m_strm.zalloc = Z_NULL;
+        m_strm.zfree = Z_NULL;
+        m_strm.opaque = Z_NULL;
+        m_strm.avail_in = 0;
+        m_strm.next_in = Z_NULL;
+        int ret = inflateInit(&m_strm);
+        if (ret != Z_OK)
+            throw std::runtime_error("from_zlib: inflateInit() failed: " + inflate_init_error_msg(ret));
+    }
+
+    ~inflate_source() {
+        inflateEnd(&m_strm);
+    }
+
+    uint64_t size() {
+        if (m_size_known)
+            return m_size;
+
+        // Inflate the rest of the data in a copy of the inflation state just
+        // to count it, so that the reading position is not disturbed
+        z_stream strm;
+        int ret = inflateCopy(&strm, &m_strm);
+        if (ret != Z_OK)
+            throw std::runtime_error("from_zlib: inflateCopy() failed: " + inflate_init_error_msg(ret));
+        std::size_t in_pos = m_in_pos;
+        bool finished = m_finished;
+        uint64_t len = produced();
+        std::vector<char> scratch(kaitai::kstream::DEFAULT_BUFFER_SIZE);
+        try {
+            while (!finished)
+                len += inflate_some(strm, in_pos, &scratch[0], scratch.size(), finished);
+        } catch (...) {
+            inflateEnd(&strm);
+            throw;
         }
-        inflateEnd(&strm); // avoid a memory leak
-        throw std::runtime_error("process_zlib: inflate() failed: " + msg);
+        inflateEnd(&strm);
+
+        m_size = len;
+        m_size_known = true;
+        return m_size;
     }
 
-    // See https://www.zlib.net/manual.html#:~:text=ZEXTERN%20int%20ZEXPORT-,inflateEnd,-(z_streamp%20strm)%3B
-    ret = inflateEnd(&strm);
-    if (ret != Z_OK) {
-        std::string msg;
-        if (ret == Z_STREAM_ERROR) {
-            msg = "inconsistent stream state";
-        } else {
-            msg = "unknown error (return value: " + to_string(ret) + ")";
+protected:
+    std::size_t produce(char *buf, std::size_t len) {
+        return inflate_some(m_strm, m_in_pos, buf, len, m_finished);
+    }
+
+    bool restart() {
+        int ret = inflateReset(&m_strm);
+        if (ret != Z_OK)
+            throw std::runtime_error("from_zlib: inflateReset() failed: " + inflate_init_error_msg(ret));
+        m_strm.avail_in = 0;
+        m_in_pos = 0;
+        m_finished = false;
+        return true;
+    }
+
+private:
+    /**
+     * Inflates data into `buf` until it is full, the compressed data ends or
+     * an error occurs (which is only thrown if nothing was inflated).
+     * \param in_pos position in `m_in` where the data not yet passed to
+     *   `strm` starts
+     * \param finished set to true once the compressed data ends
+     */
+    std::size_t inflate_some(z_stream &strm, std::size_t &in_pos, char *buf, std::size_t len, bool &finished) {
+        if (finished)
+            return 0;
+        strm.next_out = reinterpret_cast<Bytef *>(buf);
+        strm.avail_out = static_cast<uInt>(len);
+        while (strm.avail_out > 0) {
+            if (strm.avail_in == 0 && in_pos < m_in.length()) {
+                std::size_t chunk = std::min<std::size_t>(m_in.length() - in_pos, std::numeric_limits<uInt>::max());
+                strm.next_in = reinterpret_cast<Bytef *>(&m_in[in_pos]);
+                strm.avail_in = static_cast<uInt>(chunk);
+                in_pos += chunk;
+            }
+            // See https://www.zlib.net/manual.html#:~:text=ZEXTERN%20int%20ZEXPORT-,inflate,-(z_streamp%20strm%2C%20int%20flush)%3B
+            int ret = inflate(&strm, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                finished = true;
+                break;
+            }
+            if (ret != Z_OK) {
+                // Let the data before the error be read first, the next call
+                // will fail again
+                if (strm.avail_out < len)
+                    break;
+                throw std::runtime_error("from_zlib: inflate() failed: " + inflate_error_msg(ret, strm));
+            }
         }
-        throw std::runtime_error("process_zlib: inflateEnd() failed: " + msg);
+        return len - strm.avail_out;
     }
 
-    return outstring;
+    // Compressed data
+    std::string m_in;
+    std::size_t m_in_pos;
+    z_stream m_strm;
+    bool m_finished;
+
+    bool m_size_known;
+    uint64_t m_size;
+};
+
+}
+
+kaitai::kstream *kaitai::kstream::from_zlib(std::string data) {
+    return new kstream(new inflate_source(data));
 }
 #endif
 
+// ========================================================================
+// Byte views
+// ========================================================================
+
+char kaitai::bytes_view::at(std::size_t i) const {
+    if (i >= m_size)
+        throw std::out_of_range("bytes_view::at: index out of range");
+    return m_data[i];
+}
+
+int kaitai::bytes_view::compare(const bytes_view &other) const {
+    std::size_t common = m_size < other.m_size ? m_size : other.m_size;
+    if (common > 0) {
+        int res = std::memcmp(m_data, other.m_data, common);
+        if (res != 0)
+            return res;
+    }
+    if (m_size == other.m_size)
+        return 0;
+    return m_size < other.m_size ? -1 : 1;
+}
+
+// ========================================================================
+// Lazily decoded strings
+// ========================================================================
+
+const std::string &kaitai::lazy_str::get() const {
+    if (!m_decoded) {
+        // If decoding fails, the bytes are kept and the next call throws again
+        m_str = kstream::bytes_to_str(m_raw, m_encoding);
+        m_decoded = true;
+        std::string().swap(m_raw);
+    }
+    return m_str;
+}
+
 // ========================================================================
 // Misc utility methods
 // ========================================================================
@@ -973,26 +3101,387 @@ uint8_t kaitai::kstream::byte_array_max(const std::string val) {
 #define KS_STR_DEFAULT_ENCODING "UTF-8"
 #endif
 
+#ifndef KS_STR_ENCODING_NONE
+namespace {
+
+// The built-in decoders produce UTF-8, so they can only stand in for the
+// backend when that is what strings are converted to
+bool builtin_decoders_usable() {
+    return std::strcmp(KS_STR_DEFAULT_ENCODING, "UTF-8") == 0;
+}
+
+// Errors are named as iconv names them, so that the message does not depend
+// on which of the two did the conversion
+void throw_illegal_seq() {
+    throw kaitai::illegal_seq_in_encoding("EILSEQ");
+}
+
+void throw_incomplete_seq() {
+    throw kaitai::illegal_seq_in_encoding("EINVAL");
+}
+
+// Returns the length of the leading run of bytes below 0x80 in the first
+// `len` bytes at `p`. With SSE2, 16 bytes are checked at a time by their
+// top bits.
+std::size_t ascii_prefix_len(const char *p, std::size_t len) {
+    std::size_t i = 0;
+#if defined(KS_SIMD_SSE2)
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        if (_mm_movemask_epi8(v) != 0)
+            break;
+    }
+#endif
+    while (i < len && static_cast<uint8_t>(p[i]) < 0x80)
+        i++;
+    return i;
+}
+
+std::string decode_ascii(const std::string &src) {
+    if (ascii_prefix_len(src.data(), src.length()) != src.length())
+        throw_illegal_seq();
+    return src;
+}
+
+// Checks well-formedness as per table 3-7 of the Unicode standard: no
+// overlong forms, no surrogates and nothing above U+10FFFF
+std::string decode_utf8(const std::string &src) {
+    const char *p = src.data();
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(p);
+    std::size_t len = src.length();
+    std::size_t i = ascii_prefix_len(p, len);
+    while (i < len) {
+        uint8_t b = s[i];
+        std::size_t n = 0;
+        // Allowed range of the first continuation byte
+        uint8_t lo = 0x80;
+        uint8_t hi = 0xBF;
+        if (b >= 0xC2 && b <= 0xDF) {
+            n = 1;
+        } else if (b >= 0xE0 && b <= 0xEF) {
+            n = 2;
+            if (b == 0xE0) {
+                lo = 0xA0;
+            } else if (b == 0xED) {
+                hi = 0x9F;
+            }
+        } else if (b >= 0xF0 && b <= 0xF4) {
+            n = 3;
+            if (b == 0xF0) {
+                lo = 0x90;
+            } else if (b == 0xF4) {
+                hi = 0x8F;
+            }
+        } else {
+            throw_illegal_seq();
+        }
+        for (std::size_t k = 1; k <= n; k++) {
+            if (i + k == len)
+                throw_incomplete_seq();
+            uint8_t c = s[i + k];
+            if (c < lo || c > hi)
+                throw_illegal_seq();
+            lo = 0x80;
+            hi = 0xBF;
+        }
+        i += n + 1;
+        i += ascii_prefix_len(p + i, len - i);
+    }
+    return src;
+}
+
+// Every byte is its own code point, so bytes from 0x80 up just become two
+// bytes each
+std::string decode_latin1(const std::string &src) {
+    const char *p = src.data();
+    std::size_t len = src.length();
+    std::size_t i = ascii_prefix_len(p, len);
+    if (i == len)
+        return src;
+
+    std::string dst(i + (len - i) * 2, '\0');
+    char *d = &dst[0];
+    std::memcpy(d, p, i);
+    d += i;
+    while (i < len) {
+        uint8_t b = static_cast<uint8_t>(p[i++]);
+        if (b < 0x80) {
+            *d++ = static_cast<char>(b);
+        } else {
+            *d++ = static_cast<char>(0xC0 | (b >> 6));
+            *d++ = static_cast<char>(0x80 | (b & 0x3F));
+        }
+        std::size_t run = ascii_prefix_len(p + i, len - i);
+        std::memcpy(d, p + i, run);
+        d += run;
+        i += run;
+    }
+    dst.resize(d - &dst[0]);
+    return dst;
+}
+
+// Each code unit becomes at most 3 bytes and each surrogate pair 4, so the
+// output never grows past 3 bytes per unit. With SSE2, runs of code units
+// below 0x80 are narrowed 8 at a time.
+std::string decode_utf16(const std::string &src, bool big_endian) {
+    std::size_t len = src.length();
+    std::size_t end = len - len % 2;
+    if (end == 0) {
+        if (len != 0)
+            throw_incomplete_seq();
+        return std::string();
+    }
+
+    const uint8_t *s = reinterpret_cast<const uint8_t *>(src.data());
+    std::string dst(end / 2 * 3, '\0');
+    char *d = &dst[0];
+    std::size_t hi_byte = big_endian ? 0 : 1;
+    std::size_t i = 0;
+    while (i < end) {
+#if defined(KS_SIMD_SSE2)
+        const __m128i non_ascii = _mm_set1_epi16(-0x80);
+        for (; i + 16 <= end; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+            if (big_endian)
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            __m128i high = _mm_and_si128(v, non_ascii);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(high, _mm_setzero_si128())) != 0xFFFF)
+                break;
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(d), _mm_packus_epi16(v, v));
+            d += 8;
+        }
+        if (i == end)
+            break;
+#endif
+        uint32_t u = (static_cast<uint32_t>(s[i + hi_byte]) << 8) | s[i + 1 - hi_byte];
+        i += 2;
+        if (u < 0x80) {
+            *d++ = static_cast<char>(u);
+        } else if (u < 0x800) {
+            *d++ = static_cast<char>(0xC0 | (u >> 6));
+            *d++ = static_cast<char>(0x80 | (u & 0x3F));
+        } else if (u < 0xD800 || u > 0xDFFF) {
+            *d++ = static_cast<char>(0xE0 | (u >> 12));
+            *d++ = static_cast<char>(0x80 | ((u >> 6) & 0x3F));
+            *d++ = static_cast<char>(0x80 | (u & 0x3F));
+        } else if (u <= 0xDBFF) {
+            if (i == end)
+                throw_incomplete_seq();
+            uint32_t u2 = (static_cast<uint32_t>(s[i + hi_byte]) << 8) | s[i + 1 - hi_byte];
+            if (u2 < 0xDC00 || u2 > 0xDFFF)
+                throw_illegal_seq();
+            i += 2;
+            uint32_t cp = 0x10000 + ((u - 0xD800) << 10) + (u2 - 0xDC00);
+            *d++ = static_cast<char>(0xF0 | (cp >> 18));
+            *d++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            *d++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            *d++ = static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            throw_illegal_seq();
+        }
+    }
+    if (len != end)
+        throw_incomplete_seq();
+    dst.resize(d - &dst[0]);
+    return dst;
+}
+
+enum builtin_encoding {
+    BUILTIN_NONE,
+    BUILTIN_ASCII,
+    BUILTIN_UTF8,
+    BUILTIN_LATIN1,
+    BUILTIN_UTF16LE,
+    BUILTIN_UTF16BE
+};
+
+builtin_encoding find_builtin_encoding(const char *src_enc) {
+    if (!builtin_decoders_usable())
+        return BUILTIN_NONE;
+    if (std::strcmp(src_enc, "ASCII") == 0)
+        return BUILTIN_ASCII;
+    if (std::strcmp(src_enc, "UTF-8") == 0)
+        return BUILTIN_UTF8;
+    if (std::strcmp(src_enc, "ISO-8859-1") == 0)
+        return BUILTIN_LATIN1;
+    if (std::strcmp(src_enc, "UTF-16LE") == 0)
+        return BUILTIN_UTF16LE;
+    if (std::strcmp(src_enc, "UTF-16BE") == 0)
+        return BUILTIN_UTF16BE;
+    return BUILTIN_NONE;
+}
+
+std::string decode_builtin(const std::string &src, builtin_encoding enc) {
+    switch (enc) {
+    case BUILTIN_ASCII:
+        return decode_ascii(src);
+    case BUILTIN_UTF8:
+        return decode_utf8(src);
+    case BUILTIN_LATIN1:
+        return decode_latin1(src);
+    case BUILTIN_UTF16LE:
+        return decode_utf16(src, false);
+    case BUILTIN_UTF16BE:
+        return decode_utf16(src, true);
+    default:
+        throw std::invalid_argument("decode_builtin: no built-in decoder");
+    }
+}
+
+}
+
+std::string kaitai::kstream::bytes_to_str_ascii(const std::string &src) {
+    if (!builtin_decoders_usable())
+        return bytes_to_str(src, "ASCII");
+    return decode_ascii(src);
+}
+
+std::string kaitai::kstream::bytes_to_str_utf8(const std::string &src) {
+    if (!builtin_decoders_usable())
+        return bytes_to_str(src, "UTF-8");
+    return decode_utf8(src);
+}
+
+std::string kaitai::kstream::bytes_to_str_latin1(const std::string &src) {
+    if (!builtin_decoders_usable())
+        return bytes_to_str(src, "ISO-8859-1");
+    return decode_latin1(src);
+}
+
+std::string kaitai::kstream::bytes_to_str_utf16le(const std::string &src) {
+    if (!builtin_decoders_usable())
+        return bytes_to_str(src, "UTF-16LE");
+    return decode_utf16(src, false);
+}
+
+std::string kaitai::kstream::bytes_to_str_utf16be(const std::string &src) {
+    if (!builtin_decoders_usable())
+        return bytes_to_str(src, "UTF-16BE");
+    return decode_utf16(src, true);
+}
+#else
+std::string kaitai::kstream::bytes_to_str_ascii(const std::string &src) {
+    return src;
+}
+
+std::string kaitai::kstream::bytes_to_str_utf8(const std::string &src) {
+    return src;
+}
+
+std::string kaitai::kstream::bytes_to_str_latin1(const std::string &src) {
+    return src;
+}
+
+std::string kaitai::kstream::bytes_to_str_utf16le(const std::string &src) {
+    return src;
+}
+
+std::string kaitai::kstream::bytes_to_str_utf16be(const std::string &src) {
+    return src;
+}
+#endif
+
 #ifdef KS_STR_ENCODING_ICONV
 #include <iconv.h>
 
-std::string kaitai::kstream::bytes_to_str(const std::string src, const char *src_enc) {
-    iconv_t cd = iconv_open(KS_STR_DEFAULT_ENCODING, src_enc);
+namespace {
 
-    if (cd == (iconv_t)-1) {
-        if (errno == EINVAL) {
-            throw unknown_encoding(src_enc);
-        } else {
-            throw bytes_to_str_error("error opening iconv");
+// Converted strings are built in a scratch buffer kept with the descriptors
+// and copied out once; a buffer grown past the limit is released afterwards
+const std::size_t ICONV_SCRATCH_SIZE = 256;
+const std::size_t ICONV_SCRATCH_KEEP_LIMIT = 1024 * 1024;
+
+/**
+ * Conversion descriptors opened by bytes_to_str(), by source encoding.
+ * iconv_open() loads conversion tables, which costs far more than converting
+ * a short string, so with C++11 every thread keeps its descriptors open and
+ * only returns them to the initial state before each use.
+ */
+class iconv_cache {
+public:
+    iconv_cache() {}
+
+    ~iconv_cache() {
+        // Errors are ignored: there is nothing left to do about them
+        for (std::size_t i = 0; i < m_entries.size(); i++)
+            iconv_close(m_entries[i].second);
+    }
+
+    iconv_t get(const char *src_enc) {
+        for (std::size_t i = 0; i < m_entries.size(); i++) {
+            if (m_entries[i].first == src_enc) {
+                iconv_t cd = m_entries[i].second;
+                iconv(cd, NULL, NULL, NULL, NULL);
+                return cd;
+            }
         }
+
+        // Make room first, so that an opened descriptor is never lost
+        m_entries.reserve(m_entries.size() + 1);
+        std::string name(src_enc);
+        iconv_t cd = iconv_open(KS_STR_DEFAULT_ENCODING, src_enc);
+        if (cd == (iconv_t)-1) {
+            if (errno == EINVAL) {
+                throw kaitai::unknown_encoding(src_enc);
+            } else {
+                throw kaitai::bytes_to_str_error("error opening iconv");
+            }
+        }
+        m_entries.push_back(std::make_pair(name, cd));
+        return cd;
     }
 
+    std::string &scratch() {
+        return m_scratch;
+    }
+
+private:
+    std::vector<std::pair<std::string, iconv_t> > m_entries;
+    std::string m_scratch;
+
+    iconv_cache(const iconv_cache&);
+    iconv_cache& operator=(const iconv_cache&);
+};
+
+// Upper bound of the converted length for the usual encodings when
+// converting to UTF-8, so that a string is converted in one go: UTF-16 code
+// units become at most 3 bytes, and other code pages at most 3 bytes per byte
+std::size_t converted_len_bound(const char *src_enc, std::size_t src_len) {
+    if (std::strcmp(KS_STR_DEFAULT_ENCODING, "UTF-8") != 0)
+        return src_len * 2;
+    if (std::strcmp(src_enc, "UTF-8") == 0 || std::strcmp(src_enc, "ASCII") == 0 ||
+            std::strncmp(src_enc, "UTF-32", 6) == 0)
+        return src_len;
+    if (std::strncmp(src_enc, "UTF-16", 6) == 0)
+        return src_len / 2 * 3 + 3;
+    return src_len * 3;
+}
+
+}
+
+std::string kaitai::kstream::bytes_to_str(const std::string src, const char *src_enc) {
+    // The common encodings do not need iconv at all
+    builtin_encoding builtin = find_builtin_encoding(src_enc);
+    if (builtin != BUILTIN_NONE)
+        return decode_builtin(src, builtin);
+
+#ifdef KAITAI_STREAM_H_CPP11_SUPPORT
+    static thread_local iconv_cache cache;
+#else
+    iconv_cache cache;
+#endif
+    iconv_t cd = cache.get(src_enc);
+
     std::size_t src_len = src.length();
     std::size_t src_left = src_len;
 
-    // Start with a buffer length of double the source length.
-    std::size_t dst_len = src_len * 2;
-    std::string dst(dst_len, ' ');
+    std::string &dst = cache.scratch();
+    std::size_t dst_len = std::max(converted_len_bound(src_enc, src_len), ICONV_SCRATCH_SIZE);
+    if (dst.size() < dst_len) {
+        dst.resize(dst_len);
+    } else {
+        dst_len = dst.size();
+    }
     std::size_t dst_left = dst_len;
 
     // NB: this should be const char *, but for some reason iconv() requires non-const in its 2nd argument,
@@ -1018,11 +3507,7 @@ std::string kaitai::kstream::bytes_to_str(const std::string src, const char *src
                 // it using "dst_used".
                 dst_ptr = &dst[dst_used];
             } else {
-                // Try to close the conversion descriptor, ignore any errors: if `iconv_close`
-                // fails, there is nothing we can do, since we mainly want to deliver the error from
-                // `iconv` as an exception. We only call `iconv_close` here to prevent memory leaks,
-                // it is not a critical operation.
-                iconv_close(cd);
+                // The descriptor stays cached: it is reset before its next use
                 if (saved_errno == EILSEQ) {
                     throw illegal_seq_in_encoding("EILSEQ");
                 }
@@ -1033,16 +3518,14 @@ std::string kaitai::kstream::bytes_to_str(const std::string src, const char *src
             }
         } else {
             // conversion successful
-            dst.resize(dst_len - dst_left);
             break;
         }
     }
 
-    if (iconv_close(cd) != 0) {
-        throw bytes_to_str_error("iconv close error");
-    }
-
-    return dst;
+    std::string result(dst, 0, dst_len - dst_left);
+    if (dst.size() > ICONV_SCRATCH_KEEP_LIMIT)
+        std::string().swap(dst);
+    return result;
 }
 #elif defined(KS_STR_ENCODING_NONE)
 std::string kaitai::kstream::bytes_to_str(const std::string src, const char *src_enc) {
@@ -1165,6 +3648,12 @@ int kaitai::kstream::encoding_to_win_codepage(const char *src_enc) {
 }
 
 std::string kaitai::kstream::bytes_to_str(const std::string src, const char *src_enc) {
+    // The common encodings are decoded (and validated) the same way as with
+    // iconv, and as by the bytes_to_str_*() helpers
+    builtin_encoding builtin = find_builtin_encoding(src_enc);
+    if (builtin != BUILTIN_NONE)
+        return decode_builtin(src, builtin);
+
     // Step 1: convert encoding name to codepage number
     int codepage = encoding_to_win_codepage(src_enc);
     if (codepage == KAITAI_CP_UNSUPPORTED) {
@@ -1174,9 +3663,10 @@ std::string kaitai::kstream::bytes_to_str(const std::string src, const char *src
 }
 
 std::string kaitai::kstream::bytes_to_str(const std::string src, int codepage) {
-    // Shortcut: if we're already in UTF-8, no need to convert anything
+    // Shortcut: if we're already in UTF-8, there is nothing to convert, only
+    // to validate
     if (codepage == CP_UTF8) {
-        return src;
+        return decode_utf8(src);
     }
     // If `src` is empty, no conversion is needed either (in fact, the Win32 functions we use, i.e.
     // MultiByteToWideChar and WideCharToMultiByte, fail with ERROR_INVALID_PARAMETER when they
@@ -13,16 +13,95 @@
 
 #include <ios> // std::streamsize, forward declaration of std::istream  // IWYU pragma: keep
 #include <cstddef> // std::size_t
+#include <cstring> // std::memcpy, std::memcmp
 #include <climits> // LLONG_MAX, ULLONG_MAX
 #include <sstream> // std::istringstream  // IWYU pragma: keep
 #include <string> // std::string
+#include <utility> // std::pair
+#include <vector> // std::vector
 
 namespace kaitai {
 
+class kstream_source;
+template <class Backend> class basic_kstream;
+
+/**
+ * Non-owning reference to a run of bytes, as returned by
+ * kstream::read_bytes_view(). It converts to `std::string` (with a copy) and
+ * compares with other views and strings by contents.
+ */
+class bytes_view {
+public:
+    bytes_view() : m_data(NULL), m_size(0) {}
+    bytes_view(const char* data, std::size_t size) : m_data(data), m_size(size) {}
+    /** Refers to the contents of `str`, which must outlive the view */
+    bytes_view(const std::string& str) : m_data(str.data()), m_size(str.size()) {}
+
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    std::size_t length() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const char* begin() const { return m_data; }
+    const char* end() const { return m_data + m_size; }
+
+    char operator[](std::size_t i) const { return m_data[i]; }
+    char at(std::size_t i) const;
+    char front() const { return at(0); }
+    char back() const { return at(m_size - 1); }
+
+    std::string str() const { return std::string(m_data, m_size); }
+    operator std::string() const { return str(); }
+
+    int compare(const bytes_view& other) const;
+
+    friend bool operator==(const bytes_view& a, const bytes_view& b) {
+        return a.m_size == b.m_size && (a.m_size == 0 || std::memcmp(a.m_data, b.m_data, a.m_size) == 0);
+    }
+    friend bool operator!=(const bytes_view& a, const bytes_view& b) { return !(a == b); }
+    friend bool operator<(const bytes_view& a, const bytes_view& b) { return a.compare(b) < 0; }
+    friend bool operator>(const bytes_view& a, const bytes_view& b) { return a.compare(b) > 0; }
+    friend bool operator<=(const bytes_view& a, const bytes_view& b) { return a.compare(b) <= 0; }
+    friend bool operator>=(const bytes_view& a, const bytes_view& b) { return a.compare(b) >= 0; }
+
+private:
+    const char* m_data;
+    std::size_t m_size;
+};
+
+/**
+ * String that keeps the bytes it is read from and decodes them with
+ * kstream::bytes_to_str() only when it is first asked for, as stored by code
+ * generated with `--cpp-lazy-str`. Decoding errors are thus thrown by get()
+ * instead of while parsing. The first get() modifies the object, so it must
+ * not race with other get() calls.
+ */
+class lazy_str {
+public:
+    lazy_str() : m_encoding(NULL), m_decoded(true) {}
+    /**
+     * \param raw bytes of the string
+     * \param encoding name of their encoding, which must stay valid for the
+     *     lifetime of the object (e.g. a string literal)
+     */
+    lazy_str(std::string raw, const char* encoding) : m_encoding(encoding), m_decoded(false) {
+        m_raw.swap(raw);
+    }
+
+    /** Decodes the bytes on the first call, and returns the string */
+    const std::string& get() const;
+
+private:
+    mutable std::string m_raw;
+    const char* m_encoding;
+    mutable std::string m_str;
+    mutable bool m_decoded;
+};
+
 /**
  * Kaitai Stream class (kaitai::kstream) is an implementation of
  * <a href="https://doc.kaitai.io/stream_api.html">Kaitai Struct stream API</a>
- * for C++/STL. It's implemented as a wrapper over generic STL std::istream.
+ * for C++/STL. It's implemented either as a wrapper over generic STL
+ * std::istream or directly over a contiguous in-memory buffer.
  *
  * It provides a wide variety of simple methods to read (parse) binary
  * representations of primitive types, such as integer and floating
@@ -38,19 +117,178 @@ namespace kaitai {
  */
 class kstream {
 public:
+    /**
+     * Default size of the read-ahead buffer used by
+     * kstream(std::istream*, std::size_t).
+     */
+    static const std::size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * Contiguous piece of data: pointer to its first byte and its length.
+     */
+    typedef std::pair<const char*, std::size_t> segment;
+
+    /**
+     * Expected way of accessing the data of a stream, see advise().
+     */
+    enum access_hint_t {
+        /** No particular access pattern (the default) */
+        HINT_NORMAL,
+        /** Data will be read sequentially, so read ahead aggressively */
+        HINT_SEQUENTIAL,
+        /** Data will be read in random order, so don't read ahead */
+        HINT_RANDOM,
+        /** Data will be read soon, so start loading it now */
+        HINT_WILLNEED
+    };
+
+    /**
+     * How a stream reports errors in the data it reads, see set_error_mode().
+     */
+    enum error_mode_t {
+        /** Throw an exception (the default) */
+        ERRORS_THROW,
+        /** Record the error in status() and carry on */
+        ERRORS_STATUS
+    };
+
+    /**
+     * Kind of the first error recorded by a stream, see status().
+     */
+    enum status_t {
+        /** No error so far */
+        STATUS_OK,
+        /** Tried to read or seek beyond the end of stream */
+        STATUS_EOF,
+        /** Data is malformed (e.g. failed validation, negative size) */
+        STATUS_INVALID
+    };
+
     /**
      * Constructs new Kaitai Stream object, wrapping a given std::istream.
+     * If the istream is seekable, its size is determined right away (so it
+     * must not grow while being parsed), and is_eof() and size() then just
+     * compare positions.
      * \param io istream object to use for this Kaitai Stream
      */
     kstream(std::istream* io);
 
+    /**
+     * Constructs new Kaitai Stream object, reading a given std::istream
+     * through a read-ahead buffer: data is fetched from the underlying stream
+     * buffer in blocks of `buffer_size` bytes, and primitive reads, pos(),
+     * is_eof() and seeks within the current block are served without touching
+     * the istream. The istream must not be used by anything else while this
+     * Kaitai Stream reads it, and its position is unspecified afterwards.
+     * \param io istream object to use for this Kaitai Stream
+     * \param buffer_size size of the read-ahead buffer in bytes (0 to read
+     *   the istream directly, like kstream(std::istream*) does)
+     *
+     * If the istream cannot seek (e.g. it reads from a pipe), this works like
+     * kstream(std::istream*, std::size_t, std::size_t) with a rewind window
+     * of `buffer_size` bytes.
+     */
+    kstream(std::istream* io, std::size_t buffer_size);
+
+    /**
+     * Constructs new Kaitai Stream object, reading a forward-only std::istream
+     * (e.g. `std::cin`, a socket or decompressor output), which is never
+     * asked to seek. At least `rewind_size` bytes before the current position
+     * are kept in memory, so the stream can still be positioned anywhere
+     * from there onwards; seeking further back throws
+     * std::ios_base::failure, and so does size(). Note that parsing a sized
+     * field with a user type also seeks back over it, so the rewind window
+     * has to be larger than such fields.
+     * \param io istream object to use for this Kaitai Stream
+     * \param buffer_size number of bytes to read from the istream at once (0
+     *   means DEFAULT_BUFFER_SIZE)
+     * \param rewind_size minimal number of bytes to keep before the current
+     *   position
+     */
+    kstream(std::istream* io, std::size_t buffer_size, std::size_t rewind_size);
+
     /**
      * Constructs new Kaitai Stream object, wrapping a given in-memory data
-     * buffer.
+     * buffer. The data is copied into the stream object.
      * \param data data buffer to use for this Kaitai Stream
      */
     kstream(const std::string& data);
 
+    /**
+     * Constructs new Kaitai Stream object, reading directly from a given
+     * contiguous in-memory buffer without copying it. The buffer must stay
+     * valid and unchanged for the whole lifetime of this Kaitai Stream.
+     * \param data pointer to the first byte of the buffer
+     * \param len length of the buffer in bytes
+     */
+    kstream(const char* data, std::size_t len);
+
+    /**
+     * Constructs new Kaitai Stream object, reading the concatenation of
+     * given non-contiguous in-memory segments (e.g. reassembled network
+     * payloads) without copying them. Reads that fit into one segment are as
+     * fast as with a contiguous buffer, and reads crossing segment boundaries
+     * are stitched together transparently. A substream that fits into one
+     * segment points directly into it. The segments must stay valid and
+     * unchanged for the whole lifetime of this Kaitai Stream (the list
+     * itself is copied).
+     * \param segments list of segments, in order
+     */
+    kstream(const std::vector<segment>& segments);
+
+    /**
+     * Constructs new Kaitai Stream object as a substream: a window of `len`
+     * bytes of `parent`, starting at absolute position `offset` in it. If the
+     * parent reads from an in-memory buffer (or the window fits into one
+     * segment of a segmented parent), the window points directly into
+     * that buffer and no data is copied (so the buffer must outlive the
+     * substream); otherwise the bytes are read from the parent into a buffer
+     * owned by the substream. Position of `parent` is left unchanged.
+     * \param parent stream to create a substream of
+     * \param offset position of the first byte of the substream in `parent`
+     * \param len length of the substream in bytes
+     * \throws std::ios_base::failure if the window exceeds the end of `parent`
+     */
+    kstream(kstream* parent, uint64_t offset, uint64_t len);
+
+    ~kstream();
+
+    /**
+     * Creates new Kaitai Stream object reading from a memory-mapped file. The
+     * whole file is mapped read-only and then read through the in-memory
+     * buffer backend; the mapping is released on close() or destruction.
+     * \param path path to the file to map
+     * \return newly allocated Kaitai Stream object, owned by the caller
+     */
+    static kstream* from_mmap(const std::string& path);
+
+    /**
+     * Creates new Kaitai Stream object reading an open file descriptor with
+     * positional reads (`pread()` on POSIX), through a read-ahead buffer of
+     * `buffer_size` bytes. The stream keeps its own position and never
+     * changes the file offset, so any number of streams (even in different
+     * threads) may read the same descriptor at once. The descriptor is not
+     * owned by the stream and must stay open while it is used.
+     *
+     * With `prefetch_blocks` > 0, a background thread keeps reading up to
+     * that many blocks following the current one while the stream is being
+     * parsed, so that I/O and parsing overlap; when the stream is positioned
+     * elsewhere, the read-ahead is dropped and starts over from there. This
+     * needs the runtime to be built as C++11 (or newer), otherwise
+     * `prefetch_blocks` is ignored.
+     * \param fd file descriptor opened for reading
+     * \param buffer_size size of the read-ahead buffer (block) in bytes (0
+     *   means DEFAULT_BUFFER_SIZE)
+     * \param prefetch_blocks number of blocks to read ahead in background
+     *   (0 to read synchronously)
+     * \return newly allocated Kaitai Stream object, owned by the caller
+     */
+    static kstream* from_fd(int fd, std::size_t buffer_size = DEFAULT_BUFFER_SIZE, std::size_t prefetch_blocks = 0);
+
+    /**
+     * Releases resources held by the stream (e.g. unmaps a file mapped by
+     * from_mmap()). The stream must not be read after it has been closed.
+     */
     void close();
 
     /** @name Stream positioning */
@@ -78,10 +316,117 @@ public:
     uint64_t pos();
 
     /**
-     * Get total size of the stream in bytes.
+     * Get total size of the stream in bytes. It's only determined once
+     * (for a seekable std::istream, upon construction) and cached.
      * \return size of the stream in bytes
      */
     uint64_t size();
+
+    /**
+     * Tells the operating system how the stream is going to be read, so that
+     * it can adjust its read-ahead and page cache usage. This only has any
+     * effect for memory-mapped files (from_mmap(), including substreams
+     * pointing into them, via `posix_madvise()`) and file descriptors
+     * (from_fd(), via `posix_fadvise()`); it is ignored otherwise. Giving the
+     * same hint repeatedly is cheap.
+     * \param hint expected access pattern of the whole stream
+     */
+    void advise(access_hint_t hint);
+
+    /**
+     * Tells the operating system how a part of the stream is going to be
+     * read, see advise(access_hint_t). Typically used with HINT_WILLNEED
+     * before seeking to data that will be parsed next. Ranges shorter than
+     * 4 KiB are ignored, as hinting them would cost more than it saves.
+     * \param hint expected access pattern of the range
+     * \param pos position of the first byte of the range
+     * \param len length of the range in bytes
+     */
+    void advise(access_hint_t hint, uint64_t pos, uint64_t len);
+    //@}
+
+    /** @name Error reporting */
+    //@{
+    /**
+     * Selects how errors caused by the data are reported. In the
+     * ERRORS_THROW mode (the default), reading past the end of stream throws
+     * std::ios_base::failure and so on. In the ERRORS_STATUS mode, the first
+     * such error is recorded instead (see status() and error_pos()) and the
+     * failing operation leaves the position unchanged and returns a dummy
+     * value (0, or an empty or zero-filled byte array), so that malformed
+     * input costs no more to reject than valid input. A mismatch in
+     * ensure_fixed_contents() is recorded as STATUS_INVALID. Code generated with
+     * `--cpp-error-status` checks ok() after every field and returns early.
+     *
+     * Substreams created from a stream in the ERRORS_STATUS mode use it as
+     * well, and also record their errors in the parent stream (with the
+     * position translated to the parent), which then must outlive them.
+     * These errors are still thrown in the ERRORS_STATUS mode, and leave the
+     * status untouched:
+     * - I/O errors of the underlying file or istream (std::ios_base::failure);
+     * - decoding errors of bytes_to_str() and bytes_to_str_*()
+     *   (kaitai::bytes_to_str_error and its subclasses), which read no stream;
+     * - errors of process_zlib(), process_deflate(), process_gzip()
+     *   (std::runtime_error), which read no stream either, and invalid data
+     *   read from a from_zlib() stream (std::runtime_error);
+     * - exceptions of custom process routines;
+     * - misuse of the API (std::logic_error, std::invalid_argument, ...).
+     *
+     * \param mode new error reporting mode
+     */
+    void set_error_mode(error_mode_t mode) { m_error_mode = mode; }
+
+    /**
+     * Get current error reporting mode, see set_error_mode().
+     * \return error reporting mode
+     */
+    error_mode_t error_mode() const { return m_error_mode; }
+
+    /**
+     * Get kind of the first error recorded by the stream (only errors of the
+     * ERRORS_STATUS mode and set_error() calls are recorded). The status is
+     * sticky: it is kept until clear_error(), no matter what is read next.
+     * \return kind of the first recorded error, or STATUS_OK
+     */
+    status_t status() const { return m_status; }
+
+    /**
+     * Check whether no error has been recorded so far.
+     * \return "true" if status() is STATUS_OK
+     */
+    bool ok() const { return m_status == STATUS_OK; }
+
+    /**
+     * Get position of the first recorded error: the position of the
+     * failing read, seek or validated field.
+     * \return position of the first recorded error (0 if there is none)
+     */
+    uint64_t error_pos() const { return m_error_pos; }
+
+    /**
+     * Records an error at a given position, unless an earlier one has been
+     * recorded already. Used by the generated code for failed validations
+     * in the ERRORS_STATUS mode.
+     * \param status kind of the error
+     * \param pos position of the error in this stream
+     */
+    void set_error(status_t status, uint64_t pos);
+
+    /**
+     * Forgets the recorded error, if any.
+     */
+    void clear_error();
+
+    /**
+     * Makes this stream use the error reporting mode of `parent` and record
+     * its errors in `parent` as well, at `offset` + position, just like a
+     * substream of `parent` does. Meant for streams over data derived from
+     * `parent` in some other way (e.g. unpacked), which then must not
+     * outlive `parent`.
+     * \param parent stream to report errors to
+     * \param offset position in `parent` corresponding to position 0 of this stream
+     */
+    void set_error_parent(kstream* parent, uint64_t offset);
     //@}
 
     /** @name Integer numbers */
@@ -152,13 +497,154 @@ public:
 
     //@}
 
+    /** @name Unchecked reads */
+    //@{
+
+    /**
+     * Checks if the next `n` bytes can be read by the `*_unchecked()` methods
+     * below, i.e. whether they are all in memory already (possibly after
+     * fetching the next block of a buffered stream). If it returns false, the
+     * regular read methods must be used instead: there may be fewer than `n`
+     * bytes left (in which case they throw at the first one that can't be
+     * read), or the stream may be unable to guarantee it in advance.
+     * \param n number of bytes that are going to be read
+     * \return true if the next `n` bytes can be read without further checks
+     */
+    bool ensure_available(std::size_t n) {
+        return n <= m_buf_len - m_buf_pos || ensure_available_slow(n);
+    }
+
+    // These read a value of the given type just like their checked
+    // counterparts, but without checking that there is enough data: they may
+    // only be used for the bytes guaranteed by a prior ensure_available().
+
+    int8_t read_s1_unchecked() { return static_cast<int8_t>(*take_unchecked(1)); }
+    int16_t read_s2be_unchecked() { return static_cast<int16_t>(load_u2be(take_unchecked(2))); }
+    int32_t read_s4be_unchecked() { return static_cast<int32_t>(load_u4be(take_unchecked(4))); }
+    int64_t read_s8be_unchecked() { return static_cast<int64_t>(load_u8be(take_unchecked(8))); }
+    int16_t read_s2le_unchecked() { return static_cast<int16_t>(load_u2le(take_unchecked(2))); }
+    int32_t read_s4le_unchecked() { return static_cast<int32_t>(load_u4le(take_unchecked(4))); }
+    int64_t read_s8le_unchecked() { return static_cast<int64_t>(load_u8le(take_unchecked(8))); }
+
+    uint8_t read_u1_unchecked() { return *take_unchecked(1); }
+    uint16_t read_u2be_unchecked() { return load_u2be(take_unchecked(2)); }
+    uint32_t read_u4be_unchecked() { return load_u4be(take_unchecked(4)); }
+    uint64_t read_u8be_unchecked() { return load_u8be(take_unchecked(8)); }
+    uint16_t read_u2le_unchecked() { return load_u2le(take_unchecked(2)); }
+    uint32_t read_u4le_unchecked() { return load_u4le(take_unchecked(4)); }
+    uint64_t read_u8le_unchecked() { return load_u8le(take_unchecked(8)); }
+
+    float read_f4be_unchecked() { return to_float(load_u4be(take_unchecked(4))); }
+    double read_f8be_unchecked() { return to_double(load_u8be(take_unchecked(8))); }
+    float read_f4le_unchecked() { return to_float(load_u4le(take_unchecked(4))); }
+    double read_f8le_unchecked() { return to_double(load_u8le(take_unchecked(8))); }
+
+    //@}
+
+    /** @name Arrays of numbers */
+    //@{
+
+    // These read `n` numbers into `buf`, append `n` numbers to `vec`, or
+    // append numbers to `vec` until the end of the stream, with the same
+    // result as calling the matching read_*() method in a loop (including the
+    // position and the numbers read so far if the stream ends prematurely).
+    // Whole runs of numbers are copied at once and byte-swapped in bulk
+    // (using SIMD instructions where available) if their byte order isn't
+    // the native one.
+
+    void read_s1_array(int8_t* buf, std::size_t n);
+    void read_s1_array(std::vector<int8_t>& vec, std::size_t n);
+    void read_s1_array_eos(std::vector<int8_t>& vec);
+    void read_u1_array(uint8_t* buf, std::size_t n);
+    void read_u1_array(std::vector<uint8_t>& vec, std::size_t n);
+    void read_u1_array_eos(std::vector<uint8_t>& vec);
+
+    // ........................................................................
+    // Big-endian
+    // ........................................................................
+
+    void read_s2be_array(int16_t* buf, std::size_t n);
+    void read_s2be_array(std::vector<int16_t>& vec, std::size_t n);
+    void read_s2be_array_eos(std::vector<int16_t>& vec);
+    void read_s4be_array(int32_t* buf, std::size_t n);
+    void read_s4be_array(std::vector<int32_t>& vec, std::size_t n);
+    void read_s4be_array_eos(std::vector<int32_t>& vec);
+    void read_s8be_array(int64_t* buf, std::size_t n);
+    void read_s8be_array(std::vector<int64_t>& vec, std::size_t n);
+    void read_s8be_array_eos(std::vector<int64_t>& vec);
+    void read_u2be_array(uint16_t* buf, std::size_t n);
+    void read_u2be_array(std::vector<uint16_t>& vec, std::size_t n);
+    void read_u2be_array_eos(std::vector<uint16_t>& vec);
+    void read_u4be_array(uint32_t* buf, std::size_t n);
+    void read_u4be_array(std::vector<uint32_t>& vec, std::size_t n);
+    void read_u4be_array_eos(std::vector<uint32_t>& vec);
+    void read_u8be_array(uint64_t* buf, std::size_t n);
+    void read_u8be_array(std::vector<uint64_t>& vec, std::size_t n);
+    void read_u8be_array_eos(std::vector<uint64_t>& vec);
+    void read_f4be_array(float* buf, std::size_t n);
+    void read_f4be_array(std::vector<float>& vec, std::size_t n);
+    void read_f4be_array_eos(std::vector<float>& vec);
+    void read_f8be_array(double* buf, std::size_t n);
+    void read_f8be_array(std::vector<double>& vec, std::size_t n);
+    void read_f8be_array_eos(std::vector<double>& vec);
+
+    // ........................................................................
+    // Little-endian
+    // ........................................................................
+
+    void read_s2le_array(int16_t* buf, std::size_t n);
+    void read_s2le_array(std::vector<int16_t>& vec, std::size_t n);
+    void read_s2le_array_eos(std::vector<int16_t>& vec);
+    void read_s4le_array(int32_t* buf, std::size_t n);
+    void read_s4le_array(std::vector<int32_t>& vec, std::size_t n);
+    void read_s4le_array_eos(std::vector<int32_t>& vec);
+    void read_s8le_array(int64_t* buf, std::size_t n);
+    void read_s8le_array(std::vector<int64_t>& vec, std::size_t n);
+    void read_s8le_array_eos(std::vector<int64_t>& vec);
+    void read_u2le_array(uint16_t* buf, std::size_t n);
+    void read_u2le_array(std::vector<uint16_t>& vec, std::size_t n);
+    void read_u2le_array_eos(std::vector<uint16_t>& vec);
+    void read_u4le_array(uint32_t* buf, std::size_t n);
+    void read_u4le_array(std::vector<uint32_t>& vec, std::size_t n);
+    void read_u4le_array_eos(std::vector<uint32_t>& vec);
+    void read_u8le_array(uint64_t* buf, std::size_t n);
+    void read_u8le_array(std::vector<uint64_t>& vec, std::size_t n);
+    void read_u8le_array_eos(std::vector<uint64_t>& vec);
+    void read_f4le_array(float* buf, std::size_t n);
+    void read_f4le_array(std::vector<float>& vec, std::size_t n);
+    void read_f4le_array_eos(std::vector<float>& vec);
+    void read_f8le_array(double* buf, std::size_t n);
+    void read_f8le_array(std::vector<double>& vec, std::size_t n);
+    void read_f8le_array_eos(std::vector<double>& vec);
+
+    //@}
+
     /** @name Unaligned bit values */
     //@{
 
-    void align_to_byte();
-    uint64_t read_bits_int_be(int n);
+    void align_to_byte() {
+        m_bits_left = 0;
+        m_bits = 0;
+    }
+
+    /**
+     * Read `n` bits (up to 64) as an unsigned big-endian / little-endian
+     * integer. In memory, the bits come from a 64-bit accumulator refilled a
+     * word at a time; the bytes read ahead into it are only consumed once
+     * their first bit is returned, so pos() and byte reads in between are
+     * not affected.
+     */
+    uint64_t read_bits_int_be(int n) {
+        if (n >= 1 && n <= m_bits_left && bits_ahead_usable(false))
+            return take_bits_be(n);
+        return read_bits_int_be_slow(n);
+    }
     uint64_t read_bits_int(int n);
-    uint64_t read_bits_int_le(int n);
+    uint64_t read_bits_int_le(int n) {
+        if (n >= 1 && n <= m_bits_left && bits_ahead_usable(true))
+            return take_bits_le(n);
+        return read_bits_int_le_slow(n);
+    }
 
     //@}
 
@@ -167,6 +653,25 @@ public:
 
     std::string read_bytes(std::streamsize len);
     std::string read_bytes_full();
+
+    /**
+     * Reads `len` bytes like read_bytes(), but without copying them: the
+     * view points right into the buffer of an in-memory or memory-mapped
+     * stream (or a substream of one, or a segment), and stays valid as long
+     * as that buffer does. Other streams (over a std::istream, a file
+     * descriptor or decompressed data), and reads spanning two segments,
+     * can't provide views: the bytes are read and std::logic_error is
+     * thrown.
+     * \param len number of bytes to read
+     * \return view of the bytes read
+     */
+    bytes_view read_bytes_view(std::streamsize len);
+
+    /**
+     * Reads the rest of the stream like read_bytes_full(), returning a view
+     * as read_bytes_view() does.
+     */
+    bytes_view read_bytes_full_view();
     std::string read_bytes_term(char term, bool include, bool consume, bool eos_error);
     std::string read_bytes_term_multi(std::string term, bool include, bool consume, bool eos_error);
     std::string ensure_fixed_contents(std::string expected);
@@ -176,6 +681,24 @@ public:
     static std::string bytes_terminate_multi(std::string src, std::string term, bool include);
     static std::string bytes_to_str(const std::string src, const char *src_enc);
 
+    /**
+     * Built-in decoders for the most common encodings: each one does what
+     * bytes_to_str() does for the encoding it is named after, but without
+     * looking the encoding up by name and without calling iconv or Win32
+     * APIs. Invalid and incomplete sequences are reported as
+     * illegal_seq_in_encoding with `EILSEQ` and `EINVAL` respectively, as
+     * iconv does. bytes_to_str() uses them too for these encodings, with
+     * either backend, so the two always agree. With KS_STR_ENCODING_NONE,
+     * `src` is returned unchanged, just like bytes_to_str() does.
+     * \param src bytes to be converted
+     * \return UTF-8 string
+     */
+    static std::string bytes_to_str_ascii(const std::string &src);
+    static std::string bytes_to_str_utf8(const std::string &src);
+    static std::string bytes_to_str_latin1(const std::string &src);
+    static std::string bytes_to_str_utf16le(const std::string &src);
+    static std::string bytes_to_str_utf16be(const std::string &src);
+
     //@}
 
     /** @name Byte array processing */
@@ -202,22 +725,65 @@ public:
 
     /**
      * Performs a circular left rotation shift for a given buffer by a given amount of bits,
-     * using groups of 1 bytes each time. Right circular rotation should be performed
-     * using this procedure with corrected amount.
+     * using groups of `group_size` bytes each time. Every group is rotated as a big-endian
+     * integer. Right circular rotation should be performed using this procedure with
+     * corrected amount.
      * @param data source data to process
      * @param amount number of bits to shift by
+     * @param group_size number of bytes rotated together
      * @return copy of source array with requested shift applied
+     * @throws std::invalid_argument if `group_size` is not positive or does not divide
+     *   the length of `data`
+     */
+    static std::string process_rotate_left(std::string data, int amount, int group_size = 1);
+
+    /**
+     * In-place versions of process_xor_one(), process_xor_many() and
+     * process_rotate_left(), working on a buffer owned by the caller. They
+     * use the widest SIMD instructions available: SSE2 or NEON, and AVX2 or
+     * AVX-512 when the CPU running the code supports them.
      */
-    static std::string process_rotate_left(std::string data, int amount);
+    static void process_xor_one_in_place(char *data, std::size_t len, uint8_t key);
+    static void process_xor_many_in_place(char *data, std::size_t len, const char *key, std::size_t key_len);
+    static void process_rotate_left_in_place(char *data, std::size_t len, int amount, int group_size = 1);
 
 #ifdef KS_ZLIB
     /**
      * Performs an unpacking ("inflation") of zlib-compressed data with usual zlib headers.
+     * The inflate state is reused between calls on the same thread (with C++11).
      * @param data data to unpack
+     * @param size_hint expected size of the unpacked data, used to allocate the
+     *   result at once; 0 if unknown
      * @return unpacked data
-     * @throws IOException
+     * @throws std::runtime_error when unpacking invalid or truncated data
+     */
+    static std::string process_zlib(std::string data, uint64_t size_hint = 0);
+
+    /**
+     * Same as process_zlib(), but for raw deflate data without any headers,
+     * as found in ZIP archives.
      */
-    static std::string process_zlib(std::string data);
+    static std::string process_deflate(std::string data, uint64_t size_hint = 0);
+
+    /**
+     * Same as process_zlib(), but for data with a gzip header and trailer
+     * (one gzip member).
+     */
+    static std::string process_gzip(std::string data, uint64_t size_hint = 0);
+
+    /**
+     * Creates new Kaitai Stream object reading the result of unpacking
+     * ("inflation") of zlib-compressed data with usual zlib headers. Unlike
+     * `kstream(process_zlib(data))`, the data is unpacked gradually as the
+     * stream is read, so it is never held in memory as a whole. Seeking back
+     * more than DEFAULT_BUFFER_SIZE bytes before the current position
+     * restarts unpacking from the beginning, and size() has to unpack the
+     * rest of the data (once) to find it out.
+     * @param data data to unpack
+     * @return newly allocated Kaitai Stream object, owned by the caller
+     * @throws std::runtime_error when reading invalid or truncated data
+     */
+    static kstream* from_zlib(std::string data);
 #endif
 
     //@}
@@ -345,14 +911,174 @@ public:
     static uint8_t byte_array_max(const std::string val);
 
 private:
+    // Defines inline versions of the primitive readers (see basic_kstream.h)
+    template <class Backend> friend class basic_kstream;
+
     std::istream* m_io;
-    std::istringstream m_io_str;
+
+    // In-memory buffer backend (only used if `m_io` is NULL): `m_buf` points
+    // to the data, `m_buf_len` is its length and `m_buf_pos` is the current
+    // position. `m_buf_owned` holds the data if the stream owns a copy of it.
+    //
+    // If `m_src` is set, `m_buf` is only the current window of the data,
+    // which starts at absolute position `m_buf_start`, and the next one is
+    // fetched from `m_src` once it is exhausted.
+    mutable const char* m_buf;
+    mutable std::size_t m_buf_len;
+    mutable std::size_t m_buf_pos;
+    mutable uint64_t m_buf_start;
+    std::string m_buf_owned;
+    kstream_source* m_src;
+
+    // File mapping created by `from_mmap()` (NULL if there is none)
+    void* m_mmap_addr;
+    std::size_t m_mmap_len;
+    // Whether `m_buf` points into a file mapping (possibly of a parent stream)
+    bool m_buf_mapped;
+    // Last hint given by advise(access_hint_t)
+    access_hint_t m_hint;
+
+    // Error reporting, see set_error_mode(): errors of a substream are also
+    // recorded in `m_error_parent` (if set) at `m_error_offset` + position
+    error_mode_t m_error_mode;
+    status_t m_status;
+    uint64_t m_error_pos;
+    kstream* m_error_parent;
+    uint64_t m_error_offset;
+
+    // Total size of the stream, once it is known (for a seekable std::istream,
+    // it's determined upon construction; otherwise by the first size() call)
+    uint64_t m_size;
+    bool m_size_known;
+
+    // Bits not read yet by read_bits_int_be() / read_bits_int_le(), right
+    // aligned: the `m_bits_left % 8` ones left of the last byte they
+    // consumed, then `m_bits_left / 8` whole bytes read ahead from the window
+    // but not consumed (stored while `m_bits_pos` is the current position and
+    // `m_bits_le` tells the order they were read in)
     int m_bits_left;
     uint64_t m_bits;
+    uint64_t m_bits_pos;
+    bool m_bits_le;
+
+    // Not copyable: `m_buf` may point into `m_buf_owned`
+    kstream(const kstream&);
+    kstream& operator=(const kstream&);
+
+    // Takes ownership of `src`
+    explicit kstream(kstream_source* src);
 
     void init();
+    void cache_io_size();
     void exceptions_enable() const;
 
+    static kstream* from_mapping(void* addr, std::size_t len);
+
+    void read_raw(char* buf, std::size_t len);
+    void read_raw_slow(char* buf, std::size_t len);
+    std::size_t read_partial(char* buf, std::size_t len);
+    bool refill() const;
+    bool ensure_available_slow(std::size_t n);
+    uint64_t read_bits_int_be_slow(int n);
+    uint64_t read_bits_int_le_slow(int n);
+    void drop_bits_ahead();
+
+    // Whether the bytes read ahead into `m_bits` (if any) are still the next
+    // ones in the window, read in the order given by `le`
+    bool bits_ahead_usable(bool le) const {
+        return m_bits_left < 8 ||
+            (m_bits_le == le && m_bits_pos == m_buf_start + m_buf_pos &&
+             static_cast<std::size_t>(m_bits_left >> 3) <= m_buf_len - m_buf_pos);
+    }
+
+    // Return the next `n` bits of `m_bits` (1 <= `n` <= `m_bits_left`),
+    // consuming the bytes read ahead that they reach into
+    uint64_t take_bits_be(int n) {
+        const int rest = m_bits_left - n;
+        const uint64_t res = m_bits >> rest;
+        m_bits &= (static_cast<uint64_t>(1) << rest) - 1;
+        m_buf_pos += (m_bits_left >> 3) - (rest >> 3);
+        m_bits_left = rest;
+        m_bits_pos = m_buf_start + m_buf_pos;
+        m_bits_le = false;
+        return res;
+    }
+
+    uint64_t take_bits_le(int n) {
+        const int rest = m_bits_left - n;
+        const uint64_t res = n < 64 ? m_bits & ((static_cast<uint64_t>(1) << n) - 1) : m_bits;
+        m_bits = n < 64 ? m_bits >> n : 0;
+        m_buf_pos += (m_bits_left >> 3) - (rest >> 3);
+        m_bits_left = rest;
+        m_bits_pos = m_buf_start + m_buf_pos;
+        m_bits_le = true;
+        return res;
+    }
+    void eof_error(uint64_t pos);
+    bytes_view no_view(const std::string& bytes, bool was_ok);
+
+    // Implementation of the read_*_array() methods: `swap` tells whether the
+    // byte order of the items differs from the native one
+    std::size_t items_available(std::size_t width, std::size_t max);
+    bool read_item(char* buf, std::size_t width, bool swap);
+    template <typename T> void read_array(T* buf, std::size_t n, bool swap);
+    template <typename T> void read_array(std::vector<T>& vec, std::size_t n, bool swap);
+    template <typename T> void read_array_eos(std::vector<T>& vec, bool swap);
+
+    // Returns the next `n` bytes of the current window and skips them
+    const unsigned char* take_unchecked(std::size_t n) {
+        align_to_byte();
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(m_buf + m_buf_pos);
+        m_buf_pos += n;
+        return p;
+    }
+
+    // Byte order conversions are written as shifts, which compilers turn into
+    // a plain load (and a byte swap instruction if the host order differs)
+    static uint16_t load_u2be(const unsigned char* b) {
+        return static_cast<uint16_t>(b[0] << 8 | b[1]);
+    }
+
+    static uint16_t load_u2le(const unsigned char* b) {
+        return static_cast<uint16_t>(b[1] << 8 | b[0]);
+    }
+
+    static uint32_t load_u4be(const unsigned char* b) {
+        return
+            static_cast<uint32_t>(b[0]) << 24 |
+            static_cast<uint32_t>(b[1]) << 16 |
+            static_cast<uint32_t>(b[2]) << 8 |
+            static_cast<uint32_t>(b[3]);
+    }
+
+    static uint32_t load_u4le(const unsigned char* b) {
+        return
+            static_cast<uint32_t>(b[3]) << 24 |
+            static_cast<uint32_t>(b[2]) << 16 |
+            static_cast<uint32_t>(b[1]) << 8 |
+            static_cast<uint32_t>(b[0]);
+    }
+
+    static uint64_t load_u8be(const unsigned char* b) {
+        return static_cast<uint64_t>(load_u4be(b)) << 32 | load_u4be(b + 4);
+    }
+
+    static uint64_t load_u8le(const unsigned char* b) {
+        return static_cast<uint64_t>(load_u4le(b + 4)) << 32 | load_u4le(b);
+    }
+
+    static float to_float(uint32_t bits) {
+        float res;
+        std::memcpy(&res, &bits, sizeof(res));
+        return res;
+    }
+
+    static double to_double(uint64_t bits) {
+        double res;
+        std::memcpy(&res, &bits, sizeof(res));
+        return res;
+    }
+
     static void unsigned_to_decimal(uint64_t number, char *buf, std::size_t &buf_contents_start);
     static std::string to_string_signed(int64_t val);
     static std::string to_string_unsigned(uint64_t val);
@@ -382,8 +1108,6 @@ private:
      */
     static std::string bytes_to_str(const std::string src, int codepage);
 #endif
-
-    static const int ZLIB_BUF_SIZE = 128 * 1024;
 };
 
 }
@@ -10,14 +10,26 @@
 #endif
 
 #include "kaitai/kaitaistream.h"
+#include "kaitai/basic_kstream.h"
 #include "kaitai/exceptions.h"
+#include "kaitai/custom_decoder.h"
 
 #include <stdint.h> // int8_t, int16_t, int32_t, int64_t, uint8_t, uint16_t, uint32_t, uint64_t
 
+#include <cstdio> // std::remove
+#include <fstream> // std::ofstream
+#include <ios> // std::ios_base
 #include <limits> // std::numeric_limits
 #include <sstream> // std::istringstream
+#include <streambuf> // std::streambuf
 #include <stdexcept> // std::out_of_range, std::invalid_argument
 #include <string> // std::string
+#include <vector> // std::vector
+
+#ifndef _WIN32
+#include <fcntl.h> // open, O_RDONLY
+#include <unistd.h> // close, lseek
+#endif
 
 #define SETUP_STREAM(...)                                                                  \
     const uint8_t input_bytes[] = { __VA_ARGS__ };                                         \
@@ -25,6 +37,18 @@
     std::istringstream is(input_str);                                                      \
     kaitai::kstream ks(&is);
 
+// Stream buffer over a string that cannot seek, like one reading a pipe
+class forward_only_buf : public std::streambuf {
+public:
+    forward_only_buf(const std::string &data) : m_data(data) {
+        char *p = &m_data[0];
+        setg(p, p, p + m_data.size());
+    }
+
+private:
+    std::string m_data;
+};
+
 TEST(KaitaiStreamTest, read_s1)
 {
     SETUP_STREAM(42, 0xff, 0x80);
@@ -65,6 +89,994 @@ TEST(KaitaiStreamTest, read_f8be)
     EXPECT_DOUBLE_EQ(ks.read_f8be(), 3.14159);
 }
 
+TEST(KaitaiStreamTest, mem_read_ints)
+{
+    const char data[] = "\x2a\xff\x01\x02\x03\x04\x05\x06\x07\x08";
+    kaitai::kstream ks(data, sizeof data - 1);
+    EXPECT_EQ(ks.read_u1(), 42);
+    EXPECT_EQ(ks.read_s1(), -1);
+    EXPECT_EQ(ks.read_u2be(), 0x0102);
+    EXPECT_EQ(ks.read_u2le(), 0x0403);
+    EXPECT_EQ(ks.pos(), 6);
+    EXPECT_EQ(ks.read_u4be(), 0x05060708u);
+    EXPECT_EQ(ks.is_eof(), true);
+    EXPECT_EQ(ks.size(), 10);
+}
+
+TEST(KaitaiStreamTest, mem_short_read_keeps_pos)
+{
+    const char data[] = "abcd";
+    kaitai::kstream ks(data, 4);
+    ks.read_u1();
+    try {
+        ks.read_u4le();
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 1);
+    try {
+        ks.read_bytes(4);
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 1);
+    EXPECT_EQ(ks.read_bytes(3), "bcd");
+}
+
+TEST(KaitaiStreamTest, mem_seek)
+{
+    kaitai::kstream ks(std::string("abcd"));
+    ks.seek(4);
+    EXPECT_EQ(ks.is_eof(), true);
+    ks.seek(1);
+    EXPECT_EQ(ks.read_bytes_full(), "bcd");
+    try {
+        ks.seek(5);
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+}
+
+TEST(KaitaiStreamTest, mem_read_bytes_term)
+{
+    kaitai::kstream ks(std::string("ab|cd|ef", 8));
+    EXPECT_EQ(ks.read_bytes_term('|', false, true, true), "ab");
+    EXPECT_EQ(ks.read_bytes_term('|', true, false, true), "cd|");
+    EXPECT_EQ(ks.read_u1(), '|');
+    EXPECT_EQ(ks.read_bytes_term('|', false, true, false), "ef");
+    EXPECT_EQ(ks.is_eof(), true);
+}
+
+TEST(KaitaiStreamTest, mem_read_bytes_term_eos_error)
+{
+    std::string data(1000, 'x');
+    data[700] = '\0';
+    kaitai::kstream ks(data);
+    EXPECT_EQ(ks.read_bytes_term('\0', false, true, true), std::string(700, 'x'));
+    EXPECT_EQ(ks.pos(), 701);
+    try {
+        ks.read_bytes_term('\0', false, true, true);
+        FAIL() << "Expected std::runtime_error";
+    } catch (const std::runtime_error&) {
+    }
+    EXPECT_EQ(ks.pos(), 701);
+    EXPECT_EQ(ks.read_bytes_term('\0', false, true, false), std::string(299, 'x'));
+    EXPECT_EQ(ks.is_eof(), true);
+}
+
+TEST(KaitaiStreamTest, bytes_terminate)
+{
+    std::string src("ab\0cd\0", 6);
+    EXPECT_EQ(kaitai::kstream::bytes_terminate(src, '\0', false), "ab");
+    EXPECT_EQ(kaitai::kstream::bytes_terminate(src, '\0', true), std::string("ab\0", 3));
+    EXPECT_EQ(kaitai::kstream::bytes_terminate("abcd", '\0', true), "abcd");
+    EXPECT_EQ(kaitai::kstream::bytes_terminate("", '\0', false), "");
+    EXPECT_EQ(kaitai::kstream::bytes_terminate(std::string(64, 'x') + "|y", '|', false), std::string(64, 'x'));
+}
+
+TEST(KaitaiStreamTest, mem_read_bytes_term_multi)
+{
+    kaitai::kstream ks(std::string("a\0\0\0bc\0\0", 8));
+    EXPECT_EQ(ks.read_bytes_term_multi(std::string(2, '\0'), false, true, true), std::string("a\0", 2));
+    EXPECT_EQ(ks.read_bytes_term_multi(std::string(2, '\0'), true, false, true), std::string("bc\0\0", 4));
+    EXPECT_EQ(ks.pos(), 6);
+}
+
+TEST(KaitaiStreamTest, mem_read_bytes_term_multi_long)
+{
+    // UTF-16LE "A\u0100" repeated: the misaligned "\0\0" in the middle of
+    // every pair of characters must not match
+    std::string text;
+    for (int i = 0; i < 20; i++)
+        text += std::string("A\0\0\x01", 4);
+    kaitai::kstream ks(text + std::string("\0\0", 2) + "xyz");
+    EXPECT_EQ(ks.read_bytes_term_multi(std::string(2, '\0'), false, true, true), text);
+    EXPECT_EQ(ks.pos(), 82);
+
+    kaitai::kstream ks4(text + std::string("\0\0\0\0", 4) + "xyz!");
+    EXPECT_EQ(ks4.read_bytes_term_multi(std::string(4, '\0'), true, false, true), text + std::string(4, '\0'));
+    EXPECT_EQ(ks4.pos(), 80);
+    EXPECT_EQ(ks4.read_bytes_term_multi("xyz!", false, true, true), std::string(4, '\0'));
+    EXPECT_EQ(ks4.is_eof(), true);
+}
+
+TEST(KaitaiStreamTest, bytes_terminate_multi)
+{
+    std::string text;
+    for (int i = 0; i < 20; i++)
+        text += std::string("A\0\0\x01", 4);
+    std::string src = text + std::string("\0\0", 2) + "xyz";
+    EXPECT_EQ(kaitai::kstream::bytes_terminate_multi(src, std::string(2, '\0'), false), text);
+    EXPECT_EQ(kaitai::kstream::bytes_terminate_multi(src, std::string(2, '\0'), true), text + std::string(2, '\0'));
+    EXPECT_EQ(kaitai::kstream::bytes_terminate_multi(text, std::string(4, '\0'), false), text);
+    EXPECT_EQ(kaitai::kstream::bytes_terminate_multi(std::string("ab\0\0\0", 5), std::string(2, '\0'), false), "ab");
+    EXPECT_EQ(kaitai::kstream::bytes_terminate_multi(std::string("a\0\0", 3), std::string(2, '\0'), false), std::string("a\0\0", 3));
+    EXPECT_EQ(kaitai::kstream::bytes_terminate_multi("abc", "", false), "");
+}
+
+TEST(KaitaiStreamTest, mem_read_bits)
+{
+    const char data[] = "\xaa\xbb";
+    kaitai::kstream ks(data, 2);
+    EXPECT_EQ(ks.read_bits_int_be(4), 0xau);
+    EXPECT_EQ(ks.is_eof(), false);
+    EXPECT_EQ(ks.read_bytes(1), "\xbb");
+}
+
+TEST(KaitaiStreamTest, mem_read_bits_words)
+{
+    // In memory, bits come from an accumulator refilled a 64-bit word at a
+    // time while 8 bytes are left; the results must match byte-by-byte reads
+    // of a std::istream
+    const std::string data("\x12\x34\x56\x78\x9a\xbc\xde\xf0\x0f\xed\xcb\xa9\x87\x65\x43\x21", 16);
+    const int widths[] = {3, 13, 1, 64, 7, 9, 22};
+    for (int le = 0; le < 2; le++) {
+        kaitai::kstream mem(data);
+        std::istringstream is(data);
+        kaitai::kstream io(&is);
+        for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+            if (le) {
+                EXPECT_EQ(mem.read_bits_int_le(widths[i]), io.read_bits_int_le(widths[i]));
+            } else {
+                EXPECT_EQ(mem.read_bits_int_be(widths[i]), io.read_bits_int_be(widths[i]));
+            }
+            EXPECT_EQ(mem.pos(), io.pos());
+        }
+        EXPECT_EQ(mem.read_u1(), 0x21);
+    }
+
+    kaitai::kstream ks(std::string("\xab\xcd\xef\x01\x23\x45\x67\x89\xff", 9));
+    EXPECT_EQ(ks.read_bits_int_be(12), 0xabcu);
+    EXPECT_EQ(ks.pos(), 2);
+    EXPECT_EQ(ks.read_bits_int_be(4), 0xdu);
+    EXPECT_EQ(ks.read_bits_int_le(56), 0xff8967452301efULL);
+    EXPECT_EQ(ks.is_eof(), true);
+
+    // Bytes read ahead into the accumulator are not consumed: byte reads,
+    // seeks and alignment in between see the same stream as without it
+    std::string long_data;
+    for (int i = 0; i < 40; i++)
+        long_data += static_cast<char>(i * 37 + 11);
+    for (int le = 0; le < 2; le++) {
+        kaitai::kstream mem(long_data);
+        std::istringstream is(long_data);
+        kaitai::kstream io(&is);
+        for (int round = 0; round < 2; round++) {
+            const int bit_widths[] = {5, 3, 1, 17, 2, 56, 6, 4};
+            for (size_t i = 0; i < sizeof(bit_widths) / sizeof(bit_widths[0]); i++) {
+                if (le) {
+                    EXPECT_EQ(mem.read_bits_int_le(bit_widths[i]), io.read_bits_int_le(bit_widths[i]));
+                } else {
+                    EXPECT_EQ(mem.read_bits_int_be(bit_widths[i]), io.read_bits_int_be(bit_widths[i]));
+                }
+                EXPECT_EQ(mem.pos(), io.pos());
+                EXPECT_EQ(mem.is_eof(), io.is_eof());
+                if (i == 3) {
+                    EXPECT_EQ(mem.read_u1(), io.read_u1());
+                }
+            }
+            mem.seek(3);
+            io.seek(3);
+        }
+        mem.align_to_byte();
+        io.align_to_byte();
+        EXPECT_EQ(mem.read_u2be(), io.read_u2be());
+    }
+}
+
+TEST(KaitaiStreamTest, substream_mem)
+{
+    const char data[] = "abcdefgh";
+    kaitai::kstream ks(data, 8);
+    ks.seek(1);
+    kaitai::kstream sub(&ks, 2, 4);
+    EXPECT_EQ(ks.pos(), 1);
+    EXPECT_EQ(sub.size(), 4);
+    EXPECT_EQ(sub.read_bytes(2), "cd");
+    kaitai::kstream subsub(&sub, 1, 2);
+    EXPECT_EQ(subsub.read_bytes_full(), "de");
+    try {
+        kaitai::kstream too_long(&ks, 6, 3);
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+}
+
+TEST(KaitaiStreamTest, substream_istream)
+{
+    SETUP_STREAM('a', 'b', 'c', 'd', 'e');
+    ks.read_u1();
+    kaitai::kstream sub(&ks, 2, 3);
+    EXPECT_EQ(ks.pos(), 1);
+    EXPECT_EQ(sub.read_bytes_full(), "cde");
+    try {
+        kaitai::kstream too_long(&ks, 4, 2);
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 1);
+}
+
+TEST(KaitaiStreamTest, buffered_read_ints)
+{
+    std::istringstream is(std::string("\x2a\xff\x01\x02\x03\x04\x05\x06\x07\x08", 10));
+    kaitai::kstream ks(&is, 3);
+    EXPECT_EQ(ks.read_u1(), 42);
+    EXPECT_EQ(ks.read_s1(), -1);
+    EXPECT_EQ(ks.read_u2be(), 0x0102);
+    EXPECT_EQ(ks.read_u2le(), 0x0403);
+    EXPECT_EQ(ks.pos(), 6);
+    EXPECT_EQ(ks.is_eof(), false);
+    EXPECT_EQ(ks.read_u4be(), 0x05060708u);
+    EXPECT_EQ(ks.is_eof(), true);
+    EXPECT_EQ(ks.size(), 10);
+}
+
+TEST(KaitaiStreamTest, buffered_short_read_keeps_pos)
+{
+    std::istringstream is("abcd");
+    kaitai::kstream ks(&is, 2);
+    ks.read_u1();
+    try {
+        ks.read_u4le();
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 1);
+    try {
+        ks.read_bytes(4);
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 1);
+    EXPECT_EQ(ks.read_bytes(3), "bcd");
+}
+
+TEST(KaitaiStreamTest, buffered_seek)
+{
+    std::istringstream is("abcdefghij");
+    kaitai::kstream ks(&is, 4);
+    EXPECT_EQ(ks.read_bytes(2), "ab");
+    EXPECT_EQ(is.tellg(), 4);
+    // Within the current block: the istream is not touched
+    ks.seek(1);
+    EXPECT_EQ(ks.read_bytes(3), "bcd");
+    EXPECT_EQ(is.tellg(), 4);
+    ks.seek(8);
+    EXPECT_EQ(ks.read_bytes_full(), "ij");
+    ks.seek(0);
+    EXPECT_EQ(ks.read_bytes(6), "abcdef");
+    EXPECT_EQ(ks.pos(), 6);
+}
+
+TEST(KaitaiStreamTest, buffered_read_bytes_term)
+{
+    std::istringstream is(std::string("abcde|fg|h", 10));
+    kaitai::kstream ks(&is, 3);
+    EXPECT_EQ(ks.read_bytes_term('|', false, true, true), "abcde");
+    EXPECT_EQ(ks.read_bytes_term('|', true, false, true), "fg|");
+    EXPECT_EQ(ks.read_u1(), '|');
+    try {
+        ks.read_bytes_term('|', false, true, true);
+        FAIL() << "Expected runtime_error exception";
+    } catch (const std::runtime_error&) {
+    }
+    EXPECT_EQ(ks.pos(), 9);
+    EXPECT_EQ(ks.read_bytes_term('|', false, true, false), "h");
+    EXPECT_EQ(ks.is_eof(), true);
+}
+
+TEST(KaitaiStreamTest, buffered_read_bytes_term_multi)
+{
+    std::istringstream is(std::string("ab\0\0\0cd\0\0\0e", 11));
+    kaitai::kstream ks(&is, 3);
+    EXPECT_EQ(ks.read_bytes_term_multi(std::string(2, '\0'), false, true, true), std::string("ab", 2));
+    EXPECT_EQ(ks.read_bytes_term_multi(std::string(2, '\0'), true, false, true), std::string("\0cd\0\0\0", 6));
+    EXPECT_EQ(ks.pos(), 8);
+    ks.seek(9);
+    EXPECT_EQ(ks.read_bytes_term_multi(std::string(2, '\0'), false, true, false), std::string("\0e", 2));
+    EXPECT_EQ(ks.is_eof(), true);
+}
+
+TEST(KaitaiStreamTest, substream_buffered)
+{
+    std::istringstream is("abcdefgh");
+    kaitai::kstream ks(&is, 3);
+    ks.read_u1();
+    kaitai::kstream sub(&ks, 2, 5);
+    EXPECT_EQ(ks.pos(), 1);
+    EXPECT_EQ(sub.read_bytes_full(), "cdefg");
+    EXPECT_EQ(ks.read_bytes(2), "bc");
+}
+
+TEST(KaitaiStreamTest, forward_only_rewind)
+{
+    forward_only_buf buf("abcdefghijklmnop|qrst");
+    std::istream is(&buf);
+    kaitai::kstream ks(&is, 4, 6);
+    EXPECT_EQ(ks.read_bytes(3), "abc");
+    ks.seek(0);
+    EXPECT_EQ(ks.read_u1(), 'a');
+    ks.seek(12);
+    EXPECT_EQ(ks.read_bytes(2), "mn");
+    ks.seek(8);
+    EXPECT_EQ(ks.read_bytes(2), "ij");
+    try {
+        ks.seek(2);
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 10);
+    EXPECT_EQ(ks.read_bytes_term('|', false, true, true), "klmnop");
+    EXPECT_EQ(ks.is_eof(), false);
+    try {
+        ks.size();
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.read_bytes_full(), "qrst");
+    EXPECT_EQ(ks.is_eof(), true);
+}
+
+TEST(KaitaiStreamTest, forward_only_buffered)
+{
+    forward_only_buf buf("abcdefgh");
+    std::istream is(&buf);
+    kaitai::kstream ks(&is, 3);
+    EXPECT_EQ(ks.read_bytes(5), "abcde");
+    ks.seek(1);
+    EXPECT_EQ(ks.read_bytes_term_multi("fg", true, false, true), "bcdefg");
+    EXPECT_EQ(ks.read_bytes(3), "fgh");
+}
+
+TEST(KaitaiStreamTest, segmented)
+{
+    std::vector<kaitai::kstream::segment> segs;
+    segs.push_back(kaitai::kstream::segment("\x01\x02\x03", 3));
+    segs.push_back(kaitai::kstream::segment("", 0));
+    segs.push_back(kaitai::kstream::segment("\x04", 1));
+    segs.push_back(kaitai::kstream::segment("abc|def", 7));
+    kaitai::kstream ks(segs);
+    EXPECT_EQ(ks.size(), 11);
+    EXPECT_EQ(ks.read_u2be(), 0x0102);
+    EXPECT_EQ(ks.read_u2be(), 0x0304);
+    EXPECT_EQ(ks.read_bytes_term('|', false, true, true), "abc");
+    ks.seek(1);
+    EXPECT_EQ(ks.read_bytes(5), "\x02\x03\x04" "ab");
+    EXPECT_EQ(ks.read_bytes_full(), "c|def");
+    EXPECT_EQ(ks.is_eof(), true);
+    try {
+        ks.seek(12);
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+}
+
+TEST(KaitaiStreamTest, substream_segmented)
+{
+    std::vector<kaitai::kstream::segment> segs;
+    const char first[] = "abcd";
+    const char second[] = "efgh";
+    segs.push_back(kaitai::kstream::segment(first, 4));
+    segs.push_back(kaitai::kstream::segment(second, 4));
+    kaitai::kstream ks(segs);
+    kaitai::kstream inside(&ks, 5, 2);
+    EXPECT_EQ(inside.read_bytes(2), "fg");
+    kaitai::kstream across(&ks, 2, 4);
+    EXPECT_EQ(across.read_bytes_full(), "cdef");
+    EXPECT_EQ(ks.pos(), 0);
+}
+
+TEST(KaitaiStreamTest, basic_kstream_memory)
+{
+    const char data[] = "\x2a\xff\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c"
+        "\x3f\x80\x00\x00\x00\x00\x80\x3f";
+    kaitai::basic_kstream<kaitai::memory_backend> ks(data, sizeof data - 1);
+    EXPECT_EQ(ks.read_u1(), 42);
+    EXPECT_EQ(ks.read_s1(), -1);
+    EXPECT_EQ(ks.read_u2be(), 0x0102);
+    EXPECT_EQ(ks.read_u2le(), 0x0403);
+    EXPECT_EQ(ks.pos(), 6);
+    EXPECT_EQ(ks.read_u8be(), 0x05060708090a0b0cull);
+    EXPECT_FLOAT_EQ(ks.read_f4be(), 1.0f);
+    EXPECT_FLOAT_EQ(ks.read_f4le(), 1.0f);
+    EXPECT_EQ(ks.is_eof(), true);
+    try {
+        ks.read_u1();
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 22);
+
+    ks.seek(2);
+    EXPECT_EQ(ks.read_bits_int_be(4), 0x0u);
+    EXPECT_EQ(ks.is_eof(), false);
+    EXPECT_EQ(ks.read_u4le(), 0x05040302u);
+    kaitai::basic_kstream<kaitai::memory_backend> sub(&ks, 14, 8);
+    EXPECT_EQ(sub.read_s4be(), 0x3f800000);
+    EXPECT_EQ(sub.read_s4le(), 0x3f800000);
+    EXPECT_EQ(sub.is_eof(), true);
+
+    // Usable through the kaitai::kstream interface as well
+    kaitai::kstream *base = &ks;
+    base->seek(2);
+    EXPECT_EQ(base->read_u2be(), 0x0102);
+    EXPECT_EQ(ks.read_u2be(), 0x0304);
+
+    // Reads past the end are reported without trying to refill
+    kaitai::basic_kstream<kaitai::memory_backend> short_ks(data, 3);
+    short_ks.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    EXPECT_EQ(short_ks.read_u2be(), 0x2aff);
+    EXPECT_EQ(short_ks.read_u4le(), 0u);
+    EXPECT_EQ(short_ks.status(), kaitai::kstream::STATUS_EOF);
+    EXPECT_EQ(short_ks.error_pos(), 2);
+    EXPECT_EQ(short_ks.pos(), 2);
+    EXPECT_EQ(short_ks.read_u1(), 1);
+}
+
+TEST(KaitaiStreamTest, basic_kstream_generic)
+{
+    std::istringstream is(std::string("\x01\x02\x03\x04\x05\x06\x07\x08\x09", 9));
+    kaitai::basic_kstream<kaitai::generic_backend> ks(&is, 4);
+    EXPECT_EQ(ks.read_u1(), 1);
+    EXPECT_EQ(ks.read_u8le(), 0x0908070605040302ull);
+    EXPECT_EQ(ks.pos(), 9);
+    EXPECT_EQ(ks.is_eof(), true);
+    ks.seek(3);
+    EXPECT_EQ(ks.read_s2le(), 0x0504);
+    kaitai::basic_kstream<kaitai::generic_backend> sub(&ks, 6, 3);
+    EXPECT_EQ(sub.read_u2be(), 0x0708);
+    try {
+        sub.read_u2be();
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(sub.pos(), 2);
+}
+
+TEST(KaitaiStreamTest, ensure_available)
+{
+    const char data[] = "\x2a\xff\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c"
+        "\x3f\x80\x00\x00\x00\x00\x80\x3f";
+    kaitai::kstream ks(data, sizeof data - 1);
+    EXPECT_EQ(ks.ensure_available(22), true);
+    EXPECT_EQ(ks.ensure_available(23), false);
+    EXPECT_EQ(ks.read_u1_unchecked(), 42);
+    EXPECT_EQ(ks.read_s1_unchecked(), -1);
+    EXPECT_EQ(ks.read_u2be_unchecked(), 0x0102);
+    EXPECT_EQ(ks.read_s2le_unchecked(), 0x0403);
+    EXPECT_EQ(ks.read_u8be_unchecked(), 0x05060708090a0b0cull);
+    EXPECT_FLOAT_EQ(ks.read_f4be_unchecked(), 1.0f);
+    EXPECT_FLOAT_EQ(ks.read_f4le_unchecked(), 1.0f);
+    EXPECT_EQ(ks.pos(), 22);
+    EXPECT_EQ(ks.ensure_available(0), true);
+    EXPECT_EQ(ks.ensure_available(1), false);
+
+    // Not enough data left: the checked reads still fail where they did
+    ks.seek(20);
+    EXPECT_EQ(ks.ensure_available(4), false);
+    EXPECT_EQ(ks.read_u2le(), 0x3f80);
+    try {
+        ks.read_u2le();
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 22);
+
+    // A buffered stream fetches the next block to satisfy the request once
+    // the current one is used up; bytes crossing its end are left to the
+    // checked reads
+    std::istringstream is(std::string(data, sizeof data - 1));
+    kaitai::kstream buffered(&is, 8);
+    EXPECT_EQ(buffered.read_u4be(), 0x2aff0102u);
+    EXPECT_EQ(buffered.ensure_available(8), false);
+    EXPECT_EQ(buffered.read_u4le(), 0x06050403u);
+    EXPECT_EQ(buffered.ensure_available(8), true);
+    EXPECT_EQ(buffered.read_u4be_unchecked(), 0x0708090au);
+    EXPECT_EQ(buffered.read_u4be_unchecked(), 0x0b0c3f80u);
+    EXPECT_EQ(buffered.ensure_available(9), false);
+    EXPECT_EQ(buffered.pos(), 16);
+    EXPECT_EQ(buffered.read_u4be(), 0u);
+    EXPECT_EQ(buffered.ensure_available(3), false);
+    EXPECT_EQ(buffered.read_u2be(), 0x803fu);
+}
+
+TEST(KaitaiStreamTest, empty_window)
+{
+    // Nothing is fetched before the first read, nor is anything left once
+    // the data is exhausted: the window is empty then
+    std::istringstream is("ab|");
+    kaitai::kstream ks(&is, 4);
+    EXPECT_EQ(ks.read_bytes(0), "");
+    EXPECT_EQ(ks.read_bytes_term('|', false, true, true), "ab");
+    EXPECT_EQ(ks.read_bytes_term('|', false, true, false), "");
+    EXPECT_EQ(ks.read_bytes_term_multi(std::string("\0\0", 2), false, true, false), "");
+    EXPECT_EQ(ks.is_eof(), true);
+
+    kaitai::kstream empty(std::string(""));
+    EXPECT_EQ(empty.read_bytes_term('|', false, true, false), "");
+    EXPECT_EQ(empty.read_bytes(0), "");
+}
+
+TEST(KaitaiStreamTest, error_status)
+{
+    kaitai::kstream ks(std::string("\x01\x02\x03", 3));
+    ks.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    EXPECT_EQ(ks.read_u2le(), 0x0201);
+    EXPECT_EQ(ks.ok(), true);
+    EXPECT_EQ(ks.read_u4le(), 0u);
+    EXPECT_EQ(ks.ok(), false);
+    EXPECT_EQ(ks.status(), kaitai::kstream::STATUS_EOF);
+    EXPECT_EQ(ks.error_pos(), 2);
+    EXPECT_EQ(ks.pos(), 2);
+
+    // The first error is kept
+    EXPECT_EQ(ks.read_u1(), 3);
+    EXPECT_EQ(ks.read_bytes(5), "");
+    EXPECT_EQ(ks.read_bytes_term('\0', false, true, true), "");
+    ks.seek(10);
+    EXPECT_EQ(ks.pos(), 3);
+    EXPECT_EQ(ks.error_pos(), 2);
+
+    ks.clear_error();
+    EXPECT_EQ(ks.ok(), true);
+    ks.set_error(kaitai::kstream::STATUS_INVALID, 1);
+    EXPECT_EQ(ks.status(), kaitai::kstream::STATUS_INVALID);
+    EXPECT_EQ(ks.error_pos(), 1);
+
+    // Substreams record errors in their parent as well
+    kaitai::kstream parent(std::string("abcdef"));
+    parent.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    kaitai::kstream sub(&parent, 2, 3);
+    EXPECT_EQ(sub.read_bytes(2), "cd");
+    EXPECT_EQ(sub.read_u2be(), 0);
+    EXPECT_EQ(sub.error_pos(), 2);
+    EXPECT_EQ(parent.status(), kaitai::kstream::STATUS_EOF);
+    EXPECT_EQ(parent.error_pos(), 4);
+    parent.clear_error();
+    kaitai::kstream beyond(&parent, 4, 5);
+    EXPECT_EQ(beyond.size(), 0);
+    EXPECT_EQ(parent.error_pos(), 4);
+    parent.clear_error();
+    kaitai::kstream unpacked(std::string("xy"));
+    unpacked.set_error_parent(&parent, 3);
+    EXPECT_EQ(unpacked.read_u4le(), 0u);
+    EXPECT_EQ(parent.error_pos(), 3);
+
+    // Buffered streams
+    std::istringstream is("abc");
+    kaitai::kstream buffered(&is, 2);
+    buffered.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    EXPECT_EQ(buffered.read_u1(), 'a');
+    EXPECT_EQ(buffered.read_u4le(), 0u);
+    EXPECT_EQ(buffered.error_pos(), 1);
+    EXPECT_EQ(buffered.pos(), 1);
+    EXPECT_EQ(buffered.read_bytes(2), "bc");
+
+    // Fixed contents
+    kaitai::kstream magic(std::string("MZxy"));
+    magic.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    EXPECT_EQ(magic.ensure_fixed_contents("MZ"), "MZ");
+    EXPECT_EQ(magic.ensure_fixed_contents("PE"), "");
+    EXPECT_EQ(magic.status(), kaitai::kstream::STATUS_INVALID);
+    EXPECT_EQ(magic.error_pos(), 2);
+    EXPECT_EQ(magic.pos(), 2);
+    magic.clear_error();
+    EXPECT_EQ(magic.ensure_fixed_contents("xyz"), "");
+    EXPECT_EQ(magic.status(), kaitai::kstream::STATUS_EOF);
+    EXPECT_EQ(magic.pos(), 2);
+
+    // Unbuffered istreams
+    std::istringstream is2("ab|cd");
+    kaitai::kstream unbuffered(&is2);
+    unbuffered.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    EXPECT_EQ(unbuffered.read_bytes_term('|', false, true, true), "ab");
+    EXPECT_EQ(unbuffered.read_bytes_term('|', false, true, true), "");
+    EXPECT_EQ(unbuffered.status(), kaitai::kstream::STATUS_EOF);
+    EXPECT_EQ(unbuffered.error_pos(), 3);
+    EXPECT_EQ(unbuffered.pos(), 3);
+    unbuffered.clear_error();
+    EXPECT_EQ(unbuffered.read_bytes_term_multi(std::string("\0\0", 2), false, true, true), "");
+    EXPECT_EQ(unbuffered.status(), kaitai::kstream::STATUS_EOF);
+    EXPECT_EQ(unbuffered.error_pos(), 3);
+    EXPECT_EQ(unbuffered.read_bytes_term('|', false, true, false), "cd");
+    EXPECT_EQ(unbuffered.is_eof(), true);
+
+    // The default mode still throws
+    kaitai::kstream throwing(std::string("\x01", 1));
+    try {
+        throwing.read_u2le();
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(throwing.ok(), true);
+}
+
+// Errors of the functions that don't read from a stream are still thrown in
+// the ERRORS_STATUS mode, and leave the stream status untouched
+TEST(KaitaiStreamTest, error_status_exceptions)
+{
+    kaitai::kstream ks(std::string("\xff\xfe\x78\x9d\xf3\xc8\x04\x00\x00\xfb\x00\xb2", 12));
+    ks.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+
+    std::string raw = ks.read_bytes(2);
+    try {
+        kaitai::kstream::bytes_to_str(raw, "invalid");
+        FAIL() << "Expected unknown_encoding exception";
+    } catch (const kaitai::unknown_encoding&) {
+    }
+#ifndef KS_STR_ENCODING_NONE
+    try {
+        kaitai::kstream::bytes_to_str(raw, "UTF-8");
+        FAIL() << "Expected illegal_seq_in_encoding exception";
+    } catch (const kaitai::illegal_seq_in_encoding&) {
+    }
+#endif
+    EXPECT_EQ(ks.ok(), true);
+
+#ifdef KS_ZLIB
+    // Bad zlib header, as in `process_zlib_z_data_error`
+    std::string packed = ks.read_bytes_full();
+    try {
+        kaitai::kstream::process_zlib(packed);
+        FAIL() << "Expected runtime_error exception";
+    } catch (const std::runtime_error&) {
+    }
+    kaitai::kstream *zks = kaitai::kstream::from_zlib(packed);
+    zks->set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    try {
+        zks->read_u1();
+        FAIL() << "Expected runtime_error exception";
+    } catch (const std::runtime_error&) {
+    }
+    EXPECT_EQ(zks->ok(), true);
+    delete zks;
+    EXPECT_EQ(ks.ok(), true);
+#endif
+}
+
+TEST(KaitaiStreamTest, is_eof_cached_size)
+{
+    std::istringstream is("abc");
+    is.seekg(1);
+    kaitai::kstream ks(&is);
+    EXPECT_EQ(ks.size(), 3);
+    EXPECT_EQ(ks.pos(), 1);
+    EXPECT_EQ(ks.is_eof(), false);
+    EXPECT_EQ(ks.read_bytes(2), "bc");
+    EXPECT_EQ(ks.is_eof(), true);
+    EXPECT_EQ(is.good(), true);
+    ks.seek(2);
+    EXPECT_EQ(ks.is_eof(), false);
+    EXPECT_EQ(ks.size(), 3);
+
+    std::istringstream buffered_is("abcdef");
+    kaitai::kstream buffered(&buffered_is, 4);
+    EXPECT_EQ(buffered.size(), 6);
+    buffered.seek(4);
+    EXPECT_EQ(buffered.is_eof(), false);
+    EXPECT_EQ(buffered.read_u2le(), 0x6665);
+    EXPECT_EQ(buffered.is_eof(), true);
+}
+
+TEST(KaitaiStreamTest, read_bytes_view)
+{
+    const char data[] = "abcdefgh";
+    kaitai::kstream ks(data, 8);
+    kaitai::bytes_view v = ks.read_bytes_view(3);
+    EXPECT_EQ(v.data() == data, true);
+    EXPECT_EQ(v.size(), 3);
+    EXPECT_EQ(v == std::string("abc"), true);
+    EXPECT_EQ(v < std::string("abd"), true);
+    EXPECT_EQ(v.str(), "abc");
+    EXPECT_EQ(ks.pos(), 3);
+    kaitai::bytes_view rest = ks.read_bytes_full_view();
+    EXPECT_EQ(rest.data() == data + 3, true);
+    EXPECT_EQ(static_cast<std::string>(rest), "defgh");
+    EXPECT_EQ(ks.is_eof(), true);
+    try {
+        ks.seek(6);
+        ks.read_bytes_view(3);
+        FAIL() << "Expected end of stream exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks.pos(), 6);
+
+    // Views within a segment point into it; other bytes can't be viewed
+    std::vector<kaitai::kstream::segment> segs;
+    segs.push_back(kaitai::kstream::segment(data, 4));
+    segs.push_back(kaitai::kstream::segment(data + 4, 4));
+    kaitai::kstream segmented(segs);
+    kaitai::bytes_view in_segment = segmented.read_bytes_view(2);
+    EXPECT_EQ(in_segment.data() == data, true);
+    EXPECT_EQ(segmented.size(), 8);
+    try {
+        segmented.read_bytes_view(4);
+        FAIL() << "Expected logic_error exception";
+    } catch (const std::logic_error&) {
+    }
+    kaitai::bytes_view tail = segmented.read_bytes_full_view();
+    EXPECT_EQ(tail.data() == data + 6, true);
+
+    std::istringstream is("0123456789");
+    kaitai::kstream io_ks(&is);
+    try {
+        io_ks.read_bytes_view(4);
+        FAIL() << "Expected logic_error exception";
+    } catch (const std::logic_error&) {
+    }
+    // Nothing to view at the end of stream is not an error in itself
+    io_ks.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    io_ks.seek(10);
+    EXPECT_EQ(io_ks.read_bytes_view(4).empty(), true);
+    EXPECT_EQ(io_ks.status(), kaitai::kstream::STATUS_EOF);
+}
+
+TEST(KaitaiStreamTest, read_arrays)
+{
+    std::string data;
+    for (int i = 0; i < 64; i++)
+        data += static_cast<char>(i);
+    kaitai::kstream ks(data);
+
+    std::vector<uint16_t> u2be;
+    ks.read_u2be_array(u2be, 11);
+    EXPECT_EQ(u2be.size(), 11);
+    EXPECT_EQ(u2be[0], 0x0001);
+    EXPECT_EQ(u2be[10], 0x1415);
+
+    ks.seek(0);
+    std::vector<int32_t> s4le;
+    ks.read_s4le_array(s4le, 9);
+    EXPECT_EQ(s4le[0], 0x03020100);
+    EXPECT_EQ(s4le[8], 0x23222120);
+
+    ks.seek(0);
+    uint64_t u8be[3];
+    ks.read_u8be_array(u8be, 3);
+    EXPECT_EQ(u8be[2], 0x1011121314151617ULL);
+
+    ks.seek(0);
+    std::vector<uint32_t> u4be;
+    ks.read_u4be_array_eos(u4be);
+    EXPECT_EQ(u4be.size(), 16);
+    EXPECT_EQ(u4be[15], 0x3c3d3e3fu);
+    EXPECT_EQ(ks.is_eof(), true);
+
+    std::string fdata("\x00\x00\x80\x3f\x00\x00\x00\x00\x00\x00\x00\xc0", 12);
+    kaitai::kstream fks(fdata);
+    std::vector<float> f4le;
+    fks.read_f4le_array(f4le, 1);
+    std::vector<double> f8le;
+    fks.read_f8le_array_eos(f8le);
+    EXPECT_FLOAT_EQ(f4le[0], 1.0f);
+    EXPECT_DOUBLE_EQ(f8le[0], -2.0);
+
+    // Same as reading one by one: the items read so far are kept and the
+    // position stays at the start of the item that can't be read
+    ks.seek(56);
+    std::vector<uint16_t> partial;
+    try {
+        ks.read_u2le_array(partial, 5);
+        FAIL() << "Expected end of stream exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(partial.size(), 4);
+    EXPECT_EQ(partial[3], 0x3f3e);
+    EXPECT_EQ(ks.pos(), 64);
+
+    ks.seek(58);
+    std::vector<uint32_t> trailing;
+    try {
+        ks.read_u4le_array_eos(trailing);
+        FAIL() << "Expected end of stream exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(trailing.size(), 1);
+    EXPECT_EQ(ks.pos(), 62);
+
+    // Items crossing a segment boundary
+    std::vector<kaitai::kstream::segment> segs;
+    segs.push_back(kaitai::kstream::segment("\x01\x02\x03", 3));
+    segs.push_back(kaitai::kstream::segment("\x04\x05\x06\x07\x08", 5));
+    kaitai::kstream segmented(segs);
+    std::vector<uint16_t> u2le;
+    segmented.read_u2le_array_eos(u2le);
+    EXPECT_EQ(u2le.size(), 4);
+    EXPECT_EQ(u2le[1], 0x0403);
+    EXPECT_EQ(u2le[3], 0x0807);
+
+    std::istringstream is(data);
+    kaitai::kstream io_ks(&is);
+    std::vector<int16_t> s2be;
+    io_ks.read_s2be_array_eos(s2be);
+    EXPECT_EQ(s2be.size(), 32);
+    EXPECT_EQ(s2be[31], 0x3e3f);
+
+    // ERRORS_STATUS mode: the failed item is zeroed and ends the array
+    kaitai::kstream status_ks(std::string("\x01\x02\x03", 3));
+    status_ks.set_error_mode(kaitai::kstream::ERRORS_STATUS);
+    std::vector<uint16_t> status_items;
+    status_ks.read_u2be_array_eos(status_items);
+    EXPECT_EQ(status_items.size(), 2);
+    EXPECT_EQ(status_items[1], 0);
+    EXPECT_EQ(status_ks.status(), kaitai::kstream::STATUS_EOF);
+    EXPECT_EQ(status_ks.error_pos(), 2);
+}
+
+TEST(KaitaiStreamTest, from_mmap)
+{
+    const char *path = "kstream_from_mmap_test.bin";
+    {
+        std::ofstream out(path, std::ofstream::binary);
+        out << "\x01\x02\x03\x04hello";
+    }
+    kaitai::kstream *ks = kaitai::kstream::from_mmap(path);
+    EXPECT_EQ(ks->size(), 9);
+    EXPECT_EQ(ks->read_u4le(), 0x04030201u);
+    EXPECT_EQ(ks->read_bytes_full(), "hello");
+    ks->close();
+    EXPECT_EQ(ks->is_eof(), true);
+    delete ks;
+    std::remove(path);
+}
+
+TEST(KaitaiStreamTest, from_mmap_empty)
+{
+    const char *path = "kstream_from_mmap_empty_test.bin";
+    {
+        std::ofstream out(path, std::ofstream::binary);
+    }
+    kaitai::kstream *ks = kaitai::kstream::from_mmap(path);
+    EXPECT_EQ(ks->size(), 0);
+    EXPECT_EQ(ks->is_eof(), true);
+    delete ks;
+    std::remove(path);
+}
+
+TEST(KaitaiStreamTest, from_mmap_missing_file)
+{
+    try {
+        kaitai::kstream::from_mmap("kstream_from_mmap_missing.bin");
+        FAIL() << "Expected runtime_error exception";
+    } catch (const std::runtime_error&) {
+    }
+}
+
+#ifndef _WIN32
+TEST(KaitaiStreamTest, from_fd_shared)
+{
+    const char *path = "kstream_from_fd_test.bin";
+    {
+        std::ofstream out(path, std::ofstream::binary);
+        out << "\x01\x02\x03\x04hello world";
+    }
+    int fd = open(path, O_RDONLY);
+    kaitai::kstream *ks1 = kaitai::kstream::from_fd(fd, 4);
+    kaitai::kstream *ks2 = kaitai::kstream::from_fd(fd, 4);
+    EXPECT_EQ(ks1->size(), 15);
+    EXPECT_EQ(ks1->read_u4le(), 0x04030201u);
+    ks2->seek(10);
+    EXPECT_EQ(ks2->read_bytes(5), "world");
+    EXPECT_EQ(ks2->is_eof(), true);
+    EXPECT_EQ(ks1->read_bytes(5), "hello");
+    EXPECT_EQ(ks1->pos(), 9);
+    try {
+        ks1->read_bytes(7);
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks1->pos(), 9);
+    // The file offset is never used
+    EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+    delete ks1;
+    delete ks2;
+    close(fd);
+    std::remove(path);
+}
+
+TEST(KaitaiStreamTest, from_fd_prefetch)
+{
+    const char *path = "kstream_from_fd_prefetch_test.bin";
+    std::string contents;
+    for (int i = 0; i < 100; i++)
+        contents.push_back(static_cast<char>(i));
+    {
+        std::ofstream out(path, std::ofstream::binary);
+        out << contents;
+    }
+    int fd = open(path, O_RDONLY);
+    kaitai::kstream *ks = kaitai::kstream::from_fd(fd, 8, 3);
+    EXPECT_EQ(ks->read_bytes(30), contents.substr(0, 30));
+    // At the end of a block, the next one is checked for whole; bytes crossing
+    // the end of a block are read by the checked reads, keeping the read-ahead
+    EXPECT_EQ(ks->read_u2be(), 0x1e1fu);
+    EXPECT_EQ(ks->ensure_available(8), true);
+    EXPECT_EQ(ks->read_u8be_unchecked(), 0x2021222324252627ull);
+    EXPECT_EQ(ks->read_u2be(), 0x2829u);
+    EXPECT_EQ(ks->ensure_available(8), false);
+    EXPECT_EQ(ks->read_u8be(), 0x2a2b2c2d2e2f3031ull);
+    // Back into a block that is not kept anymore
+    ks->seek(2);
+    EXPECT_EQ(ks->read_u1(), 2);
+    // Forward into the read-ahead
+    ks->seek(20);
+    EXPECT_EQ(ks->read_u4be(), 0x14151617u);
+    // Far away
+    ks->seek(90);
+    EXPECT_EQ(ks->read_bytes_full(), contents.substr(90));
+    EXPECT_EQ(ks->is_eof(), true);
+    try {
+        ks->read_u1();
+        FAIL() << "Expected std::ios_base::failure exception";
+    } catch (const std::ios_base::failure&) {
+    }
+    EXPECT_EQ(ks->size(), 100);
+    ks->seek(50);
+    EXPECT_EQ(ks->read_bytes(50), contents.substr(50));
+    delete ks;
+    close(fd);
+    std::remove(path);
+}
+
+TEST(KaitaiStreamTest, advise)
+{
+    const char *path = "kstream_advise_test.bin";
+    {
+        std::ofstream out(path, std::ofstream::binary);
+        out << "\x01\x02\x03\x04hello world";
+    }
+    kaitai::kstream *ks = kaitai::kstream::from_mmap(path);
+    ks->advise(kaitai::kstream::HINT_SEQUENTIAL);
+    ks->advise(kaitai::kstream::HINT_WILLNEED, 4, 5);
+    ks->advise(kaitai::kstream::HINT_WILLNEED, 10, 100);
+    ks->advise(kaitai::kstream::HINT_WILLNEED, 100, 1);
+    ks->advise(kaitai::kstream::HINT_WILLNEED, 0, 1 << 20);
+    EXPECT_EQ(ks->read_u4le(), 0x04030201u);
+    kaitai::kstream sub(ks, 4, 5);
+    sub.advise(kaitai::kstream::HINT_RANDOM, 1, 2);
+    EXPECT_EQ(sub.read_bytes_full(), "hello");
+    delete ks;
+
+    int fd = open(path, O_RDONLY);
+    ks = kaitai::kstream::from_fd(fd, 4);
+    ks->advise(kaitai::kstream::HINT_RANDOM);
+    ks->advise(kaitai::kstream::HINT_WILLNEED, 10, 5);
+    ks->advise(kaitai::kstream::HINT_WILLNEED, 0, 1 << 20);
+    ks->seek(10);
+    EXPECT_EQ(ks->read_bytes(5), "world");
+    delete ks;
+    close(fd);
+    std::remove(path);
+
+    // No-op for memory buffers
+    const char buf[] = "abc";
+    kaitai::kstream mem(buf, 3);
+    mem.advise(kaitai::kstream::HINT_WILLNEED, 0, 3);
+    EXPECT_EQ(mem.read_bytes(3), "abc");
+}
+#endif
+
 TEST(KaitaiStreamTest, to_string)
 {
     EXPECT_EQ(kaitai::kstream::to_string(123), "123");
@@ -261,6 +1273,137 @@ TEST(KaitaiStreamTest, string_to_int_garbage)
 }
 
 // Tests a successful zlib decompression.
+TEST(KaitaiStreamTest, process_xor)
+{
+    // Lengths around the 16/32/64-byte vector sizes, keys that do and do not
+    // divide them
+    std::string data;
+    for (int i = 0; i < 300; i++)
+        data.push_back(static_cast<char>(i * 7 + 3));
+    const std::size_t key_lens[] = {1, 3, 16, 17, 100, 300};
+    for (std::size_t len = 0; len <= data.length(); len += 13) {
+        std::string src = data.substr(0, len);
+        for (std::size_t k = 0; k < sizeof key_lens / sizeof key_lens[0]; k++) {
+            std::string key = data.substr(data.length() - key_lens[k]);
+            std::string expected(src);
+            for (std::size_t i = 0; i < len; i++)
+                expected[i] = static_cast<char>(src[i] ^ key[i % key.length()]);
+            EXPECT_EQ(kaitai::kstream::process_xor_many(src, key), expected);
+        }
+        std::string expected(src);
+        for (std::size_t i = 0; i < len; i++)
+            expected[i] = static_cast<char>(src[i] ^ 0xaa);
+        EXPECT_EQ(kaitai::kstream::process_xor_one(src, 0xaa), expected);
+    }
+
+    std::string buf("\x01\x02\x03\x04", 4);
+    kaitai::kstream::process_xor_many_in_place(&buf[0], buf.length(), "\xff\x0f", 2);
+    EXPECT_EQ(buf, std::string("\xfe\x0d\xfc\x0b", 4));
+}
+
+TEST(KaitaiStreamTest, process_rotate_left)
+{
+    std::string data;
+    for (int i = 0; i < 200; i++)
+        data.push_back(static_cast<char>(i * 37 + 11));
+    for (std::size_t len = 0; len <= data.length(); len += 17) {
+        std::string src = data.substr(0, len);
+        for (int amount = 0; amount <= 8; amount++) {
+            std::string expected(src);
+            for (std::size_t i = 0; i < len; i++) {
+                uint8_t bits = src[i];
+                expected[i] = static_cast<char>((bits << amount) | (bits >> (8 - amount)));
+            }
+            EXPECT_EQ(kaitai::kstream::process_rotate_left(src, amount), expected);
+        }
+    }
+    EXPECT_EQ(kaitai::kstream::process_rotate_left("\x81", -1), "\xc0");
+}
+
+TEST(KaitaiStreamTest, process_rotate_left_groups)
+{
+    std::string data("\x12\x34\x56\x78\x9a\xbc\xde\xf0", 8);
+    EXPECT_EQ(kaitai::kstream::process_rotate_left(data, 4, 2), std::string("\x23\x41\x67\x85\xab\xc9\xef\x0d", 8));
+    EXPECT_EQ(kaitai::kstream::process_rotate_left(data, 8, 4), std::string("\x34\x56\x78\x12\xbc\xde\xf0\x9a", 8));
+    EXPECT_EQ(kaitai::kstream::process_rotate_left(data, 12, 8), std::string("\x45\x67\x89\xab\xcd\xef\x01\x23", 8));
+    // Right rotation by 4 bits
+    EXPECT_EQ(kaitai::kstream::process_rotate_left(data, 32 - 4, 4), std::string("\x81\x23\x45\x67\x09\xab\xcd\xef", 8));
+    EXPECT_EQ(kaitai::kstream::process_rotate_left(data, 64, 8), data);
+
+    try {
+        kaitai::kstream::process_rotate_left(data, 1, 3);
+        FAIL() << "Expected std::invalid_argument";
+    } catch (const std::invalid_argument& e) {
+        EXPECT_EQ(e.what(), std::string("process_rotate_left: data length is not a multiple of group size"));
+    }
+    try {
+        kaitai::kstream::process_rotate_left(data, 1, 0);
+        FAIL() << "Expected std::invalid_argument";
+    } catch (const std::invalid_argument& e) {
+        EXPECT_EQ(e.what(), std::string("process_rotate_left: group size must be positive"));
+    }
+}
+
+namespace {
+
+// Implements the string interface only, like decoders written before decode_into()
+class reverse_decoder : public kaitai::custom_decoder {
+public:
+    std::string decode(std::string src) {
+        return std::string(src.rbegin(), src.rend());
+    }
+};
+
+// Doubles every byte, so the output outgrows the room it starts with
+class doubling_decoder : public kaitai::custom_decoder {
+public:
+    bool decode_into(const uint8_t* in, std::size_t n, output_buffer& out) {
+        for (std::size_t i = 0; i < n; i++) {
+            out.push_back(in[i]);
+            out.push_back(in[i]);
+        }
+        return true;
+    }
+};
+
+// Keeps every other byte, writing over its own input
+class halving_decoder : public kaitai::custom_decoder {
+public:
+    halving_decoder() : in_place_calls(0) {}
+
+    bool decode_into(const uint8_t* in, std::size_t n, output_buffer& out) {
+        if (in == out.data())
+            in_place_calls++;
+        for (std::size_t i = 0; i < n; i += 2)
+            out.push_back(in[i]);
+        return true;
+    }
+
+    bool decodes_in_place() const { return true; }
+
+    int in_place_calls;
+};
+
+}
+
+TEST(KaitaiStreamTest, custom_decoder_process)
+{
+    reverse_decoder rev;
+    EXPECT_EQ(rev.process("abc"), "cba");
+
+    doubling_decoder dbl;
+    EXPECT_EQ(dbl.process(std::string(1000, 'x')), std::string(2000, 'x'));
+    EXPECT_EQ(dbl.process(""), "");
+    EXPECT_EQ(dbl.decode("ab"), "aabb");
+
+    halving_decoder half;
+    std::string src("a1b2c3d");
+    EXPECT_EQ(half.process(src), "abcd");
+    EXPECT_EQ(src, "a1b2c3d");
+    EXPECT_EQ(half.in_place_calls, 1);
+    EXPECT_EQ(half.process(""), "");
+}
+
 TEST(KaitaiStreamTest, process_zlib_ok)
 {
     /*
@@ -277,6 +1420,58 @@ TEST(KaitaiStreamTest, process_zlib_ok)
     EXPECT_EQ(kaitai::kstream::process_zlib(ks.read_bytes_full()), "Hi");
 }
 
+TEST(KaitaiStreamTest, process_zlib_size_hint)
+{
+    // The same bytes as in `from_zlib`: "ab" * 100000 + "!"
+    const char head[] = "\x78\xda\xed\xc2\x41\x11\x00\x00\x0c\x02\xa0\x2c\x8b\xe6\xfa\x87\x30\x83\x7f\x0e\xf2\x01";
+    const char tail[] = "\x46\x57\x3d\x27\x9d\x69";
+    std::string data = std::string(head, sizeof head - 1) + std::string(193, '\0') + std::string(tail, sizeof tail - 1);
+    std::string expected;
+    for (int i = 0; i < 100000; i++)
+        expected += "ab";
+    expected += "!";
+
+    EXPECT_EQ(kaitai::kstream::process_zlib(data), expected);
+    EXPECT_EQ(kaitai::kstream::process_zlib(data, 200001), expected);
+    // Wrong hints only cost reallocations
+    EXPECT_EQ(kaitai::kstream::process_zlib(data, 10), expected);
+    EXPECT_EQ(kaitai::kstream::process_zlib(data, std::numeric_limits<uint64_t>::max()), expected);
+}
+
+TEST(KaitaiStreamTest, process_deflate_gzip)
+{
+    /*
+    Python code to generate:
+
+    ```python
+    import zlib
+    co = zlib.compressobj(9, zlib.DEFLATED, -15)  # 31 for gzip
+    data = co.compress(b"Hi") + co.flush()
+    ```
+    */
+    const char deflate[] = "\xf3\xc8\x04\x00";
+    const char gzip[] =
+        "\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\x03\xf3\xc8\x04\x00"
+        "\x0e\x0e\x17\x4d\x02\x00\x00\x00";
+    const char zlib[] = "\x78\x9c\xf3\xc8\x04\x00\x00\xfb\x00\xb2";
+
+    // The inflate state is reused, switching between the containers
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(kaitai::kstream::process_deflate(std::string(deflate, sizeof deflate - 1)), "Hi");
+        EXPECT_EQ(kaitai::kstream::process_gzip(std::string(gzip, sizeof gzip - 1), 2), "Hi");
+        EXPECT_EQ(kaitai::kstream::process_zlib(std::string(zlib, sizeof zlib - 1)), "Hi");
+    }
+
+    try {
+        kaitai::kstream::process_gzip(std::string(zlib, sizeof zlib - 1));
+        FAIL() << "Expected runtime_error exception";
+    } catch (const std::runtime_error& e) {
+        EXPECT_EQ(e.what(), std::string("process_gzip: inflate() failed: incorrect header check"));
+    }
+    // A failure does not break the next call
+    EXPECT_EQ(kaitai::kstream::process_deflate(std::string(deflate, sizeof deflate - 1)), "Hi");
+}
+
 // It's probably not a good idea to run this test in CI because it has to allocate 4 GiB of memory.
 // That's why it is disabled (see
 // https://google.github.io/googletest/advanced.html#temporarily-disabling-tests). You can still run
@@ -324,6 +1519,49 @@ TEST(KaitaiStreamTest, process_zlib_z_buf_error)
     }
 }
 
+TEST(KaitaiStreamTest, from_zlib)
+{
+    /*
+    Python code to generate:
+
+    ```python
+    import zlib
+    data = zlib.compress(b"ab" * 100000 + b"!", 9)
+    ```
+
+    The result is 22 bytes of `head`, 193 zero bytes and 6 bytes of `tail`.
+    */
+    const char head[] = "\x78\xda\xed\xc2\x41\x11\x00\x00\x0c\x02\xa0\x2c\x8b\xe6\xfa\x87\x30\x83\x7f\x0e\xf2\x01";
+    const char tail[] = "\x46\x57\x3d\x27\x9d\x69";
+    std::string data = std::string(head, sizeof head - 1) + std::string(193, '\0') + std::string(tail, sizeof tail - 1);
+    kaitai::kstream *ks = kaitai::kstream::from_zlib(data);
+    EXPECT_EQ(ks->read_bytes(3), "aba");
+    EXPECT_EQ(ks->size(), 200001);
+    EXPECT_EQ(ks->pos(), 3);
+    ks->seek(199999);
+    EXPECT_EQ(ks->read_bytes(2), "b!");
+    EXPECT_EQ(ks->is_eof(), true);
+    // Far behind the rewind window, so unpacking starts over
+    ks->seek(1);
+    EXPECT_EQ(ks->read_u2le(), 0x6162);
+    delete ks;
+}
+
+TEST(KaitaiStreamTest, from_zlib_truncated)
+{
+    // The same bytes as in `process_zlib_z_buf_error`
+    SETUP_STREAM(0x78, 0x9c, 0xf3, 0xc8, 0x04, 0x00, 0x00, 0xfb, 0x00)
+    kaitai::kstream *zks = kaitai::kstream::from_zlib(ks.read_bytes_full());
+    EXPECT_EQ(zks->read_bytes(2), "Hi");
+    try {
+        zks->is_eof();
+        FAIL() << "Expected runtime_error exception";
+    } catch (const std::runtime_error& e) {
+        EXPECT_EQ(e.what(), std::string("from_zlib: inflate() failed: incomplete or truncated input data"));
+    }
+    delete zks;
+}
+
 // Tests a failed zlib decompression due to the `inflate()` function returning `Z_DATA_ERROR`.
 TEST(KaitaiStreamTest, process_zlib_z_data_error)
 {
@@ -500,6 +1738,161 @@ TEST(KaitaiStreamTest, bytes_to_str_big_dest)
     EXPECT_EQ(res.length(), len * 3);
 }
 
+#ifdef KS_STR_ENCODING_ICONV
+// Conversion descriptors are cached between calls; each call must start from
+// the initial shift state, whatever the previous call left behind
+TEST(KaitaiStreamTest, bytes_to_str_iconv_reuse)
+{
+    for (int i = 0; i < 3; i++) {
+        // ESC $ B switches ISO-2022-JP to JIS X 0208, where 0x30 0x21 is U+4E9C
+        EXPECT_EQ(kaitai::kstream::bytes_to_str("\x1b$B0!", "ISO-2022-JP"), "\xe4\xba\x9c");
+        EXPECT_EQ(kaitai::kstream::bytes_to_str("A", "ISO-2022-JP"), "A");
+    }
+
+    try {
+        kaitai::kstream::bytes_to_str("\xb0", "EUC-JP");
+        FAIL() << "Expected illegal_seq_in_encoding exception";
+    } catch (const kaitai::illegal_seq_in_encoding&) {
+    }
+    EXPECT_EQ(kaitai::kstream::bytes_to_str("\xb0\xa1", "EUC-JP"), "\xe4\xba\x9c");
+
+    EXPECT_EQ(kaitai::kstream::bytes_to_str(std::string("\x80", 1), "windows-1252"), "\xe2\x82\xac");
+    EXPECT_EQ(kaitai::kstream::bytes_to_str(std::string("\xac\x20", 2), "UTF-16LE"), "\xe2\x82\xac");
+    EXPECT_EQ(kaitai::kstream::bytes_to_str("", "UTF-16LE"), "");
+}
+#endif
+
+TEST(KaitaiStreamTest, bytes_to_str_builtin)
+{
+    // Long enough to take the 16-byte steps, with the first non-ASCII character past them
+    std::string ascii = "The quick brown fox jumps over the lazy dog";
+    EXPECT_EQ(kaitai::kstream::bytes_to_str_ascii(ascii), ascii);
+    EXPECT_EQ(kaitai::kstream::bytes_to_str_utf8(ascii + "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80!"),
+        ascii + "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80!");
+    EXPECT_EQ(kaitai::kstream::bytes_to_str_latin1(ascii + "\xc4\xff" + ascii + "\x80"),
+        ascii + "\xc3\x84\xc3\xbf" + ascii + "\xc2\x80");
+
+    std::string utf16le;
+    std::string utf16be;
+    for (std::size_t i = 0; i < ascii.length(); i++) {
+        utf16le += ascii[i];
+        utf16le += '\0';
+        utf16be += '\0';
+        utf16be += ascii[i];
+    }
+    // U+00E9, U+20AC, U+1F600 (surrogate pair D83D DE00)
+    utf16le += std::string("\xe9\x00\xac\x20\x3d\xd8\x00\xde", 8);
+    utf16be += std::string("\x00\xe9\x20\xac\xd8\x3d\xde\x00", 8);
+    EXPECT_EQ(kaitai::kstream::bytes_to_str_utf16le(utf16le), ascii + "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+    EXPECT_EQ(kaitai::kstream::bytes_to_str_utf16be(utf16be), ascii + "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+
+    EXPECT_EQ(kaitai::kstream::bytes_to_str_utf16le(""), "");
+    EXPECT_EQ(kaitai::kstream::bytes_to_str_latin1(""), "");
+}
+
+TEST(KaitaiStreamTest, bytes_to_str_builtin_invalid_seq)
+{
+    const char *const illegal_utf8[] = {
+        "\x80",         // lone continuation byte
+        "\xc0\xaf",     // overlong form of '/'
+        "\xe0\x80\xaf", // overlong form of '/'
+        "\xed\xa0\x80", // surrogate U+D800
+        "\xf4\x90\x80\x80", // above U+10FFFF
+        "\xe2\x28\xa1", // continuation byte missing
+    };
+    for (std::size_t i = 0; i < sizeof(illegal_utf8) / sizeof(illegal_utf8[0]); i++) {
+        try {
+            kaitai::kstream::bytes_to_str_utf8(illegal_utf8[i]);
+            FAIL() << "Expected illegal_seq_in_encoding exception for case " << i;
+        } catch (const kaitai::illegal_seq_in_encoding& e) {
+            EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EILSEQ"));
+        }
+    }
+
+    try {
+        kaitai::kstream::bytes_to_str_utf8("abc\xe2\x82");
+        FAIL() << "Expected illegal_seq_in_encoding exception";
+    } catch (const kaitai::illegal_seq_in_encoding& e) {
+        EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EINVAL"));
+    }
+
+    try {
+        kaitai::kstream::bytes_to_str_ascii("caf\xe9");
+        FAIL() << "Expected illegal_seq_in_encoding exception";
+    } catch (const kaitai::illegal_seq_in_encoding& e) {
+        EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EILSEQ"));
+    }
+
+    // Lone low surrogate, and high surrogate followed by something else
+    try {
+        kaitai::kstream::bytes_to_str_utf16le(std::string("A\x00\x00\xdc", 4));
+        FAIL() << "Expected illegal_seq_in_encoding exception";
+    } catch (const kaitai::illegal_seq_in_encoding& e) {
+        EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EILSEQ"));
+    }
+    try {
+        kaitai::kstream::bytes_to_str_utf16be(std::string("\xd8\x3d\x00\x41", 4));
+        FAIL() << "Expected illegal_seq_in_encoding exception";
+    } catch (const kaitai::illegal_seq_in_encoding& e) {
+        EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EILSEQ"));
+    }
+    try {
+        kaitai::kstream::bytes_to_str_utf16be("\xd8\x3d");
+        FAIL() << "Expected illegal_seq_in_encoding exception";
+    } catch (const kaitai::illegal_seq_in_encoding& e) {
+        EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EINVAL"));
+    }
+    try {
+        kaitai::kstream::bytes_to_str_utf16le("a");
+        FAIL() << "Expected illegal_seq_in_encoding exception";
+    } catch (const kaitai::illegal_seq_in_encoding& e) {
+        EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EINVAL"));
+    }
+}
+
+TEST(KaitaiStreamTest, bytes_to_str_utf8_invalid_seq)
+{
+    // Named or not, UTF-8 is validated the same way
+    const char *const invalid_utf8[] = {"\xff", "\xc0\xaf", "abc\xe2\x82"};
+    for (std::size_t i = 0; i < sizeof(invalid_utf8) / sizeof(invalid_utf8[0]); i++) {
+        std::string by_name;
+        std::string by_helper;
+        try {
+            kaitai::kstream::bytes_to_str(invalid_utf8[i], "UTF-8");
+            FAIL() << "Expected illegal_seq_in_encoding exception for case " << i;
+        } catch (const kaitai::illegal_seq_in_encoding& e) {
+            by_name = e.what();
+        }
+        try {
+            kaitai::kstream::bytes_to_str_utf8(invalid_utf8[i]);
+            FAIL() << "Expected illegal_seq_in_encoding exception for case " << i;
+        } catch (const kaitai::illegal_seq_in_encoding& e) {
+            by_helper = e.what();
+        }
+        EXPECT_EQ(by_name, by_helper);
+    }
+}
+
+TEST(KaitaiStreamTest, lazy_str)
+{
+    kaitai::lazy_str empty;
+    EXPECT_EQ(empty.get(), "");
+
+    kaitai::lazy_str s(std::string("\x41\x00\xac\x20", 4), "UTF-16LE");
+    EXPECT_EQ(s.get(), "A\xe2\x82\xac");
+    EXPECT_EQ(s.get(), "A\xe2\x82\xac");
+
+    // Invalid bytes are only noticed when the string is asked for, every time
+    kaitai::lazy_str bad("\xff", "UTF-8");
+    for (int i = 0; i < 2; i++) {
+        try {
+            bad.get();
+            FAIL() << "Expected illegal_seq_in_encoding exception";
+        } catch (const kaitai::illegal_seq_in_encoding&) {
+        }
+    }
+}
+
 TEST(KaitaiStreamTest, bytes_to_str_unknown_encoding)
 {
     try {
@@ -594,13 +1987,8 @@ TEST(KaitaiStreamTest, bytes_to_str_invalid_seq_utf16le_odd_bytes)
         std::string res = kaitai::kstream::bytes_to_str("abc", "UTF-16LE");
         FAIL() << "Expected illegal_seq_in_encoding exception";
     } catch (const kaitai::illegal_seq_in_encoding& e) {
-#ifdef KS_STR_ENCODING_ICONV
+        // Decoded by the built-in decoder with either backend
         EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EINVAL"));
-#elif defined(KS_STR_ENCODING_WIN32API)
-        EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: incomplete"));
-#else
-#error Unknown KS_STR_ENCODING
-#endif
     }
 }
 
@@ -612,13 +2000,8 @@ TEST(KaitaiStreamTest, bytes_to_str_invalid_seq_utf16le_incomplete_high_surrogat
         std::string res = kaitai::kstream::bytes_to_str("\xd8\xd8", "UTF-16LE");
         FAIL() << "Expected illegal_seq_in_encoding exception";
     } catch (const kaitai::illegal_seq_in_encoding& e) {
-#ifdef KS_STR_ENCODING_ICONV
+        // Decoded by the built-in decoder with either backend
         EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: EINVAL"));
-#elif defined(KS_STR_ENCODING_WIN32API)
-        EXPECT_EQ(e.what(), std::string("bytes_to_str error: illegal sequence: WideCharToMultiByte"));
-#else
-#error Unknown KS_STR_ENCODING
-#endif
     }
 }
 #endif